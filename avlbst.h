@@ -134,12 +134,26 @@ template <class Key, class Value>
 class AVLTree : public BinarySearchTree<Key, Value>
 {
 public:
+    AVLTree();
+    AVLTree(const AVLTree<Key, Value>& other);
+    AVLTree(AVLTree<Key, Value>&& other);
+    AVLTree<Key, Value>& operator=(const AVLTree<Key, Value>& other);
+    AVLTree<Key, Value>& operator=(AVLTree<Key, Value>&& other);
+
+    using BinarySearchTree<Key, Value>::insert;
     virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
     virtual void remove(const Key& key);  // TODO
 protected:
     virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
+    virtual Node<Key, Value>* cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const override;
+    virtual Node<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent) const override;
+    virtual void setBuiltBalance(Node<Key, Value>* node, int leftHeight, int rightHeight) const override;
+    virtual Node<Key, Value>* linkNode(Node<Key, Value>* node) override;
+    virtual void unlinkNode(Node<Key, Value>* node) override;
+    virtual bool acceptsNode(const Node<Key, Value>* node) const override;
 
     // Add helper functions here
+    void insertFix(AVLNode<Key, Value>* parent);
     int getHeight(AVLNode<Key, Value>* node);
     int findBalance(AVLNode<Key, Value>* node);
     void updateBalance(AVLNode<Key, Value>* node);
@@ -151,6 +165,44 @@ protected:
 
 };
 
+template<class Key, class Value>
+AVLTree<Key, Value>::AVLTree() : BinarySearchTree<Key, Value>()
+{
+
+}
+
+/**
+* Copy constructor. The base class copy constructor can't be used since
+* virtual calls made there would create plain Nodes, so the clone is done
+* here where cloneNode() resolves to the AVL version.
+*/
+template<class Key, class Value>
+AVLTree<Key, Value>::AVLTree(const AVLTree<Key, Value>& other) : BinarySearchTree<Key, Value>()
+{
+    this->cloneFrom(other);
+}
+
+template<class Key, class Value>
+AVLTree<Key, Value>::AVLTree(AVLTree<Key, Value>&& other) :
+    BinarySearchTree<Key, Value>(std::move(other))
+{
+
+}
+
+template<class Key, class Value>
+AVLTree<Key, Value>& AVLTree<Key, Value>::operator=(const AVLTree<Key, Value>& other)
+{
+    BinarySearchTree<Key, Value>::operator=(other);
+    return *this;
+}
+
+template<class Key, class Value>
+AVLTree<Key, Value>& AVLTree<Key, Value>::operator=(AVLTree<Key, Value>&& other)
+{
+    BinarySearchTree<Key, Value>::operator=(std::move(other));
+    return *this;
+}
+
 /*
  * Recall: If key is already in the tree, you should 
  * overwrite the current value with the updated value.
@@ -165,18 +217,22 @@ void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
 
     if(this->root_ == nullptr){
       this->root_ = new AVLNode<Key, Value>(key, value, nullptr);
+      this->noteInserted(this->root_);
       return;
     }
 
     Node<Key, Value>* curr = this->root_;
     Node<Key, Value>* par = nullptr;
+    typename BinarySearchTree<Key, Value>::KeyCache cache = KeyTraits<Key>::makeCache(key);
+    int cmp = 0;
 
     while(curr != nullptr){
       par = curr;
-      if(key < curr->getKey()){
+      cmp = this->compareToNode(key, cache, curr);
+      if(cmp < 0){
         curr = curr->getLeft();
       } 
-      else if (key > curr->getKey()){
+      else if (cmp > 0){
         curr = curr->getRight();
       } else {
         curr->setValue(value);
@@ -187,20 +243,13 @@ void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
     AVLNode<Key, Value>* avlPar = static_cast<AVLNode<Key, Value>*>(par);
     AVLNode<Key, Value>* newNode = new AVLNode<Key, Value>(key, value, avlPar);
 
-    if(key < par->getKey()){
+    if(cmp < 0){
       par->setLeft(newNode);
     } else {
       par->setRight(newNode);
     }
-
-    AVLNode<Key,Value>* node = avlPar;
-    while(node != nullptr){
-      rebalanceNode(node);
-      if(node->getBalance() == 0){
-        break;
-      }
-      node = node->getParent();
-    }
+    this->noteInserted(newNode);
+    insertFix(avlPar);
 }
 
 /*
@@ -216,6 +265,19 @@ void AVLTree<Key, Value>:: remove(const Key& key)
     if (target == nullptr) {
         return;
     }
+    AVLTree<Key, Value>::unlinkNode(target);
+    this->destroyNode(target);
+}
+
+/**
+* Takes node out of the tree without freeing it, rebalancing on the way
+* up as remove() does.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::unlinkNode(Node<Key, Value>* node)
+{
+    AVLNode<Key, Value>* target = static_cast<AVLNode<Key, Value>*>(node);
+    this->noteRemoving(target);
 
     // Two children case: swap with predecessor
     if (target->getLeft() != nullptr && target->getRight() != nullptr) {
@@ -242,20 +304,62 @@ void AVLTree<Key, Value>:: remove(const Key& key)
     } else {
       par->setRight(child);
     }
-    delete target;
-   
-    AVLNode<Key, Value>* node = static_cast<AVLNode<Key, Value>*>(par);
-    while (node != nullptr) {
-      AVLNode<Key, Value>* newSubtreeRoot = rebalanceNode(node);
+
+    AVLNode<Key, Value>* up = par;
+    while (up != nullptr) {
+      AVLNode<Key, Value>* newSubtreeRoot = rebalanceNode(up);
       int newBalance = newSubtreeRoot->getBalance();
       if (newBalance == -1 || newBalance == 1) {
            break;
       }
         
-      node = newSubtreeRoot->getParent();
+      up = newSubtreeRoot->getParent();
     }  
 }
 
+/**
+* Links an unlinked AVLNode in as insert() would have created it, so its
+* old balance is discarded.
+*/
+template<class Key, class Value>
+Node<Key, Value>* AVLTree<Key, Value>::linkNode(Node<Key, Value>* node)
+{
+    int cmp;
+    size_t depth;
+    Node<Key, Value>* par = this->findSlot(node->getKey(), cmp, depth);
+    if(par != nullptr && cmp == 0){
+      return par;
+    }
+    static_cast<AVLNode<Key, Value>*>(node)->setBalance(0);
+    this->attachNode(node, par, cmp);
+    this->noteInserted(node);
+    insertFix(static_cast<AVLNode<Key, Value>*>(par));
+    return node;
+}
+
+template<class Key, class Value>
+bool AVLTree<Key, Value>::acceptsNode(const Node<Key, Value>* node) const
+{
+    return typeid(*node) == typeid(AVLNode<Key, Value>);
+}
+
+/**
+* Restores the balances from a newly linked node's parent upwards,
+* stopping at the first subtree whose height did not change.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value>* parent)
+{
+    AVLNode<Key,Value>* node = parent;
+    while(node != nullptr){
+      rebalanceNode(node);
+      if(node->getBalance() == 0){
+        break;
+      }
+      node = node->getParent();
+    }
+}
+
 template<class Key, class Value>
 void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
 {
@@ -265,20 +369,52 @@ void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>*
     n2->setBalance(tempB);
 }
 
+/**
+* Copies a node as an AVLNode, keeping its balance so the copy needs
+* no rebalancing.
+*/
 template<class Key, class Value>
-int AVLTree<Key, Value>::getHeight(AVLNode<Key, Value>* node){
-  if(node == nullptr){
-    return -1;
-  }
+Node<Key, Value>* AVLTree<Key, Value>::cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const
+{
+    AVLNode<Key, Value>* copy = new AVLNode<Key, Value>(src->getKey(), src->getValue(),
+        static_cast<AVLNode<Key, Value>*>(parent));
+    copy->setBalance(static_cast<const AVLNode<Key, Value>*>(src)->getBalance());
+    return copy;
+}
 
-  int leftHeight = getHeight(node->getLeft());
-  int rightHeight = getHeight(node->getRight());
+template<class Key, class Value>
+Node<Key, Value>* AVLTree<Key, Value>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent) const
+{
+    return new AVLNode<Key, Value>(key, value, static_cast<AVLNode<Key, Value>*>(parent));
+}
 
-  if(leftHeight > rightHeight){
-    return 1+leftHeight;
-  } else {
-    return 1+ rightHeight;
+/**
+* Bulk-built subtrees are height balanced, so the balance follows directly
+* from the subtree heights.
+*/
+template<class Key, class Value>
+void AVLTree<Key, Value>::setBuiltBalance(Node<Key, Value>* node, int leftHeight, int rightHeight) const
+{
+    static_cast<AVLNode<Key, Value>*>(node)->setBalance(rightHeight - leftHeight);
+}
+
+/**
+* Height of an AVL subtree whose balances are up to date (-1 if empty).
+* Following the taller child at every level finds the deepest path in
+* O(log n) steps, without recursion.
+*/
+template<class Key, class Value>
+int AVLTree<Key, Value>::getHeight(AVLNode<Key, Value>* node){
+  int height = -1;
+  while(node != nullptr){
+    height++;
+    if(node->getBalance() > 0){
+      node = node->getRight();
+    } else {
+      node = node->getLeft();
+    }
   }
+  return height;
 }
 
 template<class Key, class Value>
@@ -0,0 +1,931 @@
+#ifndef BPLUS_TREE_H
+#define BPLUS_TREE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+/**
+* An in-memory B+-tree with the same insert, remove, find, operator[]
+* and iterator interface as BinarySearchTree, for key counts where a
+* binary node's one key per cache line fetched is the bottleneck.
+*
+* Every node holds about BPLUS_NODE_BYTES of keys, a whole number of
+* cache lines, so one node visit replaces several levels of a binary
+* tree. Leaves keep their keys and values in separate arrays, so a
+* search only reads key lines, and are linked in order for scans. Inner
+* nodes hold separator keys and child pointers only.
+*
+* Searches within a node go through BPlusSearch<Key>, which compares
+* four keys per SSE2 instruction for int keys (and 64-bit integer keys
+* when built with SSE4.2) and falls back to a binary search otherwise.
+*
+* As in HotColdAVLTree, keys and values are not stored together, so
+* iterators yield a pair of references rather than a reference to a pair.
+*/
+
+#ifndef BPLUS_NODE_BYTES
+#define BPLUS_NODE_BYTES 256
+#endif
+
+/**
+* Intra-node search: the first index whose key is >= key (lowerBound)
+* or > key (upperBound) among count sorted keys.
+*/
+template <typename Key>
+struct BPlusSearch
+{
+    static unsigned lowerBound(const Key* keys, unsigned count, const Key& key)
+    {
+        return static_cast<unsigned>(std::lower_bound(keys, keys + count, key) - keys);
+    }
+
+    static unsigned upperBound(const Key* keys, unsigned count, const Key& key)
+    {
+        return static_cast<unsigned>(std::upper_bound(keys, keys + count, key) - keys);
+    }
+};
+
+#if defined(__SSE2__)
+/**
+* Counts the keys below (or not above) key four at a time. Keys are
+* sorted, so the scan stops at the first group that is not all below.
+*/
+template <>
+struct BPlusSearch<int>
+{
+    static unsigned lowerBound(const int* keys, unsigned count, const int& key)
+    {
+        __m128i target = _mm_set1_epi32(key);
+        unsigned i = 0;
+        for(; i + 4 <= count; i += 4){
+            __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+            int below = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(group, target)));
+            if(below != 0xf){
+                return i + __builtin_popcount(below);
+            }
+        }
+        while(i < count && keys[i] < key){
+            i++;
+        }
+        return i;
+    }
+
+    static unsigned upperBound(const int* keys, unsigned count, const int& key)
+    {
+        __m128i target = _mm_set1_epi32(key);
+        unsigned i = 0;
+        for(; i + 4 <= count; i += 4){
+            __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+            int above = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(group, target)));
+            if(above != 0){
+                return i + 4 - __builtin_popcount(above);
+            }
+        }
+        while(i < count && !(key < keys[i])){
+            i++;
+        }
+        return i;
+    }
+};
+#endif
+
+#if defined(__SSE4_2__)
+/**
+* The 64-bit version, two keys per compare.
+*/
+template <typename Int64>
+struct BPlusSearch64
+{
+    static unsigned lowerBound(const Int64* keys, unsigned count, const Int64& key)
+    {
+        __m128i target = _mm_set1_epi64x(key);
+        unsigned i = 0;
+        for(; i + 2 <= count; i += 2){
+            __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+            int below = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(target, group)));
+            if(below != 0x3){
+                return i + __builtin_popcount(below);
+            }
+        }
+        while(i < count && keys[i] < key){
+            i++;
+        }
+        return i;
+    }
+
+    static unsigned upperBound(const Int64* keys, unsigned count, const Int64& key)
+    {
+        __m128i target = _mm_set1_epi64x(key);
+        unsigned i = 0;
+        for(; i + 2 <= count; i += 2){
+            __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+            int above = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(group, target)));
+            if(above != 0){
+                return i + 2 - __builtin_popcount(above);
+            }
+        }
+        while(i < count && !(key < keys[i])){
+            i++;
+        }
+        return i;
+    }
+};
+
+template <> struct BPlusSearch<long> : BPlusSearch64<long> { };
+template <> struct BPlusSearch<long long> : BPlusSearch64<long long> { };
+#endif
+
+template <typename Key, typename Value>
+class BPlusTree
+{
+public:
+    typedef std::pair<const Key&, Value&> reference;
+
+    BPlusTree();
+    ~BPlusTree();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool empty() const;
+    size_t size() const;
+    size_t memoryUsage() const;
+    void print() const;
+
+protected:
+    struct Leaf;
+
+public:
+    /**
+    * An internal iterator class for traversing the contents of the tree.
+    */
+    class iterator
+    {
+    public:
+        class ArrowProxy
+        {
+        public:
+            const reference* operator->() const { return &item_; }
+        private:
+            friend class iterator;
+            ArrowProxy(const reference& item) : item_(item) { }
+            reference item_;
+        };
+
+        iterator();
+
+        reference operator*() const;
+        ArrowProxy operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class BPlusTree<Key, Value>;
+        iterator(Leaf* leaf, unsigned index);
+        Leaf* leaf_;
+        unsigned index_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+    // Keys per node; at least 4 so that splits and merges stay simple
+    static const unsigned CAPACITY = BPLUS_NODE_BYTES / sizeof(Key) >= 4 ?
+        static_cast<unsigned>(BPLUS_NODE_BYTES / sizeof(Key)) : 4;
+
+protected:
+    static const unsigned LEAF_MIN = CAPACITY / 2;
+    static const unsigned INNER_MIN = (CAPACITY - 1) / 2;
+    static const int MAX_DEPTH = 64;
+
+    struct NodeHeader
+    {
+        unsigned count;
+        bool leaf;
+    };
+
+    struct Leaf : NodeHeader
+    {
+        Leaf* prev;
+        Leaf* next;
+        typename std::aligned_storage<sizeof(Key), alignof(Key)>::type keySlots[CAPACITY];
+        typename std::aligned_storage<sizeof(Value), alignof(Value)>::type valueSlots[CAPACITY];
+
+        Key* keys() { return reinterpret_cast<Key*>(keySlots); }
+        Value* values() { return reinterpret_cast<Value*>(valueSlots); }
+    };
+
+    struct Inner : NodeHeader
+    {
+        typename std::aligned_storage<sizeof(Key), alignof(Key)>::type keySlots[CAPACITY];
+        NodeHeader* children[CAPACITY + 1];
+
+        Key* keys() { return reinterpret_cast<Key*>(keySlots); }
+    };
+
+    // A root-to-leaf path: the inner nodes and the child slot taken in each
+    struct Path
+    {
+        Inner* nodes[MAX_DEPTH];
+        unsigned slots[MAX_DEPTH];
+        int depth;
+    };
+
+    Leaf* newLeaf();
+    Inner* newInner();
+    static void freeNode(NodeHeader* node);
+    Leaf* descend(const Key& key, Path* path) const;
+    Leaf* leftmostLeaf() const;
+    void insertIntoParent(Path& path, const Key& separator, NodeHeader* child);
+    void fixLeafUnderflow(Path& path, Leaf* leaf);
+    void fixInnerUnderflow(Path& path);
+
+    template<typename T>
+    static void insertAt(T* items, unsigned count, unsigned pos, const T& item);
+    template<typename T>
+    static void eraseAt(T* items, unsigned count, unsigned pos);
+    template<typename T>
+    static void moveRange(T* from, unsigned count, T* to);
+
+private:
+    BPlusTree(const BPlusTree<Key, Value>&);
+    BPlusTree<Key, Value>& operator=(const BPlusTree<Key, Value>&);
+
+    NodeHeader* root_;
+    size_t count_;
+    size_t nodeBytes_;
+};
+
+/*
+--------------------------------------------------------------
+Begin implementations for the BPlusTree::iterator class.
+---------------------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+BPlusTree<Key, Value>::iterator::iterator() :
+    leaf_(NULL), index_(0)
+{
+
+}
+
+template<typename Key, typename Value>
+BPlusTree<Key, Value>::iterator::iterator(Leaf* leaf, unsigned index) :
+    leaf_(leaf), index_(index)
+{
+
+}
+
+template<typename Key, typename Value>
+typename BPlusTree<Key, Value>::reference
+BPlusTree<Key, Value>::iterator::operator*() const
+{
+    return reference(leaf_->keys()[index_], leaf_->values()[index_]);
+}
+
+template<typename Key, typename Value>
+typename BPlusTree<Key, Value>::iterator::ArrowProxy
+BPlusTree<Key, Value>::iterator::operator->() const
+{
+    return ArrowProxy(**this);
+}
+
+template<typename Key, typename Value>
+bool BPlusTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return leaf_ == rhs.leaf_ && index_ == rhs.index_;
+}
+
+template<typename Key, typename Value>
+bool BPlusTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Steps through the current leaf, then follows the leaf links.
+*/
+template<typename Key, typename Value>
+typename BPlusTree<Key, Value>::iterator&
+BPlusTree<Key, Value>::iterator::operator++()
+{
+    if(leaf_ != NULL && ++index_ >= leaf_->count){
+        leaf_ = leaf_->next;
+        index_ = 0;
+    }
+    return *this;
+}
+
+/*
+-------------------------------------------------------------
+End implementations for the BPlusTree::iterator class.
+-------------------------------------------------------------
+*/
+
+/*
+-----------------------------------------------------
+Begin implementations for the BPlusTree class.
+-----------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+BPlusTree<Key, Value>::BPlusTree() :
+    root_(NULL), count_(0), nodeBytes_(0)
+{
+
+}
+
+template<typename Key, typename Value>
+BPlusTree<Key, Value>::~BPlusTree()
+{
+    clear();
+}
+
+/**
+* Frees every node, level by level, without recursion.
+*/
+template<typename Key, typename Value>
+void BPlusTree<Key, Value>::clear()
+{
+    std::vector<NodeHeader*> nodes;
+    if(root_ != NULL){
+        nodes.push_back(root_);
+    }
+    while(!nodes.empty()){
+        NodeHeader* node = nodes.back();
+        nodes.pop_back();
+        if(!node->leaf){
+            Inner* inner = static_cast<Inner*>(node);
+            for(unsigned i = 0; i <= inner->count; ++i){
+                nodes.push_back(inner->children[i]);
+            }
+        }
+        freeNode(node);
+    }
+    root_ = NULL;
+    count_ = 0;
+    nodeBytes_ = 0;
+}
+
+template<typename Key, typename Value>
+bool BPlusTree<Key, Value>::empty() const
+{
+    return root_ == NULL;
+}
+
+template<typename Key, typename Value>
+size_t BPlusTree<Key, Value>::size() const
+{
+    return count_;
+}
+
+/**
+* Bytes held by the tree's nodes.
+*/
+template<typename Key, typename Value>
+size_t BPlusTree<Key, Value>::memoryUsage() const
+{
+    return nodeBytes_ + sizeof(*this);
+}
+
+/**
+* Prints each level's nodes as bracketed key lists, root first.
+*/
+template<typename Key, typename Value>
+void BPlusTree<Key, Value>::print() const
+{
+    std::vector<NodeHeader*> level;
+    if(root_ != NULL){
+        level.push_back(root_);
+    }
+    while(!level.empty()){
+        std::vector<NodeHeader*> next;
+        for(size_t n = 0; n < level.size(); ++n){
+            NodeHeader* node = level[n];
+            const Key* keys = node->leaf ? static_cast<Leaf*>(node)->keys() : static_cast<Inner*>(node)->keys();
+            std::cout << "[";
+            for(unsigned i = 0; i < node->count; ++i){
+                std::cout << (i ? " " : "") << keys[i];
+            }
+            std::cout << "] ";
+            if(!node->leaf){
+                Inner* inner = static_cast<Inner*>(node);
+                next.insert(next.end(), inner->children, inner->children + inner->count + 1);
+            }
+        }
+        std::cout << std::endl;
+        level.swap(next);
+    }
+}
+
+template<typename Key, typename Value>
+typename BPlusTree<Key, Value>::iterator
+BPlusTree<Key, Value>::begin() const
+{
+    return iterator(leftmostLeaf(), 0);
+}
+
+template<typename Key, typename Value>
+typename BPlusTree<Key, Value>::iterator
+BPlusTree<Key, Value>::end() const
+{
+    return iterator(NULL, 0);
+}
+
+template<typename Key, typename Value>
+typename BPlusTree<Key, Value>::iterator
+BPlusTree<Key, Value>::find(const Key& key) const
+{
+    Leaf* leaf = descend(key, NULL);
+    if(leaf == NULL){
+        return end();
+    }
+    unsigned pos = BPlusSearch<Key>::lowerBound(leaf->keys(), leaf->count, key);
+    if(pos < leaf->count && leaf->keys()[pos] == key){
+        return iterator(leaf, pos);
+    }
+    return end();
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key,
+* or the end iterator if there is none.
+*/
+template<typename Key, typename Value>
+typename BPlusTree<Key, Value>::iterator
+BPlusTree<Key, Value>::lower_bound(const Key& key) const
+{
+    Leaf* leaf = descend(key, NULL);
+    if(leaf == NULL){
+        return end();
+    }
+    unsigned pos = BPlusSearch<Key>::lowerBound(leaf->keys(), leaf->count, key);
+    if(pos == leaf->count){
+        return iterator(leaf->next, 0);
+    }
+    return iterator(leaf, pos);
+}
+
+/**
+* @precondition The key exists in the map
+* Returns the value associated with the key
+*/
+template<typename Key, typename Value>
+Value& BPlusTree<Key, Value>::operator[](const Key& key)
+{
+    iterator it = find(key);
+    if(it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+template<typename Key, typename Value>
+Value const & BPlusTree<Key, Value>::operator[](const Key& key) const
+{
+    iterator it = find(key);
+    if(it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+/**
+* Inserts into the key's leaf, splitting full nodes from the leaf up.
+* If key is already in the tree its value is overwritten.
+*/
+template<typename Key, typename Value>
+void BPlusTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    const Key& key = keyValuePair.first;
+    if(root_ == NULL){
+        Leaf* leaf = newLeaf();
+        new (leaf->keys()) Key(key);
+        new (leaf->values()) Value(keyValuePair.second);
+        leaf->count = 1;
+        root_ = leaf;
+        count_ = 1;
+        return;
+    }
+
+    Path path;
+    Leaf* leaf = descend(key, &path);
+    unsigned pos = BPlusSearch<Key>::lowerBound(leaf->keys(), leaf->count, key);
+    if(pos < leaf->count && leaf->keys()[pos] == key){
+        leaf->values()[pos] = keyValuePair.second;
+        return;
+    }
+
+    if(leaf->count < CAPACITY){
+        insertAt(leaf->keys(), leaf->count, pos, key);
+        insertAt(leaf->values(), leaf->count, pos, keyValuePair.second);
+        leaf->count++;
+        count_++;
+        return;
+    }
+
+    // split: the upper half moves to a new leaf on the right
+    Leaf* right = newLeaf();
+    unsigned half = CAPACITY / 2;
+    moveRange(leaf->keys() + half, CAPACITY - half, right->keys());
+    moveRange(leaf->values() + half, CAPACITY - half, right->values());
+    right->count = CAPACITY - half;
+    leaf->count = half;
+    right->next = leaf->next;
+    right->prev = leaf;
+    if(leaf->next != NULL){
+        leaf->next->prev = right;
+    }
+    leaf->next = right;
+
+    Leaf* target = leaf;
+    if(pos > half){
+        target = right;
+        pos -= half;
+    }
+    insertAt(target->keys(), target->count, pos, key);
+    insertAt(target->values(), target->count, pos, keyValuePair.second);
+    target->count++;
+    count_++;
+
+    insertIntoParent(path, right->keys()[0], right);
+}
+
+/**
+* Removes key from its leaf, then borrows from or merges with a sibling
+* if the leaf fell below half full, continuing up the path as needed.
+*/
+template<typename Key, typename Value>
+void BPlusTree<Key, Value>::remove(const Key& key)
+{
+    Path path;
+    Leaf* leaf = descend(key, &path);
+    if(leaf == NULL){
+        return;
+    }
+    unsigned pos = BPlusSearch<Key>::lowerBound(leaf->keys(), leaf->count, key);
+    if(pos >= leaf->count || !(leaf->keys()[pos] == key)){
+        return;
+    }
+
+    eraseAt(leaf->keys(), leaf->count, pos);
+    eraseAt(leaf->values(), leaf->count, pos);
+    leaf->count--;
+    count_--;
+
+    if(path.depth == 0){
+        if(leaf->count == 0){
+            freeNode(leaf);
+            nodeBytes_ -= sizeof(Leaf);
+            root_ = NULL;
+        }
+        return;
+    }
+    if(leaf->count < LEAF_MIN){
+        fixLeafUnderflow(path, leaf);
+    }
+}
+
+template<typename Key, typename Value>
+typename BPlusTree<Key, Value>::Leaf* BPlusTree<Key, Value>::newLeaf()
+{
+    Leaf* leaf = new Leaf;
+    leaf->count = 0;
+    leaf->leaf = true;
+    leaf->prev = NULL;
+    leaf->next = NULL;
+    nodeBytes_ += sizeof(Leaf);
+    return leaf;
+}
+
+template<typename Key, typename Value>
+typename BPlusTree<Key, Value>::Inner* BPlusTree<Key, Value>::newInner()
+{
+    Inner* inner = new Inner;
+    inner->count = 0;
+    inner->leaf = false;
+    nodeBytes_ += sizeof(Inner);
+    return inner;
+}
+
+/**
+* Destroys a node's live keys (and values) and frees it. Children are
+* not touched.
+*/
+template<typename Key, typename Value>
+void BPlusTree<Key, Value>::freeNode(NodeHeader* node)
+{
+    if(node->leaf){
+        Leaf* leaf = static_cast<Leaf*>(node);
+        for(unsigned i = 0; i < leaf->count; ++i){
+            leaf->keys()[i].~Key();
+            leaf->values()[i].~Value();
+        }
+        delete leaf;
+    } else {
+        Inner* inner = static_cast<Inner*>(node);
+        for(unsigned i = 0; i < inner->count; ++i){
+            inner->keys()[i].~Key();
+        }
+        delete inner;
+    }
+}
+
+/**
+* Walks from the root to the leaf that would hold key, recording the path
+* if asked. Child i of an inner node holds the keys from separator i - 1
+* (inclusive) up to separator i.
+*/
+template<typename Key, typename Value>
+typename BPlusTree<Key, Value>::Leaf* BPlusTree<Key, Value>::descend(const Key& key, Path* path) const
+{
+    if(path != NULL){
+        path->depth = 0;
+    }
+    NodeHeader* node = root_;
+    if(node == NULL){
+        return NULL;
+    }
+    while(!node->leaf){
+        Inner* inner = static_cast<Inner*>(node);
+        unsigned slot = BPlusSearch<Key>::upperBound(inner->keys(), inner->count, key);
+        if(path != NULL){
+            path->nodes[path->depth] = inner;
+            path->slots[path->depth] = slot;
+            path->depth++;
+        }
+        node = inner->children[slot];
+    }
+    return static_cast<Leaf*>(node);
+}
+
+template<typename Key, typename Value>
+typename BPlusTree<Key, Value>::Leaf* BPlusTree<Key, Value>::leftmostLeaf() const
+{
+    NodeHeader* node = root_;
+    if(node == NULL){
+        return NULL;
+    }
+    while(!node->leaf){
+        node = static_cast<Inner*>(node)->children[0];
+    }
+    return static_cast<Leaf*>(node);
+}
+
+/**
+* Adds separator and the new right sibling child above the last node on
+* path, splitting full inner nodes and growing a new root if needed.
+*/
+template<typename Key, typename Value>
+void BPlusTree<Key, Value>::insertIntoParent(Path& path, const Key& separator, NodeHeader* child)
+{
+    Key sep(separator);
+    while(path.depth > 0){
+        path.depth--;
+        Inner* par = path.nodes[path.depth];
+        unsigned slot = path.slots[path.depth];
+
+        if(par->count < CAPACITY){
+            insertAt(par->keys(), par->count, slot, sep);
+            insertAt(par->children, par->count + 1, slot + 1, child);
+            par->count++;
+            return;
+        }
+
+        // split: keys above mid move right and keys[mid] moves up
+        Inner* right = newInner();
+        unsigned mid = CAPACITY / 2;
+        Key up(par->keys()[mid]);
+        moveRange(par->keys() + mid + 1, CAPACITY - mid - 1, right->keys());
+        std::copy(par->children + mid + 1, par->children + CAPACITY + 1, right->children);
+        par->keys()[mid].~Key();
+        right->count = CAPACITY - mid - 1;
+        par->count = mid;
+
+        if(slot <= mid){
+            insertAt(par->keys(), par->count, slot, sep);
+            insertAt(par->children, par->count + 1, slot + 1, child);
+            par->count++;
+        } else {
+            slot -= mid + 1;
+            insertAt(right->keys(), right->count, slot, sep);
+            insertAt(right->children, right->count + 1, slot + 1, child);
+            right->count++;
+        }
+
+        sep = up;
+        child = right;
+    }
+
+    Inner* root = newInner();
+    new (root->keys()) Key(sep);
+    root->children[0] = root_;
+    root->children[1] = child;
+    root->count = 1;
+    root_ = root;
+}
+
+/**
+* Refills a leaf below LEAF_MIN from a sibling with keys to spare, or
+* merges it with one and removes the separator between them.
+*/
+template<typename Key, typename Value>
+void BPlusTree<Key, Value>::fixLeafUnderflow(Path& path, Leaf* leaf)
+{
+    Inner* par = path.nodes[path.depth - 1];
+    unsigned slot = path.slots[path.depth - 1];
+    Leaf* left = slot > 0 ? static_cast<Leaf*>(par->children[slot - 1]) : NULL;
+    Leaf* right = slot < par->count ? static_cast<Leaf*>(par->children[slot + 1]) : NULL;
+
+    if(left != NULL && left->count > LEAF_MIN){
+        unsigned last = left->count - 1;
+        insertAt(leaf->keys(), leaf->count, 0, left->keys()[last]);
+        insertAt(leaf->values(), leaf->count, 0, left->values()[last]);
+        leaf->count++;
+        eraseAt(left->keys(), left->count, last);
+        eraseAt(left->values(), left->count, last);
+        left->count--;
+        par->keys()[slot - 1] = leaf->keys()[0];
+        return;
+    }
+    if(right != NULL && right->count > LEAF_MIN){
+        insertAt(leaf->keys(), leaf->count, leaf->count, right->keys()[0]);
+        insertAt(leaf->values(), leaf->count, leaf->count, right->values()[0]);
+        leaf->count++;
+        eraseAt(right->keys(), right->count, 0);
+        eraseAt(right->values(), right->count, 0);
+        right->count--;
+        par->keys()[slot] = right->keys()[0];
+        return;
+    }
+
+    // merge the right one of the pair into the left one
+    Leaf* into = leaf;
+    Leaf* from = right;
+    unsigned sepSlot = slot;
+    if(left != NULL){
+        into = left;
+        from = leaf;
+        sepSlot = slot - 1;
+    }
+    moveRange(from->keys(), from->count, into->keys() + into->count);
+    moveRange(from->values(), from->count, into->values() + into->count);
+    into->count += from->count;
+    from->count = 0;
+    into->next = from->next;
+    if(from->next != NULL){
+        from->next->prev = into;
+    }
+    freeNode(from);
+    nodeBytes_ -= sizeof(Leaf);
+
+    eraseAt(par->keys(), par->count, sepSlot);
+    eraseAt(par->children, par->count + 1, sepSlot + 1);
+    par->count--;
+    path.depth--;
+    fixInnerUnderflow(path);
+}
+
+/**
+* Fixes the inner node at the end of path after it lost a key: the root
+* is dropped once it has a single child, other nodes below INNER_MIN
+* borrow through their parent or merge with a sibling, and the repair
+* continues upward after a merge.
+*/
+template<typename Key, typename Value>
+void BPlusTree<Key, Value>::fixInnerUnderflow(Path& path)
+{
+    while(true){
+        Inner* node = path.nodes[path.depth];
+        if(path.depth == 0){
+            if(node->count == 0){
+                root_ = node->children[0];
+                freeNode(node);
+                nodeBytes_ -= sizeof(Inner);
+            }
+            return;
+        }
+        if(node->count >= INNER_MIN){
+            return;
+        }
+
+        Inner* par = path.nodes[path.depth - 1];
+        unsigned slot = path.slots[path.depth - 1];
+        Inner* left = slot > 0 ? static_cast<Inner*>(par->children[slot - 1]) : NULL;
+        Inner* right = slot < par->count ? static_cast<Inner*>(par->children[slot + 1]) : NULL;
+
+        if(left != NULL && left->count > INNER_MIN){
+            // rotate right through the parent's separator
+            insertAt(node->keys(), node->count, 0, par->keys()[slot - 1]);
+            insertAt(node->children, node->count + 1, 0, left->children[left->count]);
+            node->count++;
+            par->keys()[slot - 1] = left->keys()[left->count - 1];
+            left->keys()[left->count - 1].~Key();
+            left->count--;
+            return;
+        }
+        if(right != NULL && right->count > INNER_MIN){
+            // rotate left through the parent's separator
+            insertAt(node->keys(), node->count, node->count, par->keys()[slot]);
+            insertAt(node->children, node->count + 1, node->count + 1, right->children[0]);
+            node->count++;
+            par->keys()[slot] = right->keys()[0];
+            eraseAt(right->keys(), right->count, 0);
+            eraseAt(right->children, right->count + 1, 0);
+            right->count--;
+            return;
+        }
+
+        // merge the right one of the pair and the separator into the left one
+        Inner* into = node;
+        Inner* from = right;
+        unsigned sepSlot = slot;
+        if(left != NULL){
+            into = left;
+            from = node;
+            sepSlot = slot - 1;
+        }
+        new (into->keys() + into->count) Key(par->keys()[sepSlot]);
+        moveRange(from->keys(), from->count, into->keys() + into->count + 1);
+        std::copy(from->children, from->children + from->count + 1, into->children + into->count + 1);
+        into->count += from->count + 1;
+        from->count = 0;
+        freeNode(from);
+        nodeBytes_ -= sizeof(Inner);
+
+        eraseAt(par->keys(), par->count, sepSlot);
+        eraseAt(par->children, par->count + 1, sepSlot + 1);
+        par->count--;
+        path.depth--;
+    }
+}
+
+/**
+* Inserts item at pos among count constructed items, shifting the rest
+* up into the uninitialized slot at count.
+*/
+template<typename Key, typename Value>
+template<typename T>
+void BPlusTree<Key, Value>::insertAt(T* items, unsigned count, unsigned pos, const T& item)
+{
+    if(pos == count){
+        new (items + count) T(item);
+        return;
+    }
+    T copy(item);   // item may live in this array
+    new (items + count) T(std::move(items[count - 1]));
+    for(unsigned i = count - 1; i > pos; --i){
+        items[i] = std::move(items[i - 1]);
+    }
+    items[pos] = std::move(copy);
+}
+
+/**
+* Removes the item at pos among count, leaving slot count - 1 unconstructed.
+*/
+template<typename Key, typename Value>
+template<typename T>
+void BPlusTree<Key, Value>::eraseAt(T* items, unsigned count, unsigned pos)
+{
+    for(unsigned i = pos; i + 1 < count; ++i){
+        items[i] = std::move(items[i + 1]);
+    }
+    items[count - 1].~T();
+}
+
+/**
+* Move-constructs count items into uninitialized storage and destroys
+* the originals.
+*/
+template<typename Key, typename Value>
+template<typename T>
+void BPlusTree<Key, Value>::moveRange(T* from, unsigned count, T* to)
+{
+    for(unsigned i = 0; i < count; ++i){
+        new (to + i) T(std::move(from[i]));
+        from[i].~T();
+    }
+}
+
+/*
+---------------------------------------------------
+End implementations for the BPlusTree class.
+---------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,1522 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "bst.h"
+#include "avlbst.h"
+#include "bst_wal.h"
+#include "compact_avl.h"
+#include "hotcold_avl.h"
+#include "key_set.h"
+#include "hashed_avl.h"
+#include "bst_filter.h"
+#include "rbbst.h"
+#include "splaybst.h"
+#include "scapegoatbst.h"
+#include "bplus_tree.h"
+#include "radix_tree.h"
+#include "small_map.h"
+#include "weightedbst.h"
+#include "static_map.h"
+
+using namespace std;
+
+// Usage: bst-bench [section]
+// Runs every benchmark section, or only the one named on the command line.
+
+typedef chrono::steady_clock benchClock;
+
+double secondsSince(benchClock::time_point start)
+{
+    return chrono::duration<double>(benchClock::now() - start).count();
+}
+
+void report(const string& name, size_t ops, double seconds)
+{
+    cout << "  " << left << setw(34) << name << right
+         << setw(12) << fixed << setprecision(0) << ops / seconds << " ops/s"
+         << setw(10) << setprecision(3) << seconds << " s" << endl;
+}
+
+// Bytes currently allocated from the heap
+size_t heapInUse()
+{
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+void reportMemory(const string& name, size_t bytes, size_t count)
+{
+    cout << "  " << left << setw(34) << name << right
+         << setw(12) << bytes / 1024 << " KB"
+         << setw(10) << fixed << setprecision(1) << (double)bytes / count << " B/entry" << endl;
+}
+
+bool wanted(int argc, char* argv[], const char* section)
+{
+    return argc < 2 || strcmp(argv[1], section) == 0;
+}
+
+// Write throughput of LoggedAVLTree under each sync policy
+void benchWal()
+{
+    cout << "wal: LoggedAVLTree<int,int> inserts" << endl;
+    const char* base = "bst-bench-wal";
+    struct { const char* name; SyncPolicy policy; size_t groupSize; size_t ops; } runs[] = {
+        { "AVLTree (no log)", SYNC_NONE, 1, 200000 },
+        { "SYNC_NONE", SYNC_NONE, 1, 200000 },
+        { "SYNC_GROUP (1024)", SYNC_GROUP, 1024, 200000 },
+        { "SYNC_GROUP (64)", SYNC_GROUP, 64, 20000 },
+        { "SYNC_EVERY_WRITE", SYNC_EVERY_WRITE, 1, 2000 },
+    };
+
+    for(size_t r = 0; r < sizeof(runs) / sizeof(runs[0]); ++r) {
+        std::remove("bst-bench-wal.snap");
+        std::remove("bst-bench-wal.wal");
+        benchClock::time_point start = benchClock::now();
+        if(r == 0) {
+            AVLTree<int,int> tree;
+            for(size_t i = 0; i < runs[r].ops; ++i) {
+                tree.insert(std::make_pair((int)(i * 2654435761u), (int)i));
+            }
+        }
+        else {
+            WalOptions options;
+            options.policy = runs[r].policy;
+            options.groupSize = runs[r].groupSize;
+            LoggedAVLTree<int,int> tree(base, options);
+            for(size_t i = 0; i < runs[r].ops; ++i) {
+                tree.insert(std::make_pair((int)(i * 2654435761u), (int)i));
+            }
+            tree.sync();
+        }
+        report(runs[r].name, runs[r].ops, secondsSince(start));
+    }
+
+    // recovery time for the last large log
+    WalOptions options;
+    options.policy = SYNC_NONE;
+    {
+        LoggedAVLTree<int,int> tree(base, options);
+        for(size_t i = 0; i < 200000; ++i) {
+            tree.insert(std::make_pair((int)(i * 2654435761u), (int)i));
+        }
+        tree.sync();
+    }
+    benchClock::time_point start = benchClock::now();
+    {
+        LoggedAVLTree<int,int> tree(base, options);
+    }
+    report("recover (replay 200000)", 200000, secondsSince(start));
+    {
+        LoggedAVLTree<int,int> tree(base, options);
+        tree.checkpoint();
+    }
+    start = benchClock::now();
+    {
+        LoggedAVLTree<int,int> tree(base, options);
+    }
+    report("recover (checkpoint 200000)", 200000, secondsSince(start));
+
+    std::remove("bst-bench-wal.snap");
+    std::remove("bst-bench-wal.wal");
+}
+
+// Per-entry memory of the pointer and compact node layouts
+void benchMemory()
+{
+    const size_t count = 1000000;
+    cout << "memory: " << count << " int -> int entries" << endl;
+    cout << "  sizeof(AVLNode<int,int>) = " << sizeof(AVLNode<int,int>) << endl;
+
+    size_t before = heapInUse();
+    {
+        AVLTree<int,int> tree;
+        benchClock::time_point start = benchClock::now();
+        for(size_t i = 0; i < count; ++i) {
+            tree.insert(std::make_pair((int)(i * 2654435761u), (int)i));
+        }
+        double seconds = secondsSince(start);
+        reportMemory("AVLTree", heapInUse() - before, count);
+        report("AVLTree insert", count, seconds);
+    }
+
+    before = heapInUse();
+    {
+        CompactAVLTree<int,int> tree;
+        benchClock::time_point start = benchClock::now();
+        for(size_t i = 0; i < count; ++i) {
+            tree.insert(std::make_pair((int)(i * 2654435761u), (int)i));
+        }
+        double seconds = secondsSince(start);
+        reportMemory("CompactAVLTree", heapInUse() - before, count);
+        reportMemory("CompactAVLTree (reported)", tree.memoryUsage(), count);
+        report("CompactAVLTree insert", count, seconds);
+    }
+}
+
+// A value of N bytes
+template<size_t N>
+struct Blob
+{
+    char data[N];
+};
+
+// needed by BinarySearchTree::printRoot()
+template<size_t N>
+ostream& operator<<(ostream& out, const Blob<N>& blob)
+{
+    return out << "blob" << N;
+}
+
+// Random-key finds and a full in-order scan over a tree of count entries
+template<typename Tree, size_t N>
+void benchFindScan(const string& name, size_t count)
+{
+    Tree tree;
+    Blob<N> blob;
+    memset(blob.data, 1, N);
+    for(size_t i = 0; i < count; ++i) {
+        tree.insert(std::make_pair((int)(i * 2654435761u), blob));
+    }
+
+    size_t found = 0;
+    const size_t lookups = 1000000;
+    benchClock::time_point start = benchClock::now();
+    for(size_t i = 0; i < lookups; ++i) {
+        size_t k = (i * 40503u) % count;
+        found += tree.find((int)(k * 2654435761u)) != tree.end();
+    }
+    report(name + " find", lookups, secondsSince(start));
+
+    size_t sum = 0;
+    start = benchClock::now();
+    for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it) {
+        sum += it->first;
+    }
+    report(name + " key scan", count, secondsSince(start));
+    if(found != lookups || sum == 1) {
+        cout << "  unexpected result" << endl;
+    }
+}
+
+template<size_t N>
+void benchHotColdSize()
+{
+    // keep each tree's values around 128 MB
+    size_t count = (size_t(128) << 20) / N;
+    if(count > 1000000) {
+        count = 1000000;
+    }
+    cout << "  -- " << N << "-byte values, " << count << " entries" << endl;
+    benchFindScan<AVLTree<int, Blob<N> >, N>("AVLTree", count);
+    benchFindScan<CompactAVLTree<int, Blob<N> >, N>("CompactAVLTree", count);
+    benchFindScan<HotColdAVLTree<int, Blob<N> >, N>("HotColdAVLTree", count);
+}
+
+// Inline versus out-of-line values as the value size grows
+void benchHotCold()
+{
+    cout << "hotcold: find and scan by value size" << endl;
+    benchHotColdSize<8>();
+    benchHotColdSize<64>();
+    benchHotColdSize<1024>();
+}
+
+// Inserts then finds count keys in a map-form or set-form container,
+// reporting heap bytes per key and both throughputs
+template<typename Tree, typename InsertKey>
+void benchSetForm(const string& name, size_t count, InsertKey insertKey)
+{
+    size_t before = heapInUse();
+    Tree tree;
+    benchClock::time_point start = benchClock::now();
+    for(size_t i = 0; i < count; ++i) {
+        insertKey(tree, (int)(i * 2654435761u));
+    }
+    double insertSeconds = secondsSince(start);
+    reportMemory(name, heapInUse() - before, count);
+    report(name + " insert", count, insertSeconds);
+
+    size_t found = 0;
+    start = benchClock::now();
+    for(size_t i = 0; i < count; ++i) {
+        found += tree.find((int)(i * 2654435761u)) != tree.end();
+    }
+    report(name + " find", count, secondsSince(start));
+    if(found != count) {
+        cout << "  unexpected result" << endl;
+    }
+}
+
+struct InsertMapKey
+{
+    template<typename Tree>
+    void operator()(Tree& tree, int key) const { tree.insert(std::make_pair(key, true)); }
+};
+
+struct InsertSetKey
+{
+    template<typename Set>
+    void operator()(Set& set, int key) const { set.insert(key); }
+};
+
+// Sets with key-only nodes against the <Key, bool> map form
+void benchSets()
+{
+    const size_t count = 1000000;
+    cout << "sets: " << count << " int keys" << endl;
+    benchSetForm<BinarySearchTree<int,bool> >("BinarySearchTree<int,bool>", count, InsertMapKey());
+    benchSetForm<BSTSet<int> >("BSTSet<int>", count, InsertSetKey());
+    benchSetForm<AVLTree<int,bool> >("AVLTree<int,bool>", count, InsertMapKey());
+    benchSetForm<CompactAVLTree<int,bool> >("CompactAVLTree<int,bool>", count, InsertMapKey());
+    benchSetForm<AVLSet<int> >("AVLSet<int>", count, InsertSetKey());
+}
+
+// A std::string key without KeyTraits, so trees compare it in full
+struct PlainString
+{
+    string str;
+    bool operator==(const PlainString& rhs) const { return str == rhs.str; }
+    bool operator<(const PlainString& rhs) const { return str < rhs.str; }
+};
+
+ostream& operator<<(ostream& out, const PlainString& key)
+{
+    return out << key.str;
+}
+
+PlainString toKey(const string& str, PlainString*)
+{
+    PlainString key;
+    key.str = str;
+    return key;
+}
+
+string toKey(const string& str, string*)
+{
+    return str;
+}
+
+// URL-like keys: "https://www." and a host drawn from hostCount names,
+// then a path with numeric ids
+vector<string> makeUrls(size_t count, size_t hostCount)
+{
+    const char* sections[] = { "products", "articles", "users", "static/img", "v2/items" };
+    vector<string> urls;
+    urls.reserve(count);
+    for(size_t i = 0; i < count; ++i) {
+        unsigned mix = (unsigned)(i * 2654435761u);
+        unsigned host = (mix >> 7) % hostCount;
+        ostringstream out;
+        out << "https://www.";
+        for(int c = 0; c < 8; ++c) {
+            out << (char)('a' + (host * 2246822519u >> (c * 3)) % 26);
+        }
+        out << ".com/" << sections[(mix >> 3) % 5] << "/" << (mix >> 6) << "/page-" << i;
+        urls.push_back(out.str());
+    }
+    return urls;
+}
+
+template<typename Tree, typename Key>
+void benchStringKeys(const string& name, const vector<string>& urls)
+{
+    vector<Key> keys;
+    keys.reserve(urls.size());
+    for(size_t i = 0; i < urls.size(); ++i) {
+        keys.push_back(toKey(urls[i], (Key*)NULL));
+    }
+
+    Tree tree;
+    benchClock::time_point start = benchClock::now();
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(std::make_pair(keys[i], (int)i));
+    }
+    report(name + " insert", keys.size(), secondsSince(start));
+
+    size_t found = 0;
+    const size_t lookups = 1000000;
+    start = benchClock::now();
+    for(size_t i = 0; i < lookups; ++i) {
+        found += tree.find(keys[(i * 40503u) % keys.size()]) != tree.end();
+    }
+    report(name + " find", lookups, secondsSince(start));
+    if(found != lookups) {
+        cout << "  unexpected result" << endl;
+    }
+}
+
+// Cached key prefix against full string comparisons
+void benchStrings()
+{
+    const size_t count = 500000;
+    cout << "strings: " << count << " URL keys, " << KEY_PREFIX_BYTES << "-byte cached prefix" << endl;
+    size_t hostCounts[] = { 100000, 5 };
+    for(size_t h = 0; h < 2; ++h) {
+        cout << "  -- " << hostCounts[h] << " hosts" << endl;
+        vector<string> urls = makeUrls(count, hostCounts[h]);
+        benchStringKeys<BinarySearchTree<PlainString,int>, PlainString>("BST (full compare)", urls);
+        benchStringKeys<BinarySearchTree<string,int>, string>("BST (cached prefix)", urls);
+        benchStringKeys<AVLTree<PlainString,int>, PlainString>("AVLTree (full compare)", urls);
+        benchStringKeys<AVLTree<string,int>, string>("AVLTree (cached prefix)", urls);
+    }
+}
+
+// Point lookups through the hash side-index against the tree walk,
+// plus an in-order scan to show ordered access is unchanged
+void benchHashed()
+{
+    const size_t count = 1000000;
+    cout << "hashed: " << count << " int -> int entries" << endl;
+    benchFindScan<AVLTree<int, Blob<8> >, 8>("AVLTree", count);
+    benchFindScan<HashedAVLTree<int, Blob<8> >, 8>("HashedAVLTree", count);
+
+    HashedAVLTree<int,int> tree;
+    for(size_t i = 0; i < count; ++i) {
+        tree.insert(std::make_pair((int)(i * 2654435761u), (int)i));
+    }
+    reportMemory("HashedAVLTree index", tree.indexMemoryUsage(), count);
+}
+
+// Finds where a given share of the probed keys is absent
+template<typename Tree>
+double timeProbes(const Tree& tree, size_t count, size_t lookups, unsigned absentPercent)
+{
+    size_t found = 0;
+    benchClock::time_point start = benchClock::now();
+    for(size_t i = 0; i < lookups; ++i) {
+        size_t k = (i * 40503u) % count;
+        // present keys are k * 2654435761, absent ones are offset by one
+        bool absent = (i * 7919u) % 100 < absentPercent;
+        found += tree.find((int)(k * 2654435761u + absent)) != tree.end();
+    }
+    double seconds = secondsSince(start);
+    if(found == lookups + 1) {
+        cout << "  unexpected result" << endl;
+    }
+    return seconds;
+}
+
+// Counting Bloom filter in front of find, by share of absent keys
+void benchFilter()
+{
+    const size_t count = 1000000;
+    const size_t lookups = 1000000;
+    cout << "filter: " << count << " int -> int entries" << endl;
+    AVLTree<int,int> plain;
+    FilteredTree<int,int> filtered;
+    for(size_t i = 0; i < count; ++i) {
+        plain.insert(std::make_pair((int)(i * 2654435761u), (int)i));
+        filtered.insert(std::make_pair((int)(i * 2654435761u), (int)i));
+    }
+
+    unsigned absentPercents[] = { 0, 50, 90, 100 };
+    for(size_t a = 0; a < 4; ++a) {
+        ostringstream label;
+        label << absentPercents[a] << "% absent";
+        report("AVLTree find, " + label.str(), lookups,
+            timeProbes(plain, count, lookups, absentPercents[a]));
+        filtered.resetFilterStats();
+        report("FilteredTree find, " + label.str(), lookups,
+            timeProbes(filtered, count, lookups, absentPercents[a]));
+    }
+    const FilterStats& stats = filtered.filterStats();
+    cout << "  false positive rate " << setprecision(4) << stats.falsePositiveRate()
+         << ", walks skipped " << stats.rejected << " of " << stats.lookups << endl;
+    reportMemory("FilteredTree filter", filtered.filterMemoryUsage(), count);
+}
+
+// Lets std::map run the same workloads as the trees
+template<typename Tree>
+void treeInsert(Tree& tree, int key, int value) { tree.insert(std::make_pair(key, value)); }
+void treeInsert(map<int,int>& tree, int key, int value) { tree[key] = value; }
+
+template<typename Tree>
+void treeRemove(Tree& tree, int key) { tree.remove(key); }
+void treeRemove(map<int,int>& tree, int key) { tree.erase(key); }
+
+// Random-key workloads over count keys: fill, read-only, read-mostly
+// (90% find, 5% insert, 5% remove) and write-heavy (50% insert, 50% remove)
+template<typename Tree>
+void benchEngine(const string& name, size_t count)
+{
+    Tree tree;
+    benchClock::time_point start = benchClock::now();
+    for(size_t i = 0; i < count; ++i) {
+        treeInsert(tree, (int)(i * 2654435761u), (int)i);
+    }
+    report(name + " insert", count, secondsSince(start));
+
+    const size_t ops = 1000000;
+    unsigned findPercents[] = { 100, 90, 0 };
+    const char* labels[] = { " find", " 90/5/5 mix", " 50/50 ins/rem" };
+    size_t found = 0;
+    for(size_t m = 0; m < 3; ++m) {
+        start = benchClock::now();
+        for(size_t i = 0; i < ops; ++i) {
+            unsigned roll = (unsigned)((i * 7919u) % 100);
+            int key = (int)(((i * 40503u) % (2 * count)) * 2654435761u);
+            if(roll < findPercents[m]) {
+                found += tree.find(key) != tree.end();
+            } else if((roll - findPercents[m]) % 2 == 0) {
+                treeInsert(tree, key, (int)i);
+            } else {
+                treeRemove(tree, key);
+            }
+        }
+        report(name + labels[m], ops, secondsSince(start));
+    }
+    if(found == 1) {
+        cout << "  unexpected result" << endl;
+    }
+}
+
+// Runs one benchmark in a child process, so that it starts from a fresh
+// heap instead of the scattered free lists left by the previous tree
+template<typename Bench>
+void runIsolated(Bench bench)
+{
+    cout.flush();
+    pid_t pid = fork();
+    if(pid == 0) {
+        bench();
+        cout.flush();
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+}
+
+template<typename Tree>
+struct EngineBench
+{
+    const char* name;
+    size_t count;
+    void operator()() const { benchEngine<Tree>(name, count); }
+};
+
+// The tree engines against each other and std::map
+void benchEngines()
+{
+    const size_t count = 1000000;
+    cout << "engines: " << count << " int -> int entries" << endl;
+    EngineBench<BinarySearchTree<int,int> > bst = { "BinarySearchTree", count };
+    EngineBench<AVLTree<int,int> > avl = { "AVLTree", count };
+    EngineBench<RBTree<int,int> > rb = { "RBTree", count };
+    EngineBench<map<int,int> > stdMap = { "std::map", count };
+    runIsolated(bst);
+    runIsolated(avl);
+    runIsolated(rb);
+    runIsolated(stdMap);
+}
+
+// Draws ranks 0..n-1 with probability proportional to 1 / (rank + 1)^s
+class ZipfSampler
+{
+public:
+    ZipfSampler(size_t n, double s, unsigned seed) : cdf_(n), rng_(seed), unit_(0.0, 1.0)
+    {
+        double sum = 0;
+        for(size_t i = 0; i < n; ++i) {
+            sum += 1.0 / pow((double)(i + 1), s);
+            cdf_[i] = sum;
+        }
+        for(size_t i = 0; i < n; ++i) {
+            cdf_[i] /= sum;
+        }
+    }
+
+    size_t operator()()
+    {
+        double u = unit_(rng_);
+        size_t rank = lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin();
+        return rank < cdf_.size() ? rank : cdf_.size() - 1;
+    }
+
+private:
+    vector<double> cdf_;
+    mt19937_64 rng_;
+    uniform_real_distribution<double> unit_;
+};
+
+// Finds for a pre-drawn key sequence, timed after the tree is built
+template<typename Tree>
+void benchAccess(const string& name, Tree& tree, const vector<int>& probes)
+{
+    size_t found = 0;
+    benchClock::time_point start = benchClock::now();
+    for(size_t i = 0; i < probes.size(); ++i) {
+        found += tree.find(probes[i]) != tree.end();
+    }
+    report(name, probes.size(), secondsSince(start));
+    if(found != probes.size()) {
+        cout << "  unexpected result" << endl;
+    }
+}
+
+// Only splay trees have a splay fraction to set
+template<typename Tree>
+void configureTree(Tree&, double) { }
+void configureTree(SplayTree<int,int>& tree, double splayFraction) { tree.setSplayFraction(splayFraction); }
+
+template<typename Tree>
+struct AccessBench
+{
+    const char* name;
+    double splayFraction;
+    const vector<int>* probes;
+    const vector<int>* sortedKeys;
+    void operator()() const
+    {
+        // every tree starts out perfectly balanced
+        Tree tree;
+        configureTree(tree, splayFraction);
+        tree.assignSorted(sortedKeys->begin(), sortedKeys->begin(), sortedKeys->size());
+        benchAccess(name, tree, *probes);
+    }
+};
+
+// Splay trees (always and sampled splaying) against AVLTree on Zipfian
+// and uniform lookups
+void benchSplay()
+{
+    const size_t count = 1000000;
+    const size_t lookups = 2000000;
+    cout << "splay: " << count << " int -> int entries, " << lookups << " finds" << endl;
+
+    vector<int> sortedKeys(count);
+    for(size_t i = 0; i < count; ++i) {
+        sortedKeys[i] = (int)(i * 2654435761u);
+    }
+    sort(sortedKeys.begin(), sortedKeys.end());
+
+    ZipfSampler zipfMild(count, 0.99, 42);
+    ZipfSampler zipfSteep(count, 1.2, 43);
+    mt19937_64 rng(42);
+    vector<int> mildProbes(lookups);
+    vector<int> steepProbes(lookups);
+    vector<int> uniformProbes(lookups);
+    for(size_t i = 0; i < lookups; ++i) {
+        // ranks are scattered over the key space by the key mapping
+        mildProbes[i] = (int)(zipfMild() * 2654435761u);
+        steepProbes[i] = (int)(zipfSteep() * 2654435761u);
+        uniformProbes[i] = (int)((rng() % count) * 2654435761u);
+    }
+
+    const char* workloads[] = { "Zipf 0.99", "Zipf 1.2", "uniform" };
+    const vector<int>* probes[] = { &mildProbes, &steepProbes, &uniformProbes };
+    for(size_t w = 0; w < 3; ++w) {
+        cout << "  -- " << workloads[w] << endl;
+        AccessBench<AVLTree<int,int> > avl = { "AVLTree", 1.0, probes[w], &sortedKeys };
+        AccessBench<SplayTree<int,int> > splayAll = { "SplayTree (splay all)", 1.0, probes[w], &sortedKeys };
+        AccessBench<SplayTree<int,int> > splaySampled = { "SplayTree (splay 10%)", 0.1, probes[w], &sortedKeys };
+        runIsolated(avl);
+        runIsolated(splayAll);
+        runIsolated(splaySampled);
+    }
+}
+
+// Only scapegoat trees report rebuild work
+template<typename Tree>
+void reportRebuilds(const Tree&) { }
+void reportRebuilds(const ScapegoatTree<int,int>& tree)
+{
+    const ScapegoatStats& stats = tree.stats();
+    cout << "  " << stats.rebuilds << " rebuilds, " << setprecision(2)
+         << stats.nodesPerUpdate() << " nodes relinked per update" << endl;
+}
+
+template<typename Tree>
+struct UpdateBench
+{
+    const char* name;
+    size_t count;
+    bool ascending;     // keys in increasing order instead of scattered
+    int keyOf(size_t i) const { return ascending ? (int)i : (int)(i * 2654435761u); }
+    void operator()() const
+    {
+        size_t before = heapInUse();
+        Tree tree;
+        benchClock::time_point start = benchClock::now();
+        for(size_t i = 0; i < count; ++i) {
+            tree.insert(std::make_pair(keyOf(i), (int)i));
+        }
+        double insertSeconds = secondsSince(start);
+        reportMemory(name, heapInUse() - before, count);
+        report(string(name) + " insert", count, insertSeconds);
+
+        size_t found = 0;
+        start = benchClock::now();
+        for(size_t i = 0; i < count; ++i) {
+            found += tree.find(keyOf((i * 40503u) % count)) != tree.end();
+        }
+        report(string(name) + " find", count, secondsSince(start));
+
+        start = benchClock::now();
+        for(size_t i = 0; i < count; i += 2) {
+            tree.remove(keyOf(i));
+        }
+        report(string(name) + " remove half", count / 2, secondsSince(start));
+        reportRebuilds(tree);
+        if(found != count) {
+            cout << "  unexpected result" << endl;
+        }
+    }
+};
+
+// Scapegoat trees keep no per-node balance; compare their memory and
+// amortized update cost with the metadata-carrying engines
+void benchScapegoat()
+{
+    const size_t count = 1000000;
+    cout << "scapegoat: " << count << " int -> int entries" << endl;
+    cout << "  sizeof(Node<int,int>) = " << sizeof(Node<int,int>)
+         << ", sizeof(AVLNode<int,int>) = " << sizeof(AVLNode<int,int>) << endl;
+    for(int ascending = 0; ascending < 2; ++ascending) {
+        cout << "  -- " << (ascending ? "ascending" : "scattered") << " keys" << endl;
+        UpdateBench<AVLTree<int,int> > avl = { "AVLTree", count, ascending != 0 };
+        UpdateBench<RBTree<int,int> > rb = { "RBTree", count, ascending != 0 };
+        UpdateBench<ScapegoatTree<int,int> > scapegoat = { "ScapegoatTree", count, ascending != 0 };
+        runIsolated(avl);
+        runIsolated(rb);
+        runIsolated(scapegoat);
+    }
+}
+
+template<typename Tree>
+struct FindScanBench
+{
+    const char* name;
+    size_t count;
+    void operator()() const { benchFindScan<Tree, 8>(name, count); }
+};
+
+// The B+-tree against the binary engines: updates, point lookups and scans
+void benchBPlus()
+{
+    const size_t count = 1000000;
+    cout << "bplus: " << count << " int -> int entries, "
+         << BPlusTree<int,int>::CAPACITY << " keys per node" << endl;
+    EngineBench<AVLTree<int,int> > avl = { "AVLTree", count };
+    EngineBench<RBTree<int,int> > rb = { "RBTree", count };
+    EngineBench<BPlusTree<int,int> > bplus = { "BPlusTree", count };
+    runIsolated(avl);
+    runIsolated(rb);
+    runIsolated(bplus);
+
+    cout << "  -- 8-byte values, find and scan" << endl;
+    FindScanBench<AVLTree<int, Blob<8> > > avlScan = { "AVLTree", count };
+    FindScanBench<BPlusTree<int, Blob<8> > > bplusScan = { "BPlusTree", count };
+    runIsolated(avlScan);
+    runIsolated(bplusScan);
+}
+
+template<typename Tree>
+struct RadixBench
+{
+    const char* name;
+    size_t count;
+    bool dense;     // consecutive ids instead of hashed 64-bit keys
+    uint64_t keyOf(size_t i) const { return dense ? i : i * 0x9E3779B97F4A7C15ull; }
+    void operator()() const
+    {
+        size_t before = heapInUse();
+        Tree tree;
+        benchClock::time_point start = benchClock::now();
+        for(size_t i = 0; i < count; ++i) {
+            tree.insert(std::make_pair(keyOf((i * 40503u) % count), (uint64_t)i));
+        }
+        double insertSeconds = secondsSince(start);
+        reportMemory(name, heapInUse() - before, count);
+        report(string(name) + " insert", count, insertSeconds);
+
+        size_t found = 0;
+        start = benchClock::now();
+        for(size_t i = 0; i < count; ++i) {
+            found += tree.find(keyOf((i * 7919u) % count)) != tree.end();
+        }
+        report(string(name) + " find", count, secondsSince(start));
+
+        // half the probes fall between keys
+        uint64_t sum = 0;
+        start = benchClock::now();
+        for(size_t i = 0; i < count; ++i) {
+            typename Tree::iterator it = tree.lower_bound(keyOf((i * 7919u) % count) + (i & 1));
+            sum += it != tree.end() ? it->second : 0;
+        }
+        report(string(name) + " lower_bound", count, secondsSince(start));
+
+        start = benchClock::now();
+        for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it) {
+            sum += it->first;
+        }
+        report(string(name) + " scan", count, secondsSince(start));
+
+        start = benchClock::now();
+        for(size_t i = 0; i < count; i += 2) {
+            tree.remove(keyOf(i));
+        }
+        report(string(name) + " remove half", count / 2, secondsSince(start));
+        if(found != count || sum == 1) {
+            cout << "  unexpected result" << endl;
+        }
+    }
+};
+
+// The radix tree against the comparison trees on 64-bit integer keys
+void benchRadix()
+{
+    const size_t count = 1000000;
+    cout << "radix: " << count << " uint64_t -> uint64_t entries" << endl;
+    for(int dense = 1; dense >= 0; --dense) {
+        cout << "  -- " << (dense ? "dense" : "sparse") << " keys" << endl;
+        RadixBench<AVLTree<uint64_t, uint64_t> > avl = { "AVLTree", count, dense != 0 };
+        RadixBench<BPlusTree<uint64_t, uint64_t> > bplus = { "BPlusTree", count, dense != 0 };
+        RadixBench<RadixTree<uint64_t, uint64_t> > radix = { "RadixTree", count, dense != 0 };
+        runIsolated(avl);
+        runIsolated(bplus);
+        runIsolated(radix);
+    }
+}
+
+// Finds for every key of a tree holding 0..count-1
+template<typename Tree>
+void benchSortedFinds(const string& name, const Tree& tree, size_t count)
+{
+    size_t found = 0;
+    benchClock::time_point start = benchClock::now();
+    for(size_t i = 0; i < count; ++i) {
+        found += tree.find((int)((i * 40503u) % count)) != tree.end();
+    }
+    report(name, count, secondsSince(start));
+    if(found != count) {
+        cout << "  unexpected result" << endl;
+    }
+}
+
+// A BinarySearchTree fed sorted keys, left alone, rebalanced once with
+// DSW and kept in shape by the automatic trigger
+void benchRebalance()
+{
+    const size_t count = 30000;
+    cout << "rebalance: " << count << " sorted int keys into BinarySearchTree" << endl;
+
+    BinarySearchTree<int,int> plain;
+    benchClock::time_point start = benchClock::now();
+    for(size_t i = 0; i < count; ++i) {
+        plain.insert(std::make_pair((int)i, (int)i));
+    }
+    report("plain insert", count, secondsSince(start));
+    benchSortedFinds("plain find", plain, count);
+
+    start = benchClock::now();
+    plain.rebalance();
+    cout << "  rebalance() took " << fixed << setprecision(3)
+         << secondsSince(start) * 1000 << " ms" << endl;
+    benchSortedFinds("rebalanced find", plain, count);
+
+    for(double factor = 2; factor <= 4; factor *= 2) {
+        BinarySearchTree<int,int> automatic;
+        automatic.setRebalanceFactor(factor);
+        ostringstream label;
+        label << "factor " << factor;
+        start = benchClock::now();
+        for(size_t i = 0; i < count; ++i) {
+            automatic.insert(std::make_pair((int)i, (int)i));
+        }
+        report(label.str() + " insert", count, secondsSince(start));
+        benchSortedFinds(label.str() + " find", automatic, count);
+    }
+
+    const size_t large = 1000000;
+    BinarySearchTree<int,int> scattered;
+    for(size_t i = 0; i < large; ++i) {
+        scattered.insert(std::make_pair((int)(i * 2654435761u), (int)i));
+    }
+    start = benchClock::now();
+    scattered.rebalance();
+    cout << "  rebalance() of " << large << " scattered keys took "
+         << secondsSince(start) * 1000 << " ms" << endl;
+}
+
+struct TeardownBench
+{
+    size_t count;
+    bool parallel;
+    void operator()() const
+    {
+        vector<int> keys(count);
+        for(size_t i = 0; i < count; ++i) {
+            keys[i] = (int)i;
+        }
+        BinarySearchTree<int,int> tree;
+        tree.assignSorted(keys.begin(), keys.begin(), count);
+        benchClock::time_point start = benchClock::now();
+        bool balanced = tree.isBalanced();
+        report("isBalanced() balanced", count, secondsSince(start));
+        start = benchClock::now();
+        tree.clear(parallel);
+        report(parallel ? "clear(true)" : "clear()", count, secondsSince(start));
+        if(!balanced) {
+            cout << "  unexpected result" << endl;
+        }
+    }
+};
+
+// Teardown and validation at sizes and shapes that used to overflow the
+// stack: a balanced tree freed serially and in parallel, and a
+// degenerate one checked and freed
+void benchTeardown()
+{
+    const size_t count = 4000000;
+    cout << "teardown: " << count << " int -> int entries, "
+         << thread::hardware_concurrency() << " hardware threads" << endl;
+    TeardownBench serial = { count, false };
+    TeardownBench parallel = { count, true };
+    runIsolated(serial);
+    runIsolated(parallel);
+
+    // sorted inserts cost O(n^2), so the degenerate tree stays smaller
+    const size_t chain = 60000;
+    BinarySearchTree<int,int> vine;
+    for(size_t i = 0; i < chain; ++i) {
+        vine.insert(std::make_pair((int)i, (int)i));
+    }
+    benchClock::time_point start = benchClock::now();
+    bool balanced = vine.isBalanced();
+    report("isBalanced() degenerate", chain, secondsSince(start));
+    start = benchClock::now();
+    vine.clear();
+    report("clear() degenerate", chain, secondsSince(start));
+    if(balanced) {
+        cout << "  unexpected result" << endl;
+    }
+}
+
+template<typename Tree>
+pair<int,int> treePopMin(Tree& tree) { return tree.pop_min(); }
+pair<int,int> treePopMin(map<int,int>& tree)
+{
+    pair<int,int> item = *tree.begin();
+    tree.erase(tree.begin());
+    return item;
+}
+template<typename Tree>
+vector<pair<int,int> > treePopMin(Tree& tree, size_t k) { return tree.pop_min(k); }
+vector<pair<int,int> > treePopMin(map<int,int>& tree, size_t k)
+{
+    map<int,int>::iterator last = tree.begin();
+    for(size_t i = 0; i < k && last != tree.end(); ++i) {
+        ++last;
+    }
+    vector<pair<int,int> > items(tree.begin(), last);
+    tree.erase(tree.begin(), last);
+    return items;
+}
+
+template<typename Tree>
+struct PQueueBench
+{
+    const char* name;
+    size_t count;
+    size_t holds;
+    void operator()() const
+    {
+        // hold model: each step retires the earliest event and schedules
+        // a new one a random delay later
+        mt19937 rng(43);
+        Tree tree;
+        int seq = 0;
+        while(tree.size() < count) {
+            tree.insert(std::make_pair((int)(rng() % (count * 16)), seq++));
+        }
+        benchClock::time_point start = benchClock::now();
+        for(size_t i = 0; i < holds; ++i) {
+            pair<int,int> event = treePopMin(tree);
+            int when = event.first + 1 + (int)(rng() % (count * 16));
+            while(tree.find(when) != tree.end()) {
+                when++;
+            }
+            tree.insert(std::make_pair(when, seq++));
+        }
+        report(string(name) + " pop + schedule", holds, secondsSince(start));
+
+        // retire the events due in the next window in batches
+        size_t drained = 0;
+        start = benchClock::now();
+        while(drained < count / 2) {
+            drained += treePopMin(tree, 64).size();
+        }
+        report(string(name) + " pop_min(64)", drained, secondsSince(start));
+        if(tree.size() != count - drained) {
+            cout << "  unexpected result" << endl;
+        }
+    }
+};
+
+// Priority-queue use: repeatedly reading and retiring the smallest key
+void benchPQueue()
+{
+    const size_t count = 1000000;
+    const size_t holds = 2000000;
+    cout << "pqueue: " << count << " pending events, " << holds << " holds" << endl;
+    PQueueBench<AVLTree<int,int> > avl = { "AVLTree", count, holds };
+    PQueueBench<RBTree<int,int> > rb = { "RBTree", count, holds };
+    PQueueBench<SplayTree<int,int> > splay = { "SplayTree", count, holds };
+    PQueueBench<map<int,int> > stdMap = { "std::map", count, holds };
+    runIsolated(avl);
+    runIsolated(rb);
+    runIsolated(splay);
+    runIsolated(stdMap);
+}
+
+template<typename Tree>
+struct EraseBench
+{
+    const char* name;
+    size_t count;
+    double fraction;    // share of the keys removed
+    bool bulk;          // erase_range / erase_if instead of remove() per key
+    void operator()() const
+    {
+        // inserted in random order, so neighbouring keys are scattered
+        // through the heap as they would be in a long-lived tree
+        vector<int> keys(count);
+        for(size_t i = 0; i < count; ++i) {
+            keys[i] = (int)i;
+        }
+        shuffle(keys.begin(), keys.end(), mt19937(44));
+        Tree tree;
+        for(size_t i = 0; i < count; ++i) {
+            tree.insert(std::make_pair(keys[i], keys[i]));
+        }
+        size_t k = (size_t)(fraction * count);
+        string label = string(name) + (bulk ? " erase_range " : " remove range ");
+        benchClock::time_point start = benchClock::now();
+        if(bulk) {
+            tree.erase_range(0, (int)k);
+        } else {
+            for(size_t i = 0; i < k; ++i) {
+                tree.remove((int)i);
+            }
+        }
+        report(label + to_string((int)(fraction * 100)) + "%", k, secondsSince(start));
+
+        // then every other survivor, found by a scan
+        size_t before = tree.size();
+        label = string(name) + (bulk ? " erase_if half" : " scan + remove half");
+        start = benchClock::now();
+        if(bulk) {
+            tree.erase_if([](const pair<const int,int>& item) { return item.first % 2 == 0; });
+        } else {
+            vector<int> matches;
+            for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it) {
+                if(it->first % 2 == 0) {
+                    matches.push_back(it->first);
+                }
+            }
+            for(size_t i = 0; i < matches.size(); ++i) {
+                tree.remove(matches[i]);
+            }
+        }
+        report(label, before - tree.size(), secondsSince(start));
+        if(tree.size() != (count - k + 1) / 2) {
+            cout << "  unexpected result" << endl;
+        }
+    }
+};
+
+// Expiring a key range or filtering the whole tree in bulk, against
+// removing the same keys one at a time
+void benchErase()
+{
+    // the smaller tree fits in cache; in the larger one, freeing the
+    // scattered nodes costs about as much as removing them
+    size_t counts[] = { 20000, 1000000 };
+    double fractions[] = { 0.01, 0.25, 0.9 };
+    for(int c = 0; c < 2; ++c) {
+        cout << "erase: " << counts[c] << " int -> int entries" << endl;
+        for(int f = 0; f < 3; ++f) {
+            for(int bulk = 0; bulk < 2; ++bulk) {
+                EraseBench<AVLTree<int,int> > avl = { "AVLTree", counts[c], fractions[f], bulk != 0 };
+                EraseBench<RBTree<int,int> > rb = { "RBTree", counts[c], fractions[f], bulk != 0 };
+                runIsolated(avl);
+                runIsolated(rb);
+            }
+        }
+    }
+}
+
+template<typename Tree>
+struct BatchBench
+{
+    const char* name;
+    size_t count;
+    size_t batch;
+    bool batched;       // apply_batch() instead of insert() / remove() per op
+    void operator()() const
+    {
+        mt19937 rng(45);
+        Tree tree;
+        for(size_t i = 0; i < count; ++i) {
+            int key = (int)(rng() % (count * 4));
+            tree.insert(std::make_pair(key, key));
+        }
+        // two inserts for every remove, at random keys
+        vector<BatchOp<int,int> > ops(batch);
+        for(size_t i = 0; i < batch; ++i) {
+            ops[i].remove = (i % 3 == 2);
+            ops[i].key = (int)(rng() % (count * 4));
+            ops[i].value = (int)i;
+        }
+
+        benchClock::time_point start = benchClock::now();
+        if(batched) {
+            tree.apply_batch(ops);
+        } else {
+            for(size_t i = 0; i < batch; ++i) {
+                if(ops[i].remove) {
+                    tree.remove(ops[i].key);
+                } else {
+                    tree.insert(std::make_pair(ops[i].key, ops[i].value));
+                }
+            }
+        }
+        report(string(name) + (batched ? " apply_batch " : " per-op ") + to_string(batch), batch,
+            secondsSince(start));
+        if(tree.size() < count / 2) {
+            cout << "  unexpected result" << endl;
+        }
+    }
+};
+
+// Batches of mutations applied at once, against one call per mutation
+void benchBatch()
+{
+    const size_t count = 1000000;
+    cout << "batch: " << count << " int -> int entries" << endl;
+    size_t batches[] = { 10000, 100000, 250000, 1000000 };
+    for(int b = 0; b < 4; ++b) {
+        for(int batched = 0; batched < 2; ++batched) {
+            BatchBench<AVLTree<int,int> > avl = { "AVLTree", count, batches[b], batched != 0 };
+            BatchBench<RBTree<int,int> > rb = { "RBTree", count, batches[b], batched != 0 };
+            runIsolated(avl);
+            runIsolated(rb);
+        }
+    }
+}
+
+template<typename Tree>
+struct HandleBench
+{
+    const char* name;
+    size_t count;
+    bool handles;       // extract() and insert(handle) instead of remove() and insert()
+    void operator()() const
+    {
+        mt19937 rng(46);
+        Tree active;
+        Tree expired;
+        vector<int> keys(count);
+        for(size_t i = 0; i < count; ++i) {
+            keys[i] = (int)(rng() % (count * 4));
+            active.insert(std::make_pair(keys[i], string(40, 'v')));
+        }
+        shuffle(keys.begin(), keys.end(), rng);
+
+        // move half the entries over one at a time
+        benchClock::time_point start = benchClock::now();
+        for(size_t i = 0; i < count / 2; ++i) {
+            if(handles) {
+                NodeHandle<int, string> handle = active.extract(keys[i]);
+                if(handle) {
+                    expired.insert(std::move(handle));
+                }
+            } else {
+                typename Tree::iterator it = active.find(keys[i]);
+                if(it != active.end()) {
+                    std::pair<const int, string> item = *it;
+                    active.remove(keys[i]);
+                    expired.insert(item);
+                }
+            }
+        }
+        report(string(name) + (handles ? " extract+insert" : " remove+insert"), count / 2,
+            secondsSince(start));
+
+        // then the rest in one go
+        size_t rest = active.size();
+        start = benchClock::now();
+        if(handles) {
+            expired.splice(active);
+        } else {
+            for(typename Tree::iterator it = active.begin(); it != active.end(); ++it) {
+                expired.insert(*it);
+            }
+            active.clear();
+        }
+        report(string(name) + (handles ? " splice" : " insert loop"), rest, secondsSince(start));
+        if(active.size() != 0) {
+            cout << "  unexpected result" << endl;
+        }
+    }
+};
+
+// Moving string-valued entries between trees, with and without node handles
+void benchHandles()
+{
+    size_t counts[] = { 50000, 1000000 };
+    for(int c = 0; c < 2; ++c) {
+        cout << "handles: " << counts[c] << " int -> string entries" << endl;
+        for(int handles = 0; handles < 2; ++handles) {
+            HandleBench<AVLTree<int, string> > avl = { "AVLTree", counts[c], handles != 0 };
+            HandleBench<RBTree<int, string> > rb = { "RBTree", counts[c], handles != 0 };
+            runIsolated(avl);
+            runIsolated(rb);
+        }
+    }
+}
+
+template<typename Tree>
+struct CompactBench
+{
+    const char* name;
+    size_t count;
+    void operator()() const
+    {
+        // churn: inserts and removes interleaved with other allocations,
+        // the way a long-lived map's nodes end up spread over the heap
+        mt19937 rng(47);
+        Tree tree;
+        vector<string*> other;
+        for(size_t i = 0; i < count * 3; ++i) {
+            int key = (int)(rng() % (count * 2));
+            if(i % 3 == 2) {
+                tree.remove(key);
+            } else {
+                tree.insert(std::make_pair(key, key));
+            }
+            other.push_back(new string(rng() % 64, 'x'));
+        }
+        for(size_t i = 0; i < other.size(); i += 2) {
+            delete other[i];
+        }
+        vector<int> probes(count);
+        for(size_t i = 0; i < count; ++i) {
+            probes[i] = (int)(rng() % (count * 2));
+        }
+
+        measure(tree, "churned", probes);
+        benchClock::time_point start = benchClock::now();
+        tree.compact();
+        report(string(name) + " compact() in-order", tree.size(), secondsSince(start));
+        measure(tree, "in-order", probes);
+        start = benchClock::now();
+        tree.compact(COMPACT_VEB);
+        report(string(name) + " compact() vEB", tree.size(), secondsSince(start));
+        measure(tree, "vEB", probes);
+
+        // the same work in bounded steps
+        double longest = 0;
+        start = benchClock::now();
+        bool done = false;
+        while(!done) {
+            benchClock::time_point step = benchClock::now();
+            done = tree.compactStep(4096);
+            longest = max(longest, secondsSince(step));
+        }
+        report(string(name) + " compactStep(4096) pass", tree.size(), secondsSince(start));
+        cout << "  longest step " << fixed << setprecision(2) << longest * 1000 << " ms" << endl;
+        measure(tree, "stepped", probes);
+
+        for(size_t i = 1; i < other.size(); i += 2) {
+            delete other[i];
+        }
+    }
+
+    void measure(Tree& tree, const char* layout, const vector<int>& probes) const
+    {
+        long sum = 0;
+        benchClock::time_point start = benchClock::now();
+        for(int pass = 0; pass < 5; ++pass) {
+            for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it) {
+                sum += it->second;
+            }
+        }
+        report(string(name) + " " + layout + " scan", tree.size() * 5, secondsSince(start));
+        start = benchClock::now();
+        for(size_t i = 0; i < probes.size(); ++i) {
+            sum += (tree.find(probes[i]) != tree.end());
+        }
+        report(string(name) + " " + layout + " find", probes.size(), secondsSince(start));
+        if(sum == 0) {
+            cout << "  unexpected result" << endl;
+        }
+    }
+};
+
+// Scans and lookups on a churned tree, before and after compact()
+void benchCompact()
+{
+    const size_t count = 1000000;
+    cout << "compact: about " << count << " int -> int entries after churn" << endl;
+    CompactBench<AVLTree<int,int> > avl = { "AVLTree", count };
+    CompactBench<RBTree<int,int> > rb = { "RBTree", count };
+    runIsolated(avl);
+    runIsolated(rb);
+}
+
+// Many small maps: heap use, build and lookup speed of a tree per map
+// against SmallMap, which keeps up to 16 entries inline
+template<typename Map>
+struct SmallBench
+{
+    const char* name;
+    size_t maps;
+    size_t entries;
+
+    void operator()() const
+    {
+        mt19937 rng(48);
+        vector<int> keys(maps * entries);
+        for(size_t i = 0; i < keys.size(); ++i) {
+            keys[i] = static_cast<int>(rng() % 1000000);
+        }
+        size_t before = heapInUse();
+        benchClock::time_point start = benchClock::now();
+        vector<Map> all(maps);
+        for(size_t m = 0; m < maps; ++m) {
+            for(size_t e = 0; e < entries; ++e) {
+                treeInsert(all[m], keys[m * entries + e], static_cast<int>(e));
+            }
+        }
+        double buildSeconds = secondsSince(start);
+        size_t bytes = heapInUse() - before;
+
+        size_t lookups = 4000000;
+        long long sum = 0;
+        start = benchClock::now();
+        for(size_t i = 0; i < lookups; ++i) {
+            size_t m = rng() % maps;
+            typename Map::iterator it = all[m].find(keys[m * entries + rng() % entries]);
+            sum += (*it).second;
+        }
+        double findSeconds = secondsSince(start);
+
+        string label = string(name) + ", " + to_string(entries) + " per map";
+        reportMemory(label, bytes, maps * entries);
+        report("  build", maps * entries, buildSeconds);
+        report("  find", lookups, findSeconds);
+        if(sum < 0) {
+            cout << "  unexpected result" << endl;
+        }
+    }
+};
+
+void benchSmall()
+{
+    const size_t entries[] = { 4, 12, 32 };
+    cout << "Small maps (200000 maps)" << endl;
+    for(size_t i = 0; i < sizeof(entries) / sizeof(entries[0]); ++i) {
+        SmallBench<AVLTree<int,int> > avl = { "AVLTree", 200000, entries[i] };
+        SmallBench<SmallMap<int,int> > small = { "SmallMap", 200000, entries[i] };
+        runIsolated(avl);
+        runIsolated(small);
+    }
+}
+
+// WeightedTree: counts lookups on a balanced tree, reshapes it by the
+// counts and times a second, independent draw of lookups on both shapes
+struct WeightedBench
+{
+    const char* name;
+    const vector<int>* training;
+    const vector<int>* probes;
+    const vector<int>* sortedKeys;
+    void operator()() const
+    {
+        WeightedTree<int,int> tree;
+        tree.assignSorted(sortedKeys->begin(), sortedKeys->begin(), sortedKeys->size());
+        for(size_t i = 0; i < training->size(); ++i) {
+            tree.find((*training)[i]);
+        }
+        tree.setRecording(false);
+        double before = tree.averageComparisons();
+        benchAccess(string(name) + ", balanced", tree, *probes);
+
+        benchClock::time_point start = benchClock::now();
+        tree.reshapeByAccesses();
+        double reshapeSeconds = secondsSince(start);
+        double after = tree.averageComparisons();
+        benchAccess(string(name) + ", reshaped", tree, *probes);
+        cout << "  comparisons per find " << fixed << setprecision(2) << before << " -> " << after
+             << ", reshape " << setprecision(3) << reshapeSeconds << " s" << endl;
+    }
+};
+
+void benchWeighted()
+{
+    const size_t count = 1000000;
+    const size_t lookups = 2000000;
+    cout << "weighted: " << count << " int -> int entries, " << lookups << " finds" << endl;
+
+    vector<int> sortedKeys(count);
+    for(size_t i = 0; i < count; ++i) {
+        sortedKeys[i] = (int)(i * 2654435761u);
+    }
+    sort(sortedKeys.begin(), sortedKeys.end());
+
+    const double exponents[] = { 0.99, 1.2 };
+    const char* names[] = { "Zipf 0.99", "Zipf 1.2" };
+    for(size_t w = 0; w < 2; ++w) {
+        ZipfSampler zipf(count, exponents[w], 49);
+        vector<int> training(lookups);
+        vector<int> probes(lookups);
+        for(size_t i = 0; i < lookups; ++i) {
+            training[i] = (int)(zipf() * 2654435761u);
+            probes[i] = (int)(zipf() * 2654435761u);
+        }
+        WeightedBench weighted = { names[w], &training, &probes, &sortedKeys };
+        runIsolated(weighted);
+    }
+}
+
+// A fixed lookup table with scattered keys, built entirely at compile time
+template<unsigned... Is>
+constexpr StaticMap<int, int, sizeof...(Is)> scatteredTable(StaticIndices<Is...>)
+{
+    return StaticMap<int, int, sizeof...(Is)>({ std::pair<const int, int>(
+        static_cast<int>(Is * 2654435761u % 1000003u), static_cast<int>(Is))... });
+}
+
+constexpr StaticMap<int, int, 16> staticTable16 = scatteredTable(MakeStaticIndices<16>::type());
+constexpr StaticMap<int, int, 128> staticTable128 = scatteredTable(MakeStaticIndices<128>::type());
+
+// Finds of keys drawn from the table, through its find() and end()
+template<typename Table>
+void benchTableFinds(const string& name, const Table& table, const vector<int>& probes)
+{
+    long long sum = 0;
+    benchClock::time_point start = benchClock::now();
+    for(size_t i = 0; i < probes.size(); ++i) {
+        typename Table::iterator it = table.find(probes[i]);
+        sum += it != table.end() ? (*it).second : 0;
+    }
+    report(name, probes.size(), secondsSince(start));
+    if(sum < 0) {
+        cout << "  unexpected result" << endl;
+    }
+}
+
+template<unsigned N>
+void benchStaticTable(const StaticMap<int, int, N>& table)
+{
+    cout << "  -- " << N << " entries" << endl;
+    benchClock::time_point start = benchClock::now();
+    AVLTree<int,int> avl;
+    for(typename StaticMap<int, int, N>::iterator it = table.begin(); it != table.end(); ++it) {
+        avl.insert(make_pair(it->first, it->second));
+    }
+    double buildSeconds = secondsSince(start);
+    cout << "  AVLTree built at startup in " << fixed << setprecision(2) << buildSeconds * 1e6 << " us" << endl;
+
+    mt19937 rng(50);
+    vector<int> probes(10000000);
+    for(size_t i = 0; i < probes.size(); ++i) {
+        unsigned index = rng() % N;
+        probes[i] = static_cast<int>(index * 2654435761u % 1000003u);
+    }
+    benchTableFinds("AVLTree", avl, probes);
+    benchTableFinds("StaticMap", table, probes);
+}
+
+void benchStatic()
+{
+    cout << "static: fixed int -> int tables, 10000000 finds" << endl;
+    benchStaticTable(staticTable16);
+    benchStaticTable(staticTable128);
+}
+
+int main(int argc, char* argv[])
+{
+    if(wanted(argc, argv, "wal")) {
+        benchWal();
+    }
+    if(wanted(argc, argv, "memory")) {
+        benchMemory();
+    }
+    if(wanted(argc, argv, "hotcold")) {
+        benchHotCold();
+    }
+    if(wanted(argc, argv, "sets")) {
+        benchSets();
+    }
+    if(wanted(argc, argv, "strings")) {
+        benchStrings();
+    }
+    if(wanted(argc, argv, "hashed")) {
+        benchHashed();
+    }
+    if(wanted(argc, argv, "filter")) {
+        benchFilter();
+    }
+    if(wanted(argc, argv, "engines")) {
+        benchEngines();
+    }
+    if(wanted(argc, argv, "splay")) {
+        benchSplay();
+    }
+    if(wanted(argc, argv, "scapegoat")) {
+        benchScapegoat();
+    }
+    if(wanted(argc, argv, "bplus")) {
+        benchBPlus();
+    }
+    if(wanted(argc, argv, "radix")) {
+        benchRadix();
+    }
+    if(wanted(argc, argv, "rebalance")) {
+        benchRebalance();
+    }
+    if(wanted(argc, argv, "teardown")) {
+        benchTeardown();
+    }
+    if(wanted(argc, argv, "pqueue")) {
+        benchPQueue();
+    }
+    if(wanted(argc, argv, "erase")) {
+        benchErase();
+    }
+    if(wanted(argc, argv, "batch")) {
+        benchBatch();
+    }
+    if(wanted(argc, argv, "handles")) {
+        benchHandles();
+    }
+    if(wanted(argc, argv, "compact")) {
+        benchCompact();
+    }
+    if(wanted(argc, argv, "small")) {
+        benchSmall();
+    }
+    if(wanted(argc, argv, "weighted")) {
+        benchWeighted();
+    }
+    if(wanted(argc, argv, "static")) {
+        benchStatic();
+    }
+    return 0;
+}
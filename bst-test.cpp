@@ -1,7 +1,28 @@
 #include <iostream>
+#include <fstream>
+#include <iterator>
 #include <map>
+#include <string>
+#include <vector>
+#include <cstdio>
 #include "bst.h"
 #include "avlbst.h"
+#include "bst_snapshot.h"
+#include "paged_bst.h"
+#include "bst_wal.h"
+#include "compact_avl.h"
+#include "hotcold_avl.h"
+#include "key_set.h"
+#include "hashed_avl.h"
+#include "bst_filter.h"
+#include "rbbst.h"
+#include "splaybst.h"
+#include "scapegoatbst.h"
+#include "bplus_tree.h"
+#include "radix_tree.h"
+#include "small_map.h"
+#include "weightedbst.h"
+#include "static_map.h"
 
 using namespace std;
 
@@ -44,5 +65,358 @@ int main(int argc, char *argv[])
     cout << "Erasing b" << endl;
     at.remove('b');
 
+    // Copy / move tests
+    for(char c = 'c'; c <= 'j'; ++c) {
+        at.insert(std::make_pair(c, c - 'a'));
+    }
+    AVLTree<char,int> copied(at);
+    AVLTree<char,int> parallelCopy;
+    parallelCopy.copyFrom(at, true);
+    AVLTree<char,int> moved(std::move(copied));
+
+    cout << "\nMoved copy of AVLTree contents:" << endl;
+    for(AVLTree<char,int>::iterator it = moved.begin(); it != moved.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+    cout << "Source after move is " << (copied.empty() ? "empty" : "not empty") << endl;
+    cout << "Parallel copy is " << (parallelCopy.isBalanced() ? "balanced" : "not balanced") << endl;
+
+    // Snapshot tests
+    saveSnapshot(moved, "bst-test.snap");
+    AVLTree<char,int> restored;
+    loadSnapshot(restored, "bst-test.snap");
+    cout << "\nRestored snapshot is " << (restored.isBalanced() ? "balanced" : "not balanced") << endl;
+    {
+        MappedSnapshot<char,int> mapped("bst-test.snap");
+        cout << "Mapped snapshot has " << mapped.size() << " items, e -> " << mapped['e'] << endl;
+        if(mapped.find('b') == mapped.end()) {
+            cout << "Did not find b in mapped snapshot" << endl;
+        }
+    }
+    std::remove("bst-test.snap");
+
+    // Paged tree tests
+    {
+        PagedTree<int,int> pt("bst-test.pages", 4);
+        for(int i = 0; i < 10000; ++i) {
+            pt.insert(std::make_pair(i, i * i));
+        }
+        pt.remove(5000);
+        cout << "\nPaged tree has " << pt.size() << " items, 99 -> " << pt[99] << endl;
+        if(pt.find(5000) == pt.end()) {
+            cout << "Did not find 5000 in paged tree" << endl;
+        }
+        const PagedStats& stats = pt.stats();
+        cout << "Paged tree hit rate " << stats.hitRate() << ", " << stats.pageReads
+             << " page reads, " << stats.pageWrites << " page writes" << endl;
+    }
+    std::remove("bst-test.pages");
+
+    // Write-ahead log tests
+    {
+        LoggedAVLTree<int,int> logged("bst-test-wal");
+        logged.insert(std::make_pair(1, 10));
+        logged.insert(std::make_pair(2, 20));
+        logged.checkpoint();
+        logged.insert(std::make_pair(3, 30));
+        logged.remove(1);
+        for(int i = 10; i < 20; ++i) {
+            logged.insert(std::make_pair(i, i * 10));
+        }
+        // a bulk erase bypasses the log and checkpoints instead
+        logged.erase_if([](const std::pair<const int, int>& item) { return item.first >= 15; });
+    }
+    {
+        LoggedAVLTree<int,int> recovered("bst-test-wal");
+        cout << "\nRecovered log contents:" << endl;
+        for(LoggedAVLTree<int,int>::iterator it = recovered.begin(); it != recovered.end(); ++it) {
+            cout << it->first << " " << it->second << endl;
+        }
+        if(recovered.find(15) == recovered.end()) {
+            cout << "erase_if survived recovery" << endl;
+        }
+        recovered.clear();
+    }
+    {
+        LoggedAVLTree<int,int> cleared("bst-test-wal");
+        cout << "Recovered " << cleared.size() << " items after clear" << endl;
+        // a batch this large next to the tree is merged, not logged op by op
+        std::vector<BatchOp<int,int> > batch;
+        for(int i = 0; i < 8; ++i) {
+            BatchOp<int,int> op = { false, i, i * i };
+            batch.push_back(op);
+        }
+        cleared.apply_batch(batch);
+    }
+    {
+        LoggedAVLTree<int,int> batched("bst-test-wal");
+        cout << "Recovered " << batched.size() << " items after apply_batch, 7 -> " << batched[7] << endl;
+        batched.clear();
+        for(int i = 0; i < 5; ++i) {
+            batched.insert(std::make_pair(i, i));
+        }
+        batched.sync();
+        // put back the log as it was before clear()'s checkpoint, as if we
+        // crashed after installing the snapshot but before emptying the log
+        std::ifstream walIn("bst-test-wal.wal", std::ios::binary);
+        std::string staleLog((std::istreambuf_iterator<char>(walIn)), std::istreambuf_iterator<char>());
+        walIn.close();
+        batched.clear();
+        std::ofstream walOut("bst-test-wal.wal", std::ios::binary | std::ios::trunc);
+        walOut << staleLog;
+    }
+    {
+        LoggedAVLTree<int,int> crashed("bst-test-wal");
+        cout << "Recovered " << crashed.size() << " items after a crash inside clear's checkpoint" << endl;
+    }
+    std::remove("bst-test-wal.snap");
+    std::remove("bst-test-wal.wal");
+
+    // Compact AVL tree tests
+    CompactAVLTree<char,int> ct;
+    for(char c = 'a'; c <= 'e'; ++c) {
+        ct.insert(std::make_pair(c, c - 'a'));
+    }
+    ct.remove('c');
+    cout << "\nCompactAVLTree contents:" << endl;
+    for(CompactAVLTree<char,int>::iterator it = ct.begin(); it != ct.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+
+    // Hot/cold AVL tree tests
+    HotColdAVLTree<char,std::string> ht;
+    ht.insert(std::make_pair('a', std::string("apple")));
+    ht.insert(std::make_pair('b', std::string("banana")));
+    ht['a'] += " pie";
+    cout << "\nHotColdAVLTree contents:" << endl;
+    for(HotColdAVLTree<char,std::string>::iterator it = ht.begin(); it != ht.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+
+    // Set tests
+    AVLSet<char> as;
+    BSTSet<char> bs;
+    for(char c = 'e'; c >= 'a'; --c) {
+        as.insert(c);
+        bs.insert(c);
+    }
+    as.remove('b');
+    cout << "\nAVLSet contents:";
+    for(AVLSet<char>::iterator it = as.begin(); it != as.end(); ++it) {
+        cout << " " << *it;
+    }
+    cout << "\nBSTSet has " << bs.size() << " keys, contains b: " << bs.count('b') << endl;
+
+    // String keys (compared through the cached key prefix)
+    AVLTree<std::string,int> st;
+    st.insert(std::make_pair(std::string("https://example.com/b"), 2));
+    st.insert(std::make_pair(std::string("https://example.com/a"), 1));
+    st.insert(std::make_pair(std::string("https://example.com"), 0));
+    cout << "\nString-key AVLTree contents:" << endl;
+    for(AVLTree<std::string,int>::iterator it = st.begin(); it != st.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+
+    // Hash-indexed AVL tree tests
+    HashedAVLTree<std::string,int> hat;
+    hat.insert(std::make_pair(std::string("pear"), 3));
+    hat.insert(std::make_pair(std::string("fig"), 1));
+    hat.insert(std::make_pair(std::string("kiwi"), 2));
+    hat.remove("fig");
+    cout << "\nHashedAVLTree kiwi = " << hat["kiwi"] << ", in order:";
+    for(HashedAVLTree<std::string,int>::iterator it = hat.begin(); it != hat.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << endl;
+
+    // Filtered tree tests
+    FilteredTree<int,int> ft;
+    FilteredTree<int,int,BinarySearchTree> fb;
+    for(int i = 0; i < 10; ++i) {
+        ft.insert(std::make_pair(i * 10, i));
+        fb.insert(std::make_pair(i * 10, i));
+    }
+    ft.remove(30);
+    size_t hits = 0;
+    for(int i = 0; i < 100; ++i) {
+        hits += (ft.find(i) != ft.end()) + (fb.find(i) != fb.end());
+    }
+    cout << "\nFilteredTree hits: " << hits << ", filter rejected "
+         << ft.filterStats().rejected << " of " << ft.filterStats().lookups << " lookups" << endl;
+
+    // Red-black tree tests
+    RBTree<int,string> rbt;
+    for(int i = 1; i <= 7; ++i) {
+        rbt.insert(std::make_pair(i, string(1, 'a' + i - 1)));
+    }
+    rbt.remove(4);
+    cout << "\nRBTree contents:" << endl;
+    rbt.print();
+
+    // Splay tree tests
+    SplayTree<int,string> spt;
+    for(int i = 1; i <= 7; ++i) {
+        spt.insert(std::make_pair(i, string(1, 'a' + i - 1)));
+    }
+    spt.remove(4);
+    spt.find(2);
+    cout << "\nSplayTree after finding 2:" << endl;
+    spt.print();
+
+    // Scapegoat tree tests
+    ScapegoatTree<int,int> sgt;
+    for(int i = 1; i <= 15; ++i) {
+        sgt.insert(std::make_pair(i, i * i));
+    }
+    sgt.remove(8);
+    cout << "\nScapegoatTree after ascending inserts (" << sgt.stats().rebuilds << " rebuilds):" << endl;
+    sgt.print();
+
+    // B+-tree tests
+    BPlusTree<int,int> bpt;
+    for(int i = 0; i < 200; ++i) {
+        bpt.insert(std::make_pair(i * 7 % 200, i));
+    }
+    for(int i = 0; i < 200; i += 3) {
+        bpt.remove(i);
+    }
+    cout << "\nBPlusTree with " << bpt.size() << " keys, levels:" << endl;
+    bpt.print();
+    cout << "bpt[100] = " << bpt[100] << endl;
+    if(bpt.find(99) == bpt.end()) {
+        cout << "Did not find 99 after removal" << endl;
+    }
+
+    // Radix tree tests, picked by OrderedMap for the integral key
+    OrderedMap<long, int>::type rt;
+    long radixKeys[] = { -300, 5, 70000, 1L << 40, 6, -1, 1L << 41 };
+    for(int i = 0; i < 7; ++i) {
+        rt.insert(std::make_pair(radixKeys[i], i));
+    }
+    rt.remove(6);
+    cout << "\nRadixTree contents:";
+    for(OrderedMap<long, int>::type::iterator it = rt.begin(); it != rt.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << endl << "first key >= 7: " << rt.lower_bound(7)->first << endl;
+
+    // DSW rebalance of a degenerate tree
+    BinarySearchTree<int,int> vine;
+    for(int i = 1; i <= 10; ++i) {
+        vine.insert(std::make_pair(i, i));
+    }
+    cout << "\nSorted inserts, balanced: " << vine.isBalanced() << endl;
+    vine.rebalance();
+    cout << "After rebalance(), balanced: " << vine.isBalanced() << endl;
+    vine.print();
+
+    // Priority-queue access to the smallest and largest keys
+    RBTree<int,char> deadlines;
+    deadlines.insert(std::make_pair(30, 'c'));
+    deadlines.insert(std::make_pair(10, 'a'));
+    deadlines.insert(std::make_pair(50, 'e'));
+    deadlines.insert(std::make_pair(20, 'b'));
+    deadlines.insert(std::make_pair(40, 'd'));
+    cout << "\n" << deadlines.size() << " deadlines, earliest " << deadlines.front().first
+         << ", latest " << deadlines.back().first << endl;
+    cout << "pop_max: " << deadlines.pop_max().second << endl;
+    std::vector<std::pair<int,char> > due = deadlines.pop_min(2);
+    cout << "pop_min(2):";
+    for(size_t i = 0; i < due.size(); ++i) {
+        cout << " " << due[i].second;
+    }
+    cout << endl << deadlines.size() << " left, earliest " << deadlines.front().first << endl;
+
+    // Range erase and erase_if
+    AVLTree<int,int> expiring;
+    for(int i = 1; i <= 20; ++i) {
+        expiring.insert(std::make_pair(i, i * i));
+    }
+    size_t expired = expiring.erase_range(1, 8);
+    size_t odd = expiring.erase_if([](const std::pair<const int,int>& item) { return item.second % 2 == 1; });
+    cout << "\nerase_range(1, 8) removed " << expired << ", erase_if(odd value) removed " << odd << endl;
+    expiring.erase(expiring.find(18), expiring.end());
+    expiring.print();
+
+    // Batched updates: only the last op on each key counts
+    std::vector<BatchOp<int,int> > ops;
+    BatchOp<int,int> batch[] = { { false, 3, 9 }, { true, 10, 0 }, { false, 30, 900 },
+                                 { false, 3, 90 }, { true, 12, 0 }, { false, 12, 144 } };
+    ops.assign(batch, batch + 6);
+    expiring.apply_batch(ops);
+    cout << "After apply_batch:";
+    for(AVLTree<int,int>::iterator it = expiring.begin(); it != expiring.end(); ++it) {
+        cout << " " << it->first << "->" << it->second;
+    }
+    cout << endl;
+
+    // Moving nodes between trees with extract(), insert(handle) and splice()
+    AVLTree<int,int> archive;
+    NodeHandle<int,int> handle = expiring.extract(30);
+    cout << "\nextracted " << handle.key() << "->" << handle.mapped() << endl;
+    archive.insert(std::move(handle));
+    archive.insert(std::make_pair(16, 0));
+    size_t spliced = archive.splice(expiring);
+    cout << "splice moved " << spliced << ", left behind:";
+    for(AVLTree<int,int>::iterator it = expiring.begin(); it != expiring.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << endl << "archive:";
+    for(AVLTree<int,int>::iterator it = archive.begin(); it != archive.end(); ++it) {
+        cout << " " << it->first << "->" << it->second;
+    }
+    cout << endl;
+
+    // Compaction moves the nodes into one block without changing the tree
+    archive.compact();
+    cout << "\nAfter compact(), " << archive.blockCount() << " block in use:";
+    for(AVLTree<int,int>::iterator it = archive.begin(); it != archive.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << endl;
+    while(!archive.compactStep(2)) {
+    }
+    archive.print();
+
+    // A small map keeps entries inline until it outgrows them
+    SmallMap<int,int,4> tiny;
+    for(int i = 1; i <= 5; ++i) {
+        tiny.insert(std::make_pair(i * 10, i));
+        cout << (i == 1 ? "\nSmallMap sizes:" : "") << " " << tiny.size()
+             << (tiny.promoted() ? "(tree)" : "(inline)");
+    }
+    tiny.remove(50);
+    tiny.remove(40);
+    tiny.remove(30);
+    cout << endl << "after removes (" << (tiny.promoted() ? "tree" : "inline") << "):";
+    for(SmallMap<int,int,4>::iterator it = tiny.begin(); it != tiny.end(); ++it) {
+        cout << " " << it->first << "->" << it->second;
+    }
+    cout << endl;
+
+    // Reshaping by counted lookups brings the popular keys to the top
+    WeightedTree<int,int> weighted;
+    int sortedKeys[] = { 1, 2, 3, 4, 5, 6, 7 };
+    weighted.assignSorted(sortedKeys, sortedKeys, 7);
+    for(int i = 0; i < 10; ++i) {
+        weighted.find(7);
+        weighted.find(i % 2 ? 6 : 1);
+    }
+    double before = weighted.averageComparisons();
+    weighted.reshapeByAccesses();
+    cout << "\nWeightedTree comparisons per find: " << before << " -> "
+         << weighted.averageComparisons() << endl;
+    weighted.print();
+
+    // A lookup table laid out at compile time
+    constexpr std::pair<const int, int> retryEntries[] = { {503, 5}, {429, 30}, {500, 1}, {408, 2} };
+    constexpr StaticMap<int, int, 4> retrySeconds(retryEntries);
+    static_assert(retrySeconds[429] == 30, "StaticMap lookups are constant expressions");
+    cout << "\nStaticMap:";
+    for(StaticMap<int, int, 4>::iterator it = retrySeconds.begin(); it != retrySeconds.end(); ++it) {
+        cout << " " << it->first << "->" << it->second;
+    }
+    cout << endl << "find(404) is end(): " << (retrySeconds.find(404) == retrySeconds.end()) << endl;
+
     return 0;
 }
@@ -4,7 +4,277 @@
 #include <iostream>
 #include <exception>
 #include <cstdlib>
+#include <cmath>
 #include <utility>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <typeinfo>
+#include "key_traits.h"
+
+// Bulk passes over a vector of nodes read this far ahead of themselves
+#if defined(__GNUC__)
+#define BST_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define BST_PREFETCH(addr) ((void)0)
+#endif
+
+/**
+* The contiguous blocks of memory a tree's compaction has moved its nodes
+* into. Every tree owns its own blocks. While a Fill is alive on a thread,
+* Node's operator new takes that thread's nodes from one new block, in
+* allocation order, and the block joins its owner when the Fill ends.
+*
+* A node in a block is destroyed in place and its slot is not reused:
+* the block's memory is kept until the owning tree is cleared or
+* destroyed, or until the next compact() or completed compactStep() pass
+* has moved every node out of it. A compacted tree that then loses most
+* of its nodes therefore holds on to that memory until it is compacted
+* again. Nodes leave a tree through extract() and splice() by way of the
+* heap, so no block is ever needed by another tree.
+*/
+class NodeBlocks
+{
+public:
+    class Fill
+    {
+    public:
+        Fill(NodeBlocks& owner, size_t count);
+        ~Fill();
+    private:
+        friend class NodeBlocks;
+        Fill(const Fill&);
+        Fill& operator=(const Fill&);
+
+        NodeBlocks& owner_;
+        char* begin_;       // NULL until the first node is placed
+        char* next_;
+        char* end_;
+        size_t capacity_;   // in nodes
+        size_t nodeSize_;
+        Fill* outer_;       // the Fill this one is nested in, if any
+    };
+
+    NodeBlocks();
+    NodeBlocks(NodeBlocks&& other);
+    NodeBlocks& operator=(NodeBlocks&& other);
+    ~NodeBlocks();
+
+    static void* allocate(size_t size);
+    static bool release(void* p);
+
+    bool holds(const void* p) const;
+    size_t count() const;
+    size_t mark() const;
+    void freeBefore(size_t mark);
+    void freeAll();
+
+private:
+    struct Block
+    {
+        char* begin;
+        char* end;
+        size_t serial;      // order in which the block was filled
+    };
+
+    NodeBlocks(const NodeBlocks&);
+    NodeBlocks& operator=(const NodeBlocks&);
+    void adopt(char* begin, char* end);
+    static Fill*& filling();
+
+    std::vector<Block> blocks_;     // sorted by address
+    size_t serial_;                 // serial of the next block
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the NodeBlocks class.
+  -----------------------------------------------
+*/
+
+/**
+* Starts a block with room for count nodes. Nothing is allocated until
+* the first node is placed, since only then is the node size known. Room
+* for the block in owner is reserved here, so ending the Fill cannot fail.
+*/
+inline NodeBlocks::Fill::Fill(NodeBlocks& owner, size_t count) :
+    owner_(owner), begin_(NULL), next_(NULL), end_(NULL),
+    capacity_(count), nodeSize_(0), outer_(filling())
+{
+    owner_.blocks_.reserve(owner_.blocks_.size() + 1);
+    filling() = this;
+}
+
+inline NodeBlocks::Fill::~Fill()
+{
+    filling() = outer_;
+    if(begin_ != NULL){
+        owner_.adopt(begin_, end_);
+    }
+}
+
+inline NodeBlocks::NodeBlocks() : serial_(0)
+{
+
+}
+
+inline NodeBlocks::NodeBlocks(NodeBlocks&& other) :
+    blocks_(std::move(other.blocks_)), serial_(other.serial_)
+{
+    other.blocks_.clear();
+}
+
+/**
+* Takes over other's blocks after freeing this one's. The nodes in them
+* must already have been destroyed.
+*/
+inline NodeBlocks& NodeBlocks::operator=(NodeBlocks&& other)
+{
+    if(this != &other){
+        freeAll();
+        blocks_.swap(other.blocks_);
+        serial_ = other.serial_;
+    }
+    return *this;
+}
+
+inline NodeBlocks::~NodeBlocks()
+{
+    freeAll();
+}
+
+/**
+* Places a node of size bytes in the calling thread's block. Returns NULL
+* if there is none, or it is full, or it holds nodes of another size.
+*/
+inline void* NodeBlocks::allocate(size_t size)
+{
+    Fill* fill = filling();
+    if(fill == NULL || fill->capacity_ == 0){
+        return NULL;
+    }
+    if(fill->begin_ == NULL){
+        fill->begin_ = static_cast<char*>(::operator new(fill->capacity_ * size));
+        fill->next_ = fill->begin_;
+        fill->end_ = fill->begin_ + fill->capacity_ * size;
+        fill->nodeSize_ = size;
+    }
+    if(size != fill->nodeSize_ || fill->next_ == fill->end_){
+        return NULL;
+    }
+    void* p = fill->next_;
+    fill->next_ += size;
+    return p;
+}
+
+/**
+* Returns true if p lies in a block the calling thread is filling, which
+* happens only when a node placed there throws from its constructor; its
+* slot is given up. Trees destroy the nodes in their finished blocks in
+* place, so any other p came from the heap.
+*/
+inline bool NodeBlocks::release(void* p)
+{
+    char* c = static_cast<char*>(p);
+    for(Fill* fill = filling(); fill != NULL; fill = fill->outer_){
+        if(c >= fill->begin_ && c < fill->end_){
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+* Whether p lies in one of these blocks.
+*/
+inline bool NodeBlocks::holds(const void* p) const
+{
+    if(blocks_.empty()){
+        return false;
+    }
+    const char* c = static_cast<const char*>(p);
+    // the last block starting at or before p
+    size_t lo = 0;
+    size_t hi = blocks_.size();
+    while(lo < hi){
+        size_t mid = lo + (hi - lo) / 2;
+        if(blocks_[mid].begin <= c){
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo > 0 && c < blocks_[lo - 1].end;
+}
+
+inline size_t NodeBlocks::count() const
+{
+    return blocks_.size();
+}
+
+/**
+* A serial that every block filled from now on is at or above, for
+* freeBefore().
+*/
+inline size_t NodeBlocks::mark() const
+{
+    return serial_;
+}
+
+/**
+* Frees the blocks filled before mark was taken. No live node may remain
+* in them.
+*/
+inline void NodeBlocks::freeBefore(size_t mark)
+{
+    size_t kept = 0;
+    for(size_t i = 0; i < blocks_.size(); ++i){
+        if(blocks_[i].serial < mark){
+            ::operator delete(blocks_[i].begin);
+        } else {
+            blocks_[kept++] = blocks_[i];
+        }
+    }
+    blocks_.resize(kept);
+}
+
+/**
+* Frees every block. No live node may remain in them.
+*/
+inline void NodeBlocks::freeAll()
+{
+    for(size_t i = 0; i < blocks_.size(); ++i){
+        ::operator delete(blocks_[i].begin);
+    }
+    blocks_.clear();
+}
+
+/**
+* Adds a finished block, keeping the list sorted. Its Fill reserved the
+* room, so this does not allocate.
+*/
+inline void NodeBlocks::adopt(char* begin, char* end)
+{
+    Block block = { begin, end, serial_++ };
+    std::vector<Block>::iterator at = blocks_.begin();
+    while(at != blocks_.end() && at->begin < begin){
+        ++at;
+    }
+    blocks_.insert(at, block);
+}
+
+inline NodeBlocks::Fill*& NodeBlocks::filling()
+{
+    static thread_local Fill* fill = NULL;
+    return fill;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the NodeBlocks class.
+  -----------------------------------------------
+*/
 
 /**
  * A templated class for a Node in a search tree.
@@ -12,9 +282,12 @@
  * that they can be overridden for future kinds of
  * search trees, such as Red Black trees, Splay trees,
  * and AVL trees.
+ *
+ * Nodes inherit the key cache described by KeyTraits<Key>, which is empty
+ * for most key types.
  */
 template <typename Key, typename Value>
-class Node
+class Node : public NodeKeyCache<Key>
 {
 public:
     Node(const Key& key, const Value& value, Node<Key, Value>* parent);
@@ -35,6 +308,10 @@ public:
     void setRight(Node<Key, Value>* right);
     void setValue(const Value &value);
 
+    // Nodes come from the heap, or from a tree's NodeBlocks while one is filling
+    static void* operator new(size_t size);
+    static void operator delete(void* p);
+
 protected:
     std::pair<const Key, Value> item_;
     Node<Key, Value>* parent_;
@@ -53,6 +330,7 @@ protected:
 */
 template<typename Key, typename Value>
 Node<Key, Value>::Node(const Key& key, const Value& value, Node<Key, Value>* parent) :
+    NodeKeyCache<Key>(key),
     item_(key, value),
     parent_(parent),
     left_(NULL),
@@ -180,12 +458,144 @@ void Node<Key, Value>::setValue(const Value& value)
     item_.second = value;
 }
 
+template<typename Key, typename Value>
+void* Node<Key, Value>::operator new(size_t size)
+{
+    void* p = NodeBlocks::allocate(size);
+    return p != NULL ? p : ::operator new(size);
+}
+
+template<typename Key, typename Value>
+void Node<Key, Value>::operator delete(void* p)
+{
+    if(!NodeBlocks::release(p)){
+        ::operator delete(p);
+    }
+}
+
 /*
   ---------------------------------------
   End implementations for the Node class.
   ---------------------------------------
 */
 
+/**
+* One mutation for BinarySearchTree::apply_batch(): removes key, or
+* inserts key -> value, overwriting any value already there.
+*/
+template<typename Key, typename Value>
+struct BatchOp
+{
+    bool remove;
+    Key key;
+    Value value;    // unused by removes
+};
+
+template <typename Key, typename Value>
+class BinarySearchTree;
+
+/**
+* Node layouts for BinarySearchTree::compact(). COMPACT_IN_ORDER suits
+* scans. COMPACT_VEB (van Emde Boas) keeps each node close to the nodes a
+* few levels below it, which suits lookups.
+*/
+enum CompactOrder { COMPACT_IN_ORDER, COMPACT_VEB };
+
+/**
+* Owns one node taken out of a tree by BinarySearchTree::extract(). It
+* can be handed to insert() on any tree using the same kind of node, which
+* links the node in as is, so the item moves without being copied and
+* nothing is allocated or freed. A handle that still owns its node when
+* destroyed frees it. Handles can be moved but not copied.
+*/
+template<typename Key, typename Value>
+class NodeHandle
+{
+public:
+    NodeHandle();
+    NodeHandle(NodeHandle<Key, Value>&& other);
+    NodeHandle<Key, Value>& operator=(NodeHandle<Key, Value>&& other);
+    ~NodeHandle();
+
+    bool empty() const;
+    explicit operator bool() const;
+    const Key& key() const;
+    Value& mapped() const;
+
+private:
+    friend class BinarySearchTree<Key, Value>;
+    explicit NodeHandle(Node<Key, Value>* node);
+    NodeHandle(const NodeHandle<Key, Value>&);
+    NodeHandle<Key, Value>& operator=(const NodeHandle<Key, Value>&);
+
+    Node<Key, Value>* node_;
+};
+
+template<typename Key, typename Value>
+NodeHandle<Key, Value>::NodeHandle() : node_(nullptr)
+{
+
+}
+
+template<typename Key, typename Value>
+NodeHandle<Key, Value>::NodeHandle(Node<Key, Value>* node) : node_(node)
+{
+
+}
+
+template<typename Key, typename Value>
+NodeHandle<Key, Value>::NodeHandle(NodeHandle<Key, Value>&& other) : node_(other.node_)
+{
+    other.node_ = nullptr;
+}
+
+template<typename Key, typename Value>
+NodeHandle<Key, Value>& NodeHandle<Key, Value>::operator=(NodeHandle<Key, Value>&& other)
+{
+    if(this != &other){
+        delete node_;
+        node_ = other.node_;
+        other.node_ = nullptr;
+    }
+    return *this;
+}
+
+template<typename Key, typename Value>
+NodeHandle<Key, Value>::~NodeHandle()
+{
+    delete node_;
+}
+
+template<typename Key, typename Value>
+bool NodeHandle<Key, Value>::empty() const
+{
+    return node_ == nullptr;
+}
+
+template<typename Key, typename Value>
+NodeHandle<Key, Value>::operator bool() const
+{
+    return node_ != nullptr;
+}
+
+/**
+* @precondition The handle is not empty
+*/
+template<typename Key, typename Value>
+const Key& NodeHandle<Key, Value>::key() const
+{
+    return node_->getKey();
+}
+
+/**
+* @precondition The handle is not empty
+*/
+template<typename Key, typename Value>
+Value& NodeHandle<Key, Value>::mapped() const
+{
+    return node_->getValue();
+}
+
 /**
 * A templated unbalanced binary search tree.
 */
@@ -194,13 +604,32 @@ class BinarySearchTree
 {
 public:
     BinarySearchTree(); //TODO
+    BinarySearchTree(const BinarySearchTree<Key, Value>& other);
+    BinarySearchTree(BinarySearchTree<Key, Value>&& other);
     virtual ~BinarySearchTree(); //TODO
+    BinarySearchTree<Key, Value>& operator=(const BinarySearchTree<Key, Value>& other);
+    BinarySearchTree<Key, Value>& operator=(BinarySearchTree<Key, Value>&& other);
+    void copyFrom(const BinarySearchTree<Key, Value>& other, bool parallel = false);
+    template<typename KeyIter, typename ValueIter>
+    void assignSorted(KeyIter keys, ValueIter values, size_t n);
     virtual void insert(const std::pair<const Key, Value>& keyValuePair); //TODO
     virtual void remove(const Key& key); //TODO
-    void clear(); //TODO
+    void clear(bool parallel = false); //TODO
     bool isBalanced() const; //TODO
+    void rebalance();
+    void setRebalanceFactor(double factor);
     void print() const;
     bool empty() const;
+    size_t size() const;
+
+    // Priority-queue access to the extremes
+    std::pair<const Key, Value>& front();
+    std::pair<const Key, Value> const & front() const;
+    std::pair<const Key, Value>& back();
+    std::pair<const Key, Value> const & back() const;
+    std::pair<Key, Value> pop_min();
+    std::pair<Key, Value> pop_max();
+    std::vector<std::pair<Key, Value> > pop_min(size_t k);
 
     template<typename PPKey, typename PPValue>
     friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue> & tree);
@@ -231,14 +660,34 @@ public:
     iterator begin() const;
     iterator end() const;
     iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
     Value& operator[](const Key& key);
     Value const & operator[](const Key& key) const;
 
+    // Bulk updates
+    void apply_batch(const std::vector<BatchOp<Key, Value> >& ops);
+    iterator erase(iterator first, iterator last);
+    size_t erase_range(const Key& lo, const Key& hi);
+    template<typename Pred>
+    size_t erase_if(Pred pred);
+
+    // Moving nodes between trees without reallocating them
+    NodeHandle<Key, Value> extract(const Key& key);
+    NodeHandle<Key, Value> extract(iterator pos);
+    iterator insert(NodeHandle<Key, Value>&& handle);
+    size_t splice(BinarySearchTree<Key, Value>& other);
+
+    // Moving nodes into fresh, contiguous memory
+    void compact(CompactOrder order = COMPACT_IN_ORDER);
+    bool compactStep(size_t budget);
+    size_t blockCount() const;
+
 protected:
     // Mandatory helper functions
     Node<Key, Value>* internalFind(const Key& k) const; // TODO
     Node<Key, Value> *getSmallestNode() const;  // TODO
     static Node<Key, Value>* predecessor(Node<Key, Value>* current); // TODO
+    static Node<Key, Value>* successor(Node<Key, Value>* current);
     // Note:  static means these functions don't have a "this" pointer
     //        and instead just use the input argument.
 
@@ -247,13 +696,107 @@ protected:
     virtual void nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2) ;
 
     // Add helper functions here
-    void helpClear(Node<Key,Value>* node);
+    void helpClear(Node<Key,Value>* node) const;
+    void clearParallel(Node<Key,Value>* node, int depth) const;
+    void destroyNode(Node<Key, Value>* node) const;
+    void releaseNodes(bool parallel = false);
     int helpBalancedHeight(Node<Key,Value>* node) const;
 
+    // Day-Stout-Warren rebalancing helpers
+    size_t treeToVine();
+    void compressVine(size_t count);
+    void setRebalancedBalance();
+    static int leftPathHeight(const Node<Key, Value>* node);
+    void noteInsertDepth(size_t depth);
+
+    // Size and extreme bookkeeping every insert and remove path must call
+    void noteInserted(Node<Key, Value>* node);
+    void noteRemoving(Node<Key, Value>* node);
+    void findExtremes();
+
+    // Structural copy helpers
+    virtual Node<Key, Value>* cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const;
+    Node<Key, Value>* cloneSubtree(const Node<Key, Value>* src, Node<Key, Value>* parent) const;
+    Node<Key, Value>* cloneParallel(const Node<Key, Value>* src, Node<Key, Value>* parent, int depth) const;
+    void cloneFrom(const BinarySearchTree<Key, Value>& other);
+    static bool hasAtLeast(const Node<Key, Value>* root, size_t count);
+    static int parallelDepth();
+
+    // Bulk build helpers
+    virtual Node<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent) const;
+    virtual void setBuiltBalance(Node<Key, Value>* node, int leftHeight, int rightHeight) const;
+    template<typename KeyIter, typename ValueIter>
+    Node<Key, Value>* buildBalanced(KeyIter keys, ValueIter values, size_t lo, size_t hi,
+        Node<Key, Value>* parent, int& height) const;
+    virtual void bulkChanged();
+
+    // Bulk update helpers
+    void mergeBatch(const std::vector<const BatchOp<Key, Value>*>& ops);
+    size_t eraseNodes(Node<Key, Value>* first, Node<Key, Value>* last);
+    size_t eraseBetween(Node<Key, Value>* first, Node<Key, Value>* last);
+    void eraseCollected(std::vector<Node<Key, Value>*>& kept, std::vector<Node<Key, Value>*>& doomed);
+    void relinkKept(std::vector<Node<Key, Value>*>& kept);
+    static void collectInOrder(Node<Key, Value>* root, std::vector<Node<Key, Value>*>& nodes);
+    Node<Key, Value>* relinkBalanced(std::vector<Node<Key, Value>*>& nodes) const;
+
+    // Node handle helpers. linkNode() and unlinkNode() are insert and
+    // remove for a node that already exists; subclasses with their own
+    // invariants or side structures override them
+    Node<Key, Value>* findSlot(const Key& key, int& cmp, size_t& depth) const;
+    void attachNode(Node<Key, Value>* node, Node<Key, Value>* parent, int cmp);
+    virtual Node<Key, Value>* linkNode(Node<Key, Value>* node);
+    virtual void unlinkNode(Node<Key, Value>* node);
+    virtual bool acceptsNode(const Node<Key, Value>* node) const;
+
+    // Compaction helpers
+    Node<Key, Value>* relocateNode(Node<Key, Value>* node);
+    virtual void nodeRelocated(Node<Key, Value>* from, Node<Key, Value>* to);
+    Node<Key, Value>* moveToHeap(Node<Key, Value>* node);
+    void stopCompaction();
+    static void collectVeb(Node<Key, Value>* root, std::vector<Node<Key, Value>*>& nodes);
+
+    // Lets subclasses hand out iterators to nodes they located themselves
+    static iterator makeIterator(Node<Key, Value>* node);
+
+    // Key comparison through the node key cache
+    typedef typename KeyTraits<Key>::Cache KeyCache;
+    static int compareToNode(const Key& key, const KeyCache& cache, const Node<Key, Value>* node);
+
+    // Trees with fewer nodes than this are always copied on the calling thread
+    static const size_t PARALLEL_CLONE_MIN_NODES = 1 << 16;
+    // Freeing a node is cheaper than copying one, so splitting pays off later
+    static const size_t PARALLEL_CLEAR_MIN_NODES = 1 << 20;
+    // No height-balanced tree this tall fits in memory (it would need over
+    // Fibonacci(MAX_BALANCED_HEIGHT) nodes), so isBalanced() stops there
+    static const int MAX_BALANCED_HEIGHT = 128;
+    // Bulk erases relink the survivors into a new tree, rather than remove
+    // key by key, past 1/BULK_RANGE_FRACTION of the keys for a range (which
+    // must then walk the survivors) or 1/BULK_RELINK_FRACTION for
+    // erase_if() (which has walked them already)
+    static const size_t BULK_RANGE_FRACTION = 4;
+    static const size_t BULK_RELINK_FRACTION = 16;
+    // A batch of at least 1/BATCH_MERGE_FRACTION of the tree's size is
+    // merged into it in one pass rather than applied op by op
+    static const size_t BATCH_MERGE_FRACTION = 4;
+    static const size_t PREFETCH_DISTANCE = 16;
+
 
 protected:
     Node<Key, Value>* root_;
     // You should not need other data members
+    size_t size_;
+    Node<Key, Value>* minNode_;     // leftmost node, NULL when empty
+    Node<Key, Value>* maxNode_;     // rightmost node, NULL when empty
+
+    // Automatic rebalancing (see setRebalanceFactor); 0 disables it
+    double rebalanceFactor_;
+    size_t rebalanceDebt_;      // excess insert depth since the last rebalance
+
+    // Incremental compaction (see compactStep)
+    bool compacting_;
+    Node<Key, Value>* compactNext_;     // next node to move, NULL once all have moved
+    size_t compactMark_;                // blocks filled before this pass began
+    NodeBlocks blocks_;                 // where compaction has put nodes
 };
 
 /*
@@ -377,18 +920,125 @@ Begin implementations for the BinarySearchTree class.
 * Default constructor for a BinarySearchTree, which sets the root to NULL.
 */
 template<class Key, class Value>
-BinarySearchTree<Key, Value>::BinarySearchTree() 
+BinarySearchTree<Key, Value>::BinarySearchTree() :
+    size_(0), minNode_(nullptr), maxNode_(nullptr), rebalanceFactor_(0), rebalanceDebt_(0),
+    compacting_(false), compactNext_(nullptr), compactMark_(0)
 {
     // TODO
     root_ = nullptr;
 }
 
+/**
+* Copy constructor. Copies other node-for-node so the copy has exactly
+* the same shape; nothing is re-inserted.
+*/
+template<class Key, class Value>
+BinarySearchTree<Key, Value>::BinarySearchTree(const BinarySearchTree<Key, Value>& other) :
+    root_(nullptr), size_(0), minNode_(nullptr), maxNode_(nullptr),
+    rebalanceFactor_(0), rebalanceDebt_(0),
+    compacting_(false), compactNext_(nullptr), compactMark_(0)
+{
+    cloneFrom(other);
+}
+
+/**
+* Move constructor. Steals other's nodes in O(1) and leaves other empty.
+*/
+template<class Key, class Value>
+BinarySearchTree<Key, Value>::BinarySearchTree(BinarySearchTree<Key, Value>&& other) :
+    root_(other.root_), size_(other.size_), minNode_(other.minNode_), maxNode_(other.maxNode_),
+    rebalanceFactor_(other.rebalanceFactor_), rebalanceDebt_(other.rebalanceDebt_),
+    compacting_(other.compacting_), compactNext_(other.compactNext_),
+    compactMark_(other.compactMark_), blocks_(std::move(other.blocks_))
+{
+    other.root_ = nullptr;
+    other.size_ = 0;
+    other.minNode_ = nullptr;
+    other.maxNode_ = nullptr;
+    other.rebalanceDebt_ = 0;
+    other.compacting_ = false;
+    other.compactNext_ = nullptr;
+}
+
 template<typename Key, typename Value>
 BinarySearchTree<Key, Value>::~BinarySearchTree()
 {
     // TODO
-    clear();
+    releaseNodes();
+
+}
+
+/**
+* Copy assignment. Both trees must be of the same dynamic type, since
+* the copied nodes are created by this tree's cloneNode().
+*/
+template<class Key, class Value>
+BinarySearchTree<Key, Value>&
+BinarySearchTree<Key, Value>::operator=(const BinarySearchTree<Key, Value>& other)
+{
+    if(this != &other){
+        copyFrom(other);
+        rebalanceFactor_ = other.rebalanceFactor_;
+    }
+    return *this;
+}
+
+/**
+* Move assignment. Frees this tree's nodes and steals other's in O(1).
+*/
+template<class Key, class Value>
+BinarySearchTree<Key, Value>&
+BinarySearchTree<Key, Value>::operator=(BinarySearchTree<Key, Value>&& other)
+{
+    if(this != &other){
+        releaseNodes();
+        root_ = other.root_;
+        size_ = other.size_;
+        minNode_ = other.minNode_;
+        maxNode_ = other.maxNode_;
+        rebalanceFactor_ = other.rebalanceFactor_;
+        rebalanceDebt_ = other.rebalanceDebt_;
+        compacting_ = other.compacting_;
+        compactNext_ = other.compactNext_;
+        compactMark_ = other.compactMark_;
+        blocks_ = std::move(other.blocks_);
+        other.root_ = nullptr;
+        other.size_ = 0;
+        other.minNode_ = nullptr;
+        other.maxNode_ = nullptr;
+        other.rebalanceDebt_ = 0;
+        other.compacting_ = false;
+        other.compactNext_ = nullptr;
+    }
+    return *this;
+}
+
+/**
+* Replaces the contents of this tree with a structural copy of other.
+* If parallel is true and other has at least PARALLEL_CLONE_MIN_NODES
+* nodes, the top few levels are split across hardware threads.
+* The tree is left unchanged if an allocation fails.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::copyFrom(const BinarySearchTree<Key, Value>& other, bool parallel)
+{
+    if(this == &other){
+        return;
+    }
+
+    Node<Key, Value>* copy = nullptr;
+    if(parallel && hasAtLeast(other.root_, PARALLEL_CLONE_MIN_NODES)){
+        copy = cloneParallel(other.root_, nullptr, parallelDepth());
+    } else {
+        copy = cloneSubtree(other.root_, nullptr);
+    }
 
+    releaseNodes();
+    root_ = copy;
+    size_ = other.size_;
+    findExtremes();
+    rebalanceDebt_ = other.rebalanceDebt_;
+    bulkChanged();
 }
 
 /**
@@ -400,6 +1050,15 @@ bool BinarySearchTree<Key, Value>::empty() const
     return root_ == NULL;
 }
 
+/**
+* Returns the number of keys in the tree, in O(1)
+*/
+template<class Key, class Value>
+size_t BinarySearchTree<Key, Value>::size() const
+{
+    return size_;
+}
+
 template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::print() const
 {
@@ -442,6 +1101,32 @@ BinarySearchTree<Key, Value>::find(const Key & k) const
     return it;
 }
 
+/**
+* Returns an iterator to the first item whose key is not less than k,
+* or the end iterator if there is none
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::lower_bound(const Key& k) const
+{
+    Node<Key, Value>* node = root_;
+    Node<Key, Value>* candidate = NULL;
+    KeyCache cache = KeyTraits<Key>::makeCache(k);
+
+    while(node != nullptr){
+        int cmp = compareToNode(k, cache, node);
+        if(cmp == 0){
+            return iterator(node);
+        } else if(cmp < 0){
+            candidate = node;
+            node = node->getLeft();
+        } else {
+            node = node->getRight();
+        }
+    }
+    return iterator(candidate);
+}
+
 /**
  * @precondition The key exists in the map
  * Returns the value associated with the key
@@ -462,29 +1147,122 @@ Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
 }
 
 /**
-* An insert method to insert into a Binary Search Tree.
-* The tree will not remain balanced when inserting.
-* Recall: If key is already in the tree, you should 
-* overwrite the current value with the updated value.
+* @precondition The tree is not empty
+* Returns the item with the smallest key, in O(1)
 */
 template<class Key, class Value>
-void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
+std::pair<const Key, Value>& BinarySearchTree<Key, Value>::front()
 {
-    // TODO
-    if(root_ == nullptr){
-      root_ = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, nullptr);
-      return;
+    if(minNode_ == NULL) throw std::out_of_range("Empty tree");
+    return minNode_->getItem();
+}
+template<class Key, class Value>
+std::pair<const Key, Value> const & BinarySearchTree<Key, Value>::front() const
+{
+    if(minNode_ == NULL) throw std::out_of_range("Empty tree");
+    return minNode_->getItem();
+}
+
+/**
+* @precondition The tree is not empty
+* Returns the item with the largest key, in O(1)
+*/
+template<class Key, class Value>
+std::pair<const Key, Value>& BinarySearchTree<Key, Value>::back()
+{
+    if(maxNode_ == NULL) throw std::out_of_range("Empty tree");
+    return maxNode_->getItem();
+}
+template<class Key, class Value>
+std::pair<const Key, Value> const & BinarySearchTree<Key, Value>::back() const
+{
+    if(maxNode_ == NULL) throw std::out_of_range("Empty tree");
+    return maxNode_->getItem();
+}
+
+/**
+* @precondition The tree is not empty
+* Removes the item with the smallest key and returns it. The cached node
+* is taken out through the virtual unlinkNode(), as extract() does, so
+* there is no search from the root and derived trees rebalance as usual.
+*/
+template<class Key, class Value>
+std::pair<Key, Value> BinarySearchTree<Key, Value>::pop_min()
+{
+    if(minNode_ == NULL) throw std::out_of_range("Empty tree");
+    Node<Key, Value>* node = minNode_;
+    std::pair<Key, Value> item(node->getKey(), node->getValue());
+    unlinkNode(node);
+    destroyNode(node);
+    return item;
+}
+
+/**
+* @precondition The tree is not empty
+* Removes the item with the largest key and returns it.
+*/
+template<class Key, class Value>
+std::pair<Key, Value> BinarySearchTree<Key, Value>::pop_max()
+{
+    if(maxNode_ == NULL) throw std::out_of_range("Empty tree");
+    Node<Key, Value>* node = maxNode_;
+    std::pair<Key, Value> item(node->getKey(), node->getValue());
+    unlinkNode(node);
+    destroyNode(node);
+    return item;
+}
+
+/**
+* Removes the k items with the smallest keys (or all of them, if there
+* are fewer) and returns them in increasing key order. The items are
+* copied in a walk from the cached minimum, and the range is then handed
+* to eraseNodes() in one go.
+*/
+template<class Key, class Value>
+std::vector<std::pair<Key, Value> > BinarySearchTree<Key, Value>::pop_min(size_t k)
+{
+    std::vector<std::pair<Key, Value> > items;
+    items.reserve(k < size_ ? k : size_);
+    Node<Key, Value>* last = minNode_;
+    while(items.size() < k && last != NULL){
+        items.push_back(std::pair<Key, Value>(last->getKey(), last->getValue()));
+        last = successor(last);
+    }
+    if(!items.empty()){
+        eraseNodes(minNode_, last);
+    }
+    return items;
+}
+
+/**
+* An insert method to insert into a Binary Search Tree.
+* The tree will not remain balanced when inserting.
+* Recall: If key is already in the tree, you should 
+* overwrite the current value with the updated value.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
+{
+    // TODO
+    if(root_ == nullptr){
+      root_ = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, nullptr);
+      noteInserted(root_);
+      noteInsertDepth(0);
+      return;
     }
 
     Node<Key, Value>* position = root_;
+    KeyCache cache = KeyTraits<Key>::makeCache(keyValuePair.first);
+    size_t depth = 1;
 
     while(true){
-      if(keyValuePair.first == position->getKey()){
+      int cmp = compareToNode(keyValuePair.first, cache, position);
+      if(cmp == 0){
         position->setValue(keyValuePair.second);
         return;
       }
   
-      bool goLeft = (keyValuePair.first < position->getKey());
+      bool goLeft = (cmp < 0);
       Node<Key, Value>* nextPosition = nullptr;
 
       if(goLeft){
@@ -500,10 +1278,13 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
         } else {
           position->setRight(newNode);
         }
+        noteInserted(newNode);
+        noteInsertDepth(depth);
         return;
       }
 
     position = nextPosition;
+    depth++;
   }
 }
     
@@ -520,8 +1301,20 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
     // TODO
     Node<Key, Value>* node = internalFind(key);
     if(node == nullptr){
-      return; 
+      return;
     }
+    BinarySearchTree<Key, Value>::unlinkNode(node);
+    destroyNode(node);
+}
+
+/**
+* Takes node out of the tree without freeing it. Its own links are left
+* stale.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::unlinkNode(Node<Key, Value>* node)
+{
+    noteRemoving(node);
     //swap if 2 children
     if((node->getLeft() != nullptr) && (node->getRight() != nullptr)){
       nodeSwap(node, predecessor(node));
@@ -541,7 +1334,6 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
 
     if(node->getParent() == nullptr){
       root_ = promoted;
-      delete node;
       return;
     }
 
@@ -551,8 +1343,6 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
     } else {
       par->setRight(promoted);
     }
-
-    delete node;
 }
 
 
@@ -592,21 +1382,341 @@ BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
     return result;
 } 
 
+/**
+* Applies ops as if one at a time in order, so for each key only the last
+* op on it counts. The batch is sorted by key first. A batch that is
+* small next to the tree then goes through the virtual insert() and
+* remove() in key order, so consecutive ops descend mostly the same,
+* already cached, path. A larger one is merged with the tree's nodes in
+* a single in-order pass and the result relinked into a minimum-height
+* tree, in O(n + b log b) for b ops; derived trees see the merge through
+* bulkChanged() rather than insert() and remove(). If an allocation fails
+* during the merge, the tree is left unchanged.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::apply_batch(const std::vector<BatchOp<Key, Value> >& ops)
+{
+    // sort pointers, not the ops, so keys and values are never copied
+    std::vector<const BatchOp<Key, Value>*> sorted(ops.size());
+    for(size_t i = 0; i < ops.size(); ++i){
+        sorted[i] = &ops[i];
+    }
+    std::stable_sort(sorted.begin(), sorted.end(),
+        [](const BatchOp<Key, Value>* a, const BatchOp<Key, Value>* b) { return a->key < b->key; });
+
+    // keep the last op of each run of equal keys
+    size_t unique = 0;
+    for(size_t i = 0; i < sorted.size(); ++i){
+        if(i + 1 < sorted.size() && !(sorted[i]->key < sorted[i + 1]->key)){
+            continue;
+        }
+        sorted[unique++] = sorted[i];
+    }
+    sorted.resize(unique);
+
+    if(unique * BATCH_MERGE_FRACTION >= size_ && unique > 0){
+        mergeBatch(sorted);
+        return;
+    }
+    for(size_t i = 0; i < sorted.size(); ++i){
+        if(sorted[i]->remove){
+            remove(sorted[i]->key);
+        } else {
+            insert(std::pair<const Key, Value>(sorted[i]->key, sorted[i]->value));
+        }
+    }
+}
+
+/**
+* Removes the items in [first, last) and returns last, which stays valid.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::erase(iterator first, iterator last)
+{
+    if(first.current_ != NULL){
+        eraseNodes(first.current_, last.current_);
+    }
+    return last;
+}
+
+/**
+* Removes every item with lo <= key < hi and returns how many there were.
+*/
+template<class Key, class Value>
+size_t BinarySearchTree<Key, Value>::erase_range(const Key& lo, const Key& hi)
+{
+    Node<Key, Value>* first = lower_bound(lo).current_;
+    if(first == NULL || compareToNode(hi, KeyTraits<Key>::makeCache(hi), first) <= 0){
+        return 0;
+    }
+    return eraseNodes(first, lower_bound(hi).current_);
+}
+
+/**
+* Removes every item for which pred(item) is true, in one in-order pass.
+* If that is at least 1/BULK_RELINK_FRACTION of the items, the survivors
+* are then relinked into a minimum-height tree in O(n); otherwise the
+* matches are removed one by one. Returns the number of items removed.
+*/
+template<class Key, class Value>
+template<typename Pred>
+size_t BinarySearchTree<Key, Value>::erase_if(Pred pred)
+{
+    std::vector<Node<Key, Value>*> nodes;
+    collectInOrder(root_, nodes);
+    std::vector<Node<Key, Value>*> kept;
+    std::vector<Node<Key, Value>*> doomed;
+    kept.reserve(nodes.size());
+    for(size_t i = 0; i < nodes.size(); ++i){
+        if(i + PREFETCH_DISTANCE < nodes.size()){
+            BST_PREFETCH(nodes[i + PREFETCH_DISTANCE]);
+        }
+        if(pred(nodes[i]->getItem())){
+            doomed.push_back(nodes[i]);
+        } else {
+            kept.push_back(nodes[i]);
+        }
+    }
+    eraseCollected(kept, doomed);
+    return doomed.size();
+}
+
+/**
+* Takes key's node out of the tree and returns it in a handle, or returns
+* an empty handle if key is not in the tree.
+*/
+template<class Key, class Value>
+NodeHandle<Key, Value> BinarySearchTree<Key, Value>::extract(const Key& key)
+{
+    return extract(iterator(internalFind(key)));
+}
+
+/**
+* Takes pos's node out of the tree and returns it in a handle. Iterators
+* to other items stay valid. Extracting end() returns an empty handle.
+* A node that compaction placed in one of the tree's blocks is first
+* copied to the heap, since the block stays with the tree.
+*/
+template<class Key, class Value>
+NodeHandle<Key, Value> BinarySearchTree<Key, Value>::extract(iterator pos)
+{
+    Node<Key, Value>* node = pos.current_;
+    if(node == NULL){
+        return NodeHandle<Key, Value>();
+    }
+    node = moveToHeap(node);
+    unlinkNode(node);
+    node->setParent(NULL);
+    node->setLeft(NULL);
+    node->setRight(NULL);
+    return NodeHandle<Key, Value>(node);
+}
+
+/**
+* Links the handle's node into the tree and empties the handle, returning
+* an iterator to the item. If the key is already in the tree nothing
+* changes: the handle keeps its node and the iterator points to the item
+* already there. Inserting an empty handle returns end().
+* @throws std::invalid_argument if the node came from a tree using another
+*         kind of node (an AVLTree's node cannot go into an RBTree)
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::insert(NodeHandle<Key, Value>&& handle)
+{
+    if(handle.node_ == NULL){
+        return end();
+    }
+    if(!acceptsNode(handle.node_)){
+        throw std::invalid_argument("Incompatible node");
+    }
+    Node<Key, Value>* placed = linkNode(handle.node_);
+    if(placed == handle.node_){
+        handle.node_ = NULL;
+    }
+    return iterator(placed);
+}
+
+/**
+* Moves every node of other whose key is not already in this tree over
+* to this tree, relinking nodes one at a time so no item is copied and
+* nothing is allocated, except that nodes in other's compaction blocks
+* are copied to the heap first. Nodes with keys this tree has stay in
+* other. Returns the number moved.
+* @throws std::invalid_argument if other uses another kind of node
+*/
+template<class Key, class Value>
+size_t BinarySearchTree<Key, Value>::splice(BinarySearchTree<Key, Value>& other)
+{
+    if(this == &other || other.root_ == NULL){
+        return 0;
+    }
+    if(!acceptsNode(other.root_)){
+        throw std::invalid_argument("Incompatible node");
+    }
+    size_t moved = 0;
+    Node<Key, Value>* node = other.minNode_;
+    while(node != NULL){
+        // rebalancing moves nodes around but never changes their order
+        Node<Key, Value>* next = successor(node);
+        if(internalFind(node->getKey()) == NULL){
+            node = other.moveToHeap(node);
+            other.unlinkNode(node);
+            node->setParent(NULL);
+            node->setLeft(NULL);
+            node->setRight(NULL);
+            linkNode(node);
+            moved++;
+        }
+        node = next;
+    }
+    return moved;
+}
+
+/**
+* Moves every node into one new block, in the given order, so that nodes
+* scattered by a long run of churn end up side by side again. The tree
+* keeps its shape, but iterators are invalidated and each value is copied
+* once. The blocks of earlier compactions are freed. Memory of nodes
+* later removed from the block is kept until the next compaction or
+* clear() (see NodeBlocks). A pass started by compactStep() is abandoned.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::compact(CompactOrder order)
+{
+    stopCompaction();
+    std::vector<Node<Key, Value>*> nodes;
+    if(order == COMPACT_VEB){
+        collectVeb(root_, nodes);
+    } else {
+        collectInOrder(root_, nodes);
+    }
+    size_t mark = blocks_.mark();
+    {
+        NodeBlocks::Fill fill(blocks_, nodes.size());
+        for(size_t i = 0; i < nodes.size(); ++i){
+            relocateNode(nodes[i]);
+            destroyNode(nodes[i]);
+        }
+    }
+    blocks_.freeBefore(mark);
+}
+
+/**
+* Runs an in-order compaction in steps of at most budget nodes, so that
+* no call takes long; each step fills a block of its own. The tree may be
+* used and changed between steps, and nodes inserted behind the cursor
+* are left where they are. Iterators to moved nodes are invalidated.
+* Returns true when the step completes the pass, which frees the blocks
+* filled before it began; the next call starts a new one.
+*/
+template<class Key, class Value>
+bool BinarySearchTree<Key, Value>::compactStep(size_t budget)
+{
+    if(!compacting_){
+        compacting_ = true;
+        compactNext_ = minNode_;
+        compactMark_ = blocks_.mark();
+    }
+    {
+        NodeBlocks::Fill fill(blocks_, budget < size_ ? budget : size_);
+        for(; budget > 0 && compactNext_ != NULL; --budget){
+            Node<Key, Value>* node = compactNext_;
+            compactNext_ = successor(node);
+            try {
+                relocateNode(node);
+            } catch(...) {
+                compactNext_ = node;
+                throw;
+            }
+            destroyNode(node);
+        }
+    }
+    if(compactNext_ != NULL){
+        return false;
+    }
+    // every node that was in an older block has been moved out of it
+    compacting_ = false;
+    blocks_.freeBefore(compactMark_);
+    return true;
+}
+
+/**
+* The number of blocks compaction has filled that the tree still holds.
+*/
+template<class Key, class Value>
+size_t BinarySearchTree<Key, Value>::blockCount() const
+{
+    return blocks_.count();
+}
+
+/**
+* Returns the node after current in key order, or NULL if it is the last.
+*/
+template<class Key, class Value>
+Node<Key, Value>*
+BinarySearchTree<Key, Value>::successor(Node<Key, Value>* current)
+{
+    if(current == nullptr){
+        return nullptr;
+    }
+    Node<Key, Value>* node = current->getRight();
+    if(node != nullptr){
+        while(node->getLeft() != nullptr){
+            node = node->getLeft();
+        }
+        return node;
+    }
+    node = current;
+    Node<Key, Value>* parent = node->getParent();
+    while(parent != nullptr && node == parent->getRight()){
+        node = parent;
+        parent = parent->getParent();
+    }
+    return parent;
+}
+
 
 /**
 * A method to remove all contents of the tree and
 * reset the values in the tree for use again.
+* If parallel is true and the tree has at least PARALLEL_CLEAR_MIN_NODES
+* nodes, the top few levels are split across hardware threads.
 */
 template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::clear()
+void BinarySearchTree<Key, Value>::clear(bool parallel)
 {
     // TODO
+    releaseNodes(parallel);
+    bulkChanged();
+}
+
+/**
+* Frees every node and empties the tree without calling bulkChanged(),
+* for the destructor and for operations that refill the tree at once.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::releaseNodes(bool parallel)
+{
+    stopCompaction();
     if(root_ == nullptr){
+        blocks_.freeAll();
         return;
     }
 
-    helpClear(root_);
+    int depth = parallel ? parallelDepth() : 0;
+    if(depth > 0 && hasAtLeast(root_, PARALLEL_CLEAR_MIN_NODES)){
+        clearParallel(root_, depth);
+    } else {
+        helpClear(root_);
+    }
+    blocks_.freeAll();
     root_ = nullptr;
+    size_ = 0;
+    minNode_ = nullptr;
+    maxNode_ = nullptr;
+    rebalanceDebt_ = 0;
 }
 
 
@@ -618,18 +1728,7 @@ Node<Key, Value>*
 BinarySearchTree<Key, Value>::getSmallestNode() const
 {
     // TODO
-    Node<Key, Value>* smallest = root_;
-
-    //if empty
-    if(smallest == nullptr){
-        return nullptr;
-    }
-
-    //keep going left
-    while(smallest->getLeft() != nullptr){
-        smallest = smallest->getLeft();
-    }
-    return smallest;
+    return minNode_;
 }
 
 /**
@@ -642,13 +1741,14 @@ Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) con
 {
     // TODO
     Node<Key, Value>* node = root_;
+    KeyCache cache = KeyTraits<Key>::makeCache(key);
 
     while(node != nullptr){
-        const Key& nodeKey = node->getKey();
+        int cmp = compareToNode(key, cache, node);
 
-        if(key == nodeKey){
+        if(cmp == 0){
             return node;
-        } else if(key < nodeKey){
+        } else if(cmp < 0){
             node = node->getLeft();
         } else {
             node = node->getRight();
@@ -657,6 +1757,23 @@ Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) con
     return nullptr;
 }
 
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::makeIterator(Node<Key, Value>* node)
+{
+    return iterator(node);
+}
+
+/**
+* Compares key (whose cache the caller built once per search) with a
+* node's key. Returns <0, 0 or >0 like KeyTraits<Key>::compare.
+*/
+template<typename Key, typename Value>
+int BinarySearchTree<Key, Value>::compareToNode(const Key& key, const KeyCache& cache, const Node<Key, Value>* node)
+{
+    return KeyTraits<Key>::compare(key, cache, node->getKey(), node->getKeyCache());
+}
+
 /**
  * Return true iff the BST is balanced.
  */
@@ -775,15 +1892,51 @@ End implementations for the BinarySearchTree class.
 
 //my helper functions
 template<typename Key, typename Value>
-void BinarySearchTree<Key,Value>::helpClear(Node<Key,Value>* node){
-    if(node == nullptr){
-        return;
+void BinarySearchTree<Key,Value>::helpClear(Node<Key,Value>* node) const {
+    // rotate left children up until the current node has none, then free
+    // it and continue with its right subtree: O(n) time, no stack
+    while(node != nullptr){
+        Node<Key, Value>* left = node->getLeft();
+        if(left != nullptr){
+            node->setLeft(left->getRight());
+            left->setRight(node);
+            node = left;
+        } else {
+            Node<Key, Value>* right = node->getRight();
+            destroyNode(node);
+            node = right;
+        }
     }
+}
 
-    helpClear(node->getLeft());
-    helpClear(node->getRight());
+/**
+* Frees the subtree rooted at node, handing the left subtree to a new
+* thread for the first depth levels and finishing each piece serially.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::clearParallel(Node<Key, Value>* node, int depth) const
+{
+    if(node == nullptr || depth <= 0){
+        helpClear(node);
+        return;
+    }
 
-    delete node;
+    Node<Key, Value>* left = node->getLeft();
+    Node<Key, Value>* right = node->getRight();
+    destroyNode(node);
+    std::thread worker;
+    try {
+        worker = std::thread([this, left, depth]() {
+            clearParallel(left, depth - 1);
+        });
+    } catch(const std::system_error&) {
+        // no thread to spare: free this half here as well
+        helpClear(left);
+    }
+    clearParallel(right, depth - 1);
+    if(worker.joinable()){
+        worker.join();
+    }
 }
 
 
@@ -794,32 +1947,1082 @@ int BinarySearchTree<Key, Value>::helpBalancedHeight(Node<Key, Value>* node) con
     if (node == NULL) {
         return 0;
     }
-    
-    // heights of subtrees
-    int leftHeight = helpBalancedHeight(node->getLeft());
-    if(leftHeight == -1){
-      return -1;
+
+    // post-order walk with parent pointers; leftHeights[d] holds the height
+    // of the finished left subtree of the node at depth d below node
+    int leftHeights[MAX_BALANCED_HEIGHT];
+    Node<Key, Value>* stop = node->getParent();
+    Node<Key, Value>* prev = stop;
+    int depth = 0;
+    int lastHeight = 0;
+
+    while(true){
+        int rightHeight;
+        if(prev == node->getParent()){
+            // first visit, from above
+            if(depth >= MAX_BALANCED_HEIGHT){
+                return -1;
+            }
+            if(node->getLeft() != nullptr){
+                prev = node;
+                node = node->getLeft();
+                depth++;
+                continue;
+            }
+            leftHeights[depth] = 0;
+            if(node->getRight() != nullptr){
+                prev = node;
+                node = node->getRight();
+                depth++;
+                continue;
+            }
+            rightHeight = 0;
+        } else if(prev == node->getLeft()){
+            leftHeights[depth] = lastHeight;
+            if(node->getRight() != nullptr){
+                prev = node;
+                node = node->getRight();
+                depth++;
+                continue;
+            }
+            rightHeight = 0;
+        } else {
+            rightHeight = lastHeight;
+        }
+
+        //if heights differ by at most 1 / is balanced
+        int leftHeight = leftHeights[depth];
+        int heightDifference = leftHeight - rightHeight;
+        if (heightDifference > 1 || heightDifference < -1) {
+            return -1;
+        }
+        lastHeight = 1 + (leftHeight > rightHeight ? leftHeight : rightHeight);
+
+        if(depth == 0){
+            return lastHeight;
+        }
+        prev = node;
+        node = node->getParent();
+        depth--;
     }
-    int rightHeight = helpBalancedHeight(node->getRight());
-    if(rightHeight == -1){
-      return -1;
+}
+
+
+
+/**
+* Restructures the tree into a complete binary tree (every level full
+* except the bottom one, which is filled from the left) in O(n) time and
+* O(1) extra space, using rotations only (Day-Stout-Warren). No nodes are
+* allocated or freed, so iterators stay valid. Trees with per-node balance
+* information get it recomputed through setBuiltBalance().
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::rebalance()
+{
+    size_t size = treeToVine();
+
+    // the bottom level takes the keys beyond the largest perfect tree
+    size_t perfect = 0;
+    while(perfect * 2 + 1 <= size){
+        perfect = perfect * 2 + 1;
     }
-    
-    //if heights differ by at most 1 / is balanced
-    int heightDifference = leftHeight - rightHeight;
-    if (heightDifference > 1 || heightDifference < -1) {
-        return -1;
+    compressVine(size - perfect);
+    for(size_t count = perfect / 2; count > 0; count /= 2){
+        compressVine(count);
     }
-    
-    int maxHeight;
-    if(leftHeight >rightHeight){
-      maxHeight = leftHeight;
-    } else {
-      maxHeight = rightHeight;
+
+    setRebalancedBalance();
+    rebalanceDebt_ = 0;
+}
+
+/**
+* Turns on automatic rebalancing for inserts made through this class's
+* insert(): an insert that lands deeper than factor * log2(size + 1)
+* adds its excess depth to a running total, and once that total reaches
+* the tree's size the tree is rebalanced. The rebalance is thus paid for
+* by search work already lost to the bad shape. factor must be at least
+* 1; 0 turns the trigger off (the default).
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::setRebalanceFactor(double factor)
+{
+    if(factor != 0 && !(factor >= 1)){
+        throw std::invalid_argument("rebalance factor must be 0 or at least 1");
     }
-    return maxHeight + 1;
+    rebalanceFactor_ = factor;
+    rebalanceDebt_ = 0;
 }
 
+/**
+* Records a new node at depth (the root being at 0) and rebalances if the
+* automatic trigger fires.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::noteInsertDepth(size_t depth)
+{
+    if(rebalanceFactor_ == 0){
+        return;
+    }
+    double limit = rebalanceFactor_ * std::log2(static_cast<double>(size_ + 1));
+    if(static_cast<double>(depth) > limit){
+        rebalanceDebt_ += depth - static_cast<size_t>(limit);
+        if(rebalanceDebt_ >= size_){
+            rebalance();
+        }
+    }
+}
 
+/**
+* Counts a node that has just been linked into the tree, taking it as the
+* new minimum or maximum if its key is beyond the current one. Called by
+* every insert path, before any rebalancing.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::noteInserted(Node<Key, Value>* node)
+{
+    size_++;
+    if(minNode_ == nullptr){
+        minNode_ = maxNode_ = node;
+        return;
+    }
+    if(compareToNode(node->getKey(), node->getKeyCache(), minNode_) < 0){
+        minNode_ = node;
+    } else if(compareToNode(node->getKey(), node->getKeyCache(), maxNode_) > 0){
+        maxNode_ = node;
+    }
+}
+
+/**
+* Uncounts a node that is about to be unlinked and freed. Must be called
+* while the tree is still intact: a departing extreme hands over to its
+* in-order neighbour, which stays the extreme through any swaps and
+* rotations the remove makes, since those move nodes, not keys. The
+* cursor of a compaction in progress moves on the same way.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::noteRemoving(Node<Key, Value>* node)
+{
+    size_--;
+    if(node == compactNext_){
+        compactNext_ = successor(node);
+    }
+    if(node == minNode_){
+        minNode_ = successor(node);
+    }
+    if(node == maxNode_){
+        maxNode_ = predecessor(node);
+    }
+}
+
+/**
+* Recomputes the cached extremes after the tree was built wholesale.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::findExtremes()
+{
+    minNode_ = maxNode_ = root_;
+    if(root_ == nullptr){
+        return;
+    }
+    while(minNode_->getLeft() != nullptr){
+        minNode_ = minNode_->getLeft();
+    }
+    while(maxNode_->getRight() != nullptr){
+        maxNode_ = maxNode_->getRight();
+    }
+}
+
+/**
+* First DSW phase: right rotations turn the tree into a "vine" in which
+* every node has only a right child. Returns the number of nodes.
+*/
+template<typename Key, typename Value>
+size_t BinarySearchTree<Key, Value>::treeToVine()
+{
+    Node<Key, Value>* tail = nullptr;   // last node already on the vine
+    Node<Key, Value>* rest = root_;
+    size_t size = 0;
+    while(rest != nullptr){
+        Node<Key, Value>* left = rest->getLeft();
+        if(left == nullptr){
+            tail = rest;
+            rest = rest->getRight();
+            size++;
+            continue;
+        }
+        // rotate right at rest
+        rest->setLeft(left->getRight());
+        if(left->getRight() != nullptr){
+            left->getRight()->setParent(rest);
+        }
+        left->setRight(rest);
+        rest->setParent(left);
+        left->setParent(tail);
+        if(tail == nullptr){
+            root_ = left;
+        } else {
+            tail->setRight(left);
+        }
+        rest = left;
+    }
+    return size;
+}
+
+/**
+* Second DSW phase: left-rotates every other node of the top count pairs
+* of the vine (the right spine from the root), halving its length.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::compressVine(size_t count)
+{
+    Node<Key, Value>* scanner = nullptr;    // parent of the next pair
+    for(size_t i = 0; i < count; ++i){
+        Node<Key, Value>* child = (scanner == nullptr) ? root_ : scanner->getRight();
+        Node<Key, Value>* next = child->getRight();
+        // rotate left at child
+        child->setRight(next->getLeft());
+        if(next->getLeft() != nullptr){
+            next->getLeft()->setParent(child);
+        }
+        next->setLeft(child);
+        child->setParent(next);
+        next->setParent(scanner);
+        if(scanner == nullptr){
+            root_ = next;
+        } else {
+            scanner->setRight(next);
+        }
+        scanner = next;
+    }
+}
+
+/**
+* Calls setBuiltBalance() on every node of the rebalanced tree in
+* post-order, as buildBalanced() does. Every subtree of a complete tree
+* is complete, so its height is the length of its leftmost path. The
+* walk uses parent pointers and sums to O(n) work.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::setRebalancedBalance()
+{
+    Node<Key, Value>* node = root_;
+    if(node == nullptr){
+        return;
+    }
+    // first node in post-order: descend preferring left
+    while(node->getLeft() != nullptr || node->getRight() != nullptr){
+        node = (node->getLeft() != nullptr) ? node->getLeft() : node->getRight();
+    }
+    while(node != nullptr){
+        setBuiltBalance(node, leftPathHeight(node->getLeft()), leftPathHeight(node->getRight()));
+        Node<Key, Value>* par = node->getParent();
+        if(par != nullptr && node == par->getLeft() && par->getRight() != nullptr){
+            node = par->getRight();
+            while(node->getLeft() != nullptr || node->getRight() != nullptr){
+                node = (node->getLeft() != nullptr) ? node->getLeft() : node->getRight();
+            }
+        } else {
+            node = par;
+        }
+    }
+}
+
+template<typename Key, typename Value>
+int BinarySearchTree<Key, Value>::leftPathHeight(const Node<Key, Value>* node)
+{
+    int height = 0;
+    for(; node != nullptr; node = node->getLeft()){
+        height++;
+    }
+    return height;
+}
+
+/**
+* Replaces the contents of the tree with the n items keys[i] -> values[i].
+* The keys must be in strictly increasing order. Builds a minimum-height
+* tree in O(n) without any comparisons or rebalancing.
+*/
+template<typename Key, typename Value>
+template<typename KeyIter, typename ValueIter>
+void BinarySearchTree<Key, Value>::assignSorted(KeyIter keys, ValueIter values, size_t n)
+{
+    int height = 0;
+    Node<Key, Value>* built = buildBalanced(keys, values, 0, n, nullptr, height);
+    releaseNodes();
+    root_ = built;
+    size_ = n;
+    findExtremes();
+    bulkChanged();
+}
+
+/**
+* Merges ops, sorted by key with one op per key, into the tree. New
+* nodes are created and the kept ones ordered before anything in the tree
+* is touched; only then are values overwritten, the removed nodes freed
+* and the rest relinked.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::mergeBatch(const std::vector<const BatchOp<Key, Value>*>& ops)
+{
+    std::vector<Node<Key, Value>*> nodes;
+    collectInOrder(root_, nodes);
+    std::vector<Node<Key, Value>*> kept;
+    std::vector<Node<Key, Value>*> doomed;
+    std::vector<std::pair<Node<Key, Value>*, const Value*> > updates;
+    std::vector<Node<Key, Value>*> created;
+    try {
+        kept.reserve(nodes.size() + ops.size());
+        size_t i = 0;
+        for(size_t j = 0; j < ops.size(); ++j){
+            const BatchOp<Key, Value>& op = *ops[j];
+            KeyCache cache = KeyTraits<Key>::makeCache(op.key);
+            int cmp = 1;
+            while(i < nodes.size() && (cmp = compareToNode(op.key, cache, nodes[i])) > 0){
+                kept.push_back(nodes[i++]);
+            }
+            if(i < nodes.size() && cmp == 0){
+                if(op.remove){
+                    doomed.push_back(nodes[i]);
+                } else {
+                    updates.push_back(std::make_pair(nodes[i], &op.value));
+                    kept.push_back(nodes[i]);
+                }
+                i++;
+            } else if(!op.remove){
+                created.push_back(nullptr);
+                created.back() = createNode(op.key, op.value, nullptr);
+                kept.push_back(created.back());
+            }
+        }
+        kept.insert(kept.end(), nodes.begin() + i, nodes.end());
+    } catch(...) {
+        for(size_t i = 0; i < created.size(); ++i){
+            delete created[i];
+        }
+        throw;
+    }
+
+    for(size_t i = 0; i < updates.size(); ++i){
+        updates[i].first->setValue(*updates[i].second);
+    }
+    for(size_t i = 0; i < doomed.size(); ++i){
+        destroyNode(doomed[i]);
+    }
+    relinkKept(kept);
+}
+
+/**
+* Removes the nodes from first up to (not including) last, which may be
+* NULL for the end. Nodes are taken out one at a time through the virtual
+* unlinkNode(), stepping to each one's successor first, so no search from
+* the root is needed. Once 1/BULK_RANGE_FRACTION of the keys have gone
+* that way, the rest of the range is cut out by eraseBetween().
+*/
+template<typename Key, typename Value>
+size_t BinarySearchTree<Key, Value>::eraseNodes(Node<Key, Value>* first, Node<Key, Value>* last)
+{
+    size_t limit = size_ / BULK_RANGE_FRACTION;
+    size_t k = 0;
+    Node<Key, Value>* node = first;
+    for(; node != last && k < limit; ++k){
+        // nodeSwap() and rebalancing move nodes rather than keys, so next
+        // and last stay put
+        Node<Key, Value>* next = successor(node);
+        unlinkNode(node);
+        destroyNode(node);
+        node = next;
+    }
+    if(node == last){
+        return k;
+    }
+    return k + eraseBetween(node, last);
+}
+
+/**
+* Cuts the nodes from first up to (not including) last out of the tree
+* and relinks the rest, in O(log n + k) besides the O(n - k) relink.
+* Descending from the root with the bounds each subtree's keys are known
+* to lie within, only the nodes on the paths to first and last are
+* classified one by one. Subtrees off those paths are either wholly kept,
+* and collected in order, or wholly in the range, and freed without being
+* walked in order.
+*/
+template<typename Key, typename Value>
+size_t BinarySearchTree<Key, Value>::eraseBetween(Node<Key, Value>* first, Node<Key, Value>* last)
+{
+    struct Frame
+    {
+        Node<Key, Value>* node;
+        bool doomed;
+        bool belowLast;     // the node's subtree is known to lie below last
+    };
+    std::vector<Frame> stack;
+    std::vector<Node<Key, Value>*> kept;
+    std::vector<Node<Key, Value>*> doomedRoots;    // subtrees wholly in the range
+    std::vector<Node<Key, Value>*> doomed;         // single nodes on the paths
+    kept.reserve(size_);
+
+    Node<Key, Value>* node = root_;
+    bool fromFirst = false;     // the subtree is known to lie at or above first
+    bool belowLast = false;
+    while(true){
+        while(node != nullptr){
+            if(fromFirst && belowLast){
+                doomedRoots.push_back(node);
+                break;
+            }
+            if(compareToNode(node->getKey(), node->getKeyCache(), first) < 0){
+                collectInOrder(node->getLeft(), kept);
+                kept.push_back(node);
+                node = node->getRight();
+            } else if(last != nullptr && compareToNode(node->getKey(), node->getKeyCache(), last) >= 0){
+                Frame frame = { node, false, belowLast };
+                stack.push_back(frame);
+                node = node->getLeft();
+            } else {
+                Frame frame = { node, true, belowLast };
+                stack.push_back(frame);
+                doomed.push_back(node);
+                node = node->getLeft();
+                belowLast = true;
+            }
+        }
+        if(stack.empty()){
+            break;
+        }
+        Frame frame = stack.back();
+        stack.pop_back();
+        if(frame.doomed){
+            node = frame.node->getRight();
+            fromFirst = true;
+            belowLast = frame.belowLast;
+        } else {
+            kept.push_back(frame.node);
+            collectInOrder(frame.node->getRight(), kept);
+            node = nullptr;
+        }
+    }
+
+    size_t k = size_ - kept.size();
+    for(size_t i = 0; i < doomedRoots.size(); ++i){
+        helpClear(doomedRoots[i]);
+    }
+    for(size_t i = 0; i < doomed.size(); ++i){
+        destroyNode(doomed[i]);
+    }
+    relinkKept(kept);
+    return k;
+}
+
+/**
+* Takes the doomed nodes out of the tree given the rest, in key order, as
+* kept. A large share is freed wholesale and the kept nodes are relinked;
+* a small one goes through remove(). Iterators to kept items stay valid.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::eraseCollected(std::vector<Node<Key, Value>*>& kept,
+    std::vector<Node<Key, Value>*>& doomed)
+{
+    if(doomed.size() * BULK_RELINK_FRACTION < size_){
+        // nodeSwap() moves nodes rather than keys, so the doomed
+        // pointers stay good as the others are removed
+        for(size_t i = 0; i < doomed.size(); ++i){
+            Key key = doomed[i]->getKey();
+            remove(key);
+        }
+        return;
+    }
+
+    // every link is rewritten below, so the nodes can go in any order
+    for(size_t i = 0; i < doomed.size(); ++i){
+        if(i + PREFETCH_DISTANCE < doomed.size()){
+            BST_PREFETCH(doomed[i + PREFETCH_DISTANCE]);
+        }
+        destroyNode(doomed[i]);
+    }
+    relinkKept(kept);
+}
+
+/**
+* Makes kept, in key order, the tree's whole contents once every other
+* node has been freed.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::relinkKept(std::vector<Node<Key, Value>*>& kept)
+{
+    stopCompaction();
+    root_ = relinkBalanced(kept);
+    size_ = kept.size();
+    findExtremes();
+    rebalanceDebt_ = 0;
+    bulkChanged();
+}
+
+/**
+* Appends the nodes under root to nodes in key order. The explicit stack
+* holds each node's right child alongside it, so every node is read only
+* once, and the right child is prefetched when it is pushed.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::collectInOrder(Node<Key, Value>* root, std::vector<Node<Key, Value>*>& nodes)
+{
+    std::vector<std::pair<Node<Key, Value>*, Node<Key, Value>*> > stack;
+    Node<Key, Value>* node = root;
+    while(true){
+        for(; node != nullptr; node = node->getLeft()){
+            Node<Key, Value>* right = node->getRight();
+            BST_PREFETCH(right);
+            stack.push_back(std::make_pair(node, right));
+        }
+        if(stack.empty()){
+            return;
+        }
+        nodes.push_back(stack.back().first);
+        node = stack.back().second;
+        stack.pop_back();
+    }
+}
+
+/**
+* Links nodes, which must be in key order, into the tree buildBalanced()
+* would build for them and returns its root. A subtree over m nodes has
+* height floor(log2 m) + 1, so each node can be linked from the addresses
+* of its neighbours alone. That lets the nodes be written in key order
+* with the ones ahead prefetched. setBuiltBalance() still runs in
+* post-order, as soon as a node's right subtree is complete.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::relinkBalanced(std::vector<Node<Key, Value>*>& nodes) const
+{
+    struct Range
+    {
+        size_t lo;
+        size_t hi;
+        Node<Key, Value>* parent;
+    };
+    struct Pending
+    {
+        Node<Key, Value>* node;
+        size_t hi;
+        int leftHeight;
+        int rightHeight;
+    };
+    // one of each per level, and a tree over size_t nodes has at most 64
+    Range stack[64];
+    Pending pending[64];
+    int top = 0;
+    int waiting = 0;
+    Node<Key, Value>* root = nullptr;
+    Range range = { 0, nodes.size(), nullptr };
+
+    while(true){
+        while(range.lo < range.hi){
+            stack[top++] = range;
+            range.parent = nodes[range.lo + (range.hi - range.lo) / 2];
+            range.hi = range.lo + (range.hi - range.lo) / 2;
+        }
+        if(top == 0){
+            return root;
+        }
+        range = stack[--top];
+        size_t mid = range.lo + (range.hi - range.lo) / 2;
+        if(mid + PREFETCH_DISTANCE < nodes.size()){
+            BST_PREFETCH(nodes[mid + PREFETCH_DISTANCE]);
+        }
+
+        Node<Key, Value>* node = nodes[mid];
+        size_t leftSize = mid - range.lo;
+        size_t rightSize = range.hi - mid - 1;
+        node->setParent(range.parent);
+        node->setLeft(leftSize > 0 ? nodes[range.lo + leftSize / 2] : nullptr);
+        node->setRight(rightSize > 0 ? nodes[mid + 1 + rightSize / 2] : nullptr);
+        if(range.parent == nullptr){
+            root = node;
+        }
+
+        Pending done = { node, range.hi, 0, 0 };
+        for(size_t m = leftSize; m > 0; m >>= 1){
+            done.leftHeight++;
+        }
+        for(size_t m = rightSize; m > 0; m >>= 1){
+            done.rightHeight++;
+        }
+        pending[waiting++] = done;
+        // every subtree ending at this node is now complete
+        while(waiting > 0 && pending[waiting - 1].hi == mid + 1){
+            waiting--;
+            setBuiltBalance(pending[waiting].node, pending[waiting].leftHeight, pending[waiting].rightHeight);
+        }
+
+        range.lo = mid + 1;
+        range.parent = node;
+    }
+}
+
+/**
+* Walks down to where key belongs. Returns the node holding key with cmp
+* set to 0, or else the node a new node for key would hang from, with cmp
+* saying which side (NULL for an empty tree). depth is the depth the new
+* node would have.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::findSlot(const Key& key, int& cmp, size_t& depth) const
+{
+    KeyCache cache = KeyTraits<Key>::makeCache(key);
+    Node<Key, Value>* parent = NULL;
+    Node<Key, Value>* curr = root_;
+    cmp = 0;
+    depth = 0;
+    while(curr != NULL){
+        parent = curr;
+        cmp = compareToNode(key, cache, curr);
+        if(cmp == 0){
+            return curr;
+        }
+        curr = (cmp < 0) ? curr->getLeft() : curr->getRight();
+        depth++;
+    }
+    return parent;
+}
+
+/**
+* Hangs the unlinked node from parent on the side findSlot() gave, or
+* makes it the root if parent is NULL.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::attachNode(Node<Key, Value>* node, Node<Key, Value>* parent, int cmp)
+{
+    node->setParent(parent);
+    if(parent == NULL){
+        root_ = node;
+    } else if(cmp < 0){
+        parent->setLeft(node);
+    } else {
+        parent->setRight(node);
+    }
+}
+
+/**
+* Links an unlinked node into the tree as insert() would have created it.
+* If its key is already in the tree nothing changes and the node holding
+* the key is returned; otherwise node is.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::linkNode(Node<Key, Value>* node)
+{
+    int cmp;
+    size_t depth;
+    Node<Key, Value>* parent = findSlot(node->getKey(), cmp, depth);
+    if(parent != NULL && cmp == 0){
+        return parent;
+    }
+    attachNode(node, parent, cmp);
+    noteInserted(node);
+    noteInsertDepth(depth);
+    return node;
+}
+
+/**
+* Whether node is of the type this tree builds, so it can be linked in.
+*/
+template<typename Key, typename Value>
+bool BinarySearchTree<Key, Value>::acceptsNode(const Node<Key, Value>* node) const
+{
+    return typeid(*node) == typeid(Node<Key, Value>);
+}
+
+/**
+* Replaces node in the tree by a copy made with cloneNode(), taking over
+* its links, and returns the copy. node itself is left unlinked but not
+* freed.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::relocateNode(Node<Key, Value>* node)
+{
+    Node<Key, Value>* parent = node->getParent();
+    Node<Key, Value>* copy = cloneNode(node, parent);
+    Node<Key, Value>* left = node->getLeft();
+    Node<Key, Value>* right = node->getRight();
+    copy->setLeft(left);
+    copy->setRight(right);
+    if(left != NULL){
+        left->setParent(copy);
+    }
+    if(right != NULL){
+        right->setParent(copy);
+    }
+    if(parent == NULL){
+        root_ = copy;
+    } else if(parent->getLeft() == node){
+        parent->setLeft(copy);
+    } else {
+        parent->setRight(copy);
+    }
+    if(minNode_ == node){
+        minNode_ = copy;
+    }
+    if(maxNode_ == node){
+        maxNode_ = copy;
+    }
+    nodeRelocated(node, copy);
+    return copy;
+}
+
+/**
+* Called when compaction has replaced from by to. Trees that keep node
+* pointers beside the tree repoint them here.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::nodeRelocated(Node<Key, Value>* from, Node<Key, Value>* to)
+{
+
+}
+
+/**
+* Replaces node by a copy on the heap if it lies in one of this tree's
+* blocks, so it can be handed to another tree or a NodeHandle, and
+* returns the node now in its place.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::moveToHeap(Node<Key, Value>* node)
+{
+    if(!blocks_.holds(node)){
+        return node;
+    }
+    Node<Key, Value>* copy = relocateNode(node);
+    if(compactNext_ == node){
+        compactNext_ = copy;
+    }
+    destroyNode(node);
+    return copy;
+}
+
+/**
+* Frees a node taken out of the tree. A node in one of the tree's blocks
+* is only destroyed; its memory goes with the block.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::destroyNode(Node<Key, Value>* node) const
+{
+    if(blocks_.holds(node)){
+        node->~Node();
+    } else {
+        delete node;
+    }
+}
+
+/**
+* Abandons a compactStep() pass, for when the tree is rebuilt wholesale.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::stopCompaction()
+{
+    compacting_ = false;
+    compactNext_ = NULL;
+}
+
+/**
+* Lists the nodes under root in van Emde Boas order: a subtree of height
+* h is laid out as its top h/2 levels, then each subtree hanging below
+* them, each of those recursively the same way. Any root-to-leaf path
+* then crosses O(log_B n) blocks of B nodes, whatever B is. Uses an
+* explicit work stack, so degenerate trees are fine.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::collectVeb(Node<Key, Value>* root, std::vector<Node<Key, Value>*>& nodes)
+{
+    if(root == NULL){
+        return;
+    }
+    // the height, from a level-by-level walk
+    std::vector<Node<Key, Value>*> level(1, root);
+    std::vector<Node<Key, Value>*> below;
+    int height = 0;
+    while(!level.empty()){
+        height++;
+        below.clear();
+        for(size_t i = 0; i < level.size(); ++i){
+            if(level[i]->getLeft() != NULL){
+                below.push_back(level[i]->getLeft());
+            }
+            if(level[i]->getRight() != NULL){
+                below.push_back(level[i]->getRight());
+            }
+        }
+        level.swap(below);
+    }
+
+    struct Task
+    {
+        Node<Key, Value>* node;
+        int height;     // levels of node's subtree this task covers
+    };
+    std::vector<Task> tasks;
+    std::vector<std::pair<Node<Key, Value>*, int> > walk;
+    std::vector<Node<Key, Value>*> frontier;
+    Task first = { root, height };
+    tasks.push_back(first);
+    while(!tasks.empty()){
+        Task task = tasks.back();
+        tasks.pop_back();
+        if(task.height == 1){
+            nodes.push_back(task.node);
+            continue;
+        }
+        int top = task.height / 2;
+
+        // the roots of the bottom subtrees, left to right
+        frontier.clear();
+        walk.push_back(std::make_pair(task.node, 0));
+        while(!walk.empty()){
+            Node<Key, Value>* node = walk.back().first;
+            int depth = walk.back().second;
+            walk.pop_back();
+            if(depth == top){
+                frontier.push_back(node);
+                continue;
+            }
+            if(node->getRight() != NULL){
+                walk.push_back(std::make_pair(node->getRight(), depth + 1));
+            }
+            if(node->getLeft() != NULL){
+                walk.push_back(std::make_pair(node->getLeft(), depth + 1));
+            }
+        }
+
+        // pushed in reverse, so the top comes off first
+        for(size_t i = frontier.size(); i > 0; --i){
+            Task bottom = { frontier[i - 1], task.height - top };
+            tasks.push_back(bottom);
+        }
+        Task upper = { task.node, top };
+        tasks.push_back(upper);
+    }
+}
+
+/**
+* Allocates a new unlinked node of the tree's node type.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent) const
+{
+    return new Node<Key, Value>(key, value, parent);
+}
+
+/**
+* Called by buildBalanced() once both subtrees of node are built. Plain
+* BSTs keep no balance information so there is nothing to do.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::setBuiltBalance(Node<Key, Value>* node, int leftHeight, int rightHeight) const
+{
+
+}
+
+/**
+* Called after a bulk operation freed or relinked nodes without going
+* through insert() or remove(): clear(), copyFrom(), assignSorted() and
+* the bulk erase and batch paths. Trees that keep structures beside the
+* nodes bring them back in sync here, so those operations stay correct
+* when called through a BinarySearchTree reference.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::bulkChanged()
+{
+
+}
+
+/**
+* Builds a minimum-height subtree from items [lo, hi) by taking the middle
+* item as the root. Sets height to the height of the new subtree.
+*/
+template<typename Key, typename Value>
+template<typename KeyIter, typename ValueIter>
+Node<Key, Value>* BinarySearchTree<Key, Value>::buildBalanced(KeyIter keys, ValueIter values,
+    size_t lo, size_t hi, Node<Key, Value>* parent, int& height) const
+{
+    if(lo >= hi){
+        height = 0;
+        return nullptr;
+    }
+
+    size_t mid = lo + (hi - lo) / 2;
+    Node<Key, Value>* node = createNode(keys[mid], values[mid], parent);
+    int leftHeight = 0;
+    int rightHeight = 0;
+    try {
+        node->setLeft(buildBalanced(keys, values, lo, mid, node, leftHeight));
+        node->setRight(buildBalanced(keys, values, mid + 1, hi, node, rightHeight));
+    } catch(...) {
+        helpClear(node);
+        throw;
+    }
+
+    setBuiltBalance(node, leftHeight, rightHeight);
+    height = 1 + (leftHeight > rightHeight ? leftHeight : rightHeight);
+    return node;
+}
+
+/**
+* Allocates a copy of a single node (without its links). Derived trees
+* override this to create their own node type and copy any metadata.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const
+{
+    return new Node<Key, Value>(src->getKey(), src->getValue(), parent);
+}
+
+/**
+* Copies the subtree rooted at src without recursion by walking the source
+* and the copy in lockstep using parent pointers. Returns the copy's root,
+* whose parent is set to parent.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::cloneSubtree(const Node<Key, Value>* src, Node<Key, Value>* parent) const
+{
+    if(src == nullptr){
+        return nullptr;
+    }
+
+    Node<Key, Value>* copyRoot = cloneNode(src, parent);
+    const Node<Key, Value>* s = src;
+    Node<Key, Value>* d = copyRoot;
+
+    try {
+        while(true){
+            if(s->getLeft() != nullptr && d->getLeft() == nullptr){
+                d->setLeft(cloneNode(s->getLeft(), d));
+                s = s->getLeft();
+                d = d->getLeft();
+            } else if(s->getRight() != nullptr && d->getRight() == nullptr){
+                d->setRight(cloneNode(s->getRight(), d));
+                s = s->getRight();
+                d = d->getRight();
+            } else if(s == src){
+                break;
+            } else {
+                s = s->getParent();
+                d = d->getParent();
+            }
+        }
+    } catch(...) {
+        helpClear(copyRoot);
+        throw;
+    }
+    return copyRoot;
+}
+
+/**
+* Copies the subtree rooted at src, handing the left subtree to a new
+* thread for the first depth levels and finishing each piece serially.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::cloneParallel(const Node<Key, Value>* src, Node<Key, Value>* parent, int depth) const
+{
+    if(src == nullptr || depth <= 0){
+        return cloneSubtree(src, parent);
+    }
+
+    Node<Key, Value>* copy = cloneNode(src, parent);
+    Node<Key, Value>* leftCopy = nullptr;
+    Node<Key, Value>* rightCopy = nullptr;
+    std::exception_ptr leftError;
+    std::exception_ptr rightError;
+
+    std::thread worker([&]() {
+        try {
+            leftCopy = cloneParallel(src->getLeft(), copy, depth - 1);
+        } catch(...) {
+            leftError = std::current_exception();
+        }
+    });
+    try {
+        rightCopy = cloneParallel(src->getRight(), copy, depth - 1);
+    } catch(...) {
+        rightError = std::current_exception();
+    }
+    worker.join();
+
+    copy->setLeft(leftCopy);
+    copy->setRight(rightCopy);
+    if(leftError || rightError){
+        helpClear(copy);
+        std::rethrow_exception(leftError ? leftError : rightError);
+    }
+    return copy;
+}
+
+/**
+* Makes an empty, just-constructed tree a node-for-node copy of other,
+* with its size, extremes and rebalance settings. Copy constructors call
+* this from their own body rather than using the base copy constructor,
+* whose cloneNode() calls cannot reach a derived tree's override.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::cloneFrom(const BinarySearchTree<Key, Value>& other)
+{
+    root_ = cloneSubtree(other.root_, nullptr);
+    size_ = other.size_;
+    findExtremes();
+    rebalanceFactor_ = other.rebalanceFactor_;
+    rebalanceDebt_ = other.rebalanceDebt_;
+}
+
+/**
+* The number of levels of the tree that parallel copies and clears split,
+* one per doubling of the hardware thread count.
+*/
+template<typename Key, typename Value>
+int BinarySearchTree<Key, Value>::parallelDepth()
+{
+    int depth = 0;
+    for(unsigned threads = std::thread::hardware_concurrency(); threads > 1; threads /= 2){
+        depth++;
+    }
+    return depth;
+}
+
+/**
+* Returns true if the subtree rooted at root has at least count nodes.
+* Stops walking as soon as the answer is known.
+*/
+template<typename Key, typename Value>
+bool BinarySearchTree<Key, Value>::hasAtLeast(const Node<Key, Value>* root, size_t count)
+{
+    if(root == nullptr){
+        return count == 0;
+    }
+
+    const Node<Key, Value>* node = root;
+    while(node->getLeft() != nullptr){
+        node = node->getLeft();
+    }
+
+    size_t seen = 0;
+    while(node != nullptr){
+        if(++seen >= count){
+            return true;
+        }
+        // in-order successor, bounded by root
+        if(node->getRight() != nullptr){
+            node = node->getRight();
+            while(node->getLeft() != nullptr){
+                node = node->getLeft();
+            }
+        } else {
+            const Node<Key, Value>* prev = node;
+            node = node->getParent();
+            while(node != nullptr && prev != root && node->getRight() == prev){
+                prev = node;
+                node = node->getParent();
+            }
+            if(prev == root){
+                node = nullptr;
+            }
+        }
+    }
+    return false;
+}
 
 #endif
@@ -0,0 +1,452 @@
+#ifndef BST_FILTER_H
+#define BST_FILTER_H
+
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+#include "bst.h"
+#include "avlbst.h"
+
+/**
+* A counting Bloom filter in front of a search tree, so that lookups for
+* keys that are not in the tree usually return without walking to a leaf.
+*
+* Each key sets BLOOM_HASHES 4-bit counters chosen by double hashing of
+* one 64-bit hash. Removing a key decrements them again; a counter that
+* saturates at 15 stays there, which can only cause false positives.
+* The filter is rebuilt from the tree's keys whenever the tree outgrows
+* it, so it stays near BLOOM_COUNTERS_PER_KEY counters per key (about a
+* 1% false positive rate) without being sized up front.
+*/
+
+#define BLOOM_HASHES 5
+#define BLOOM_COUNTERS_PER_KEY 10
+#define BLOOM_MIN_COUNTERS 64
+
+struct FilterStats
+{
+    uint64_t lookups;           // find() and operator[] calls
+    uint64_t rejected;          // answered "absent" by the filter alone
+    uint64_t falsePositives;    // passed the filter but not in the tree
+
+    double falsePositiveRate() const
+    {
+        uint64_t absent = rejected + falsePositives;
+        return absent == 0 ? 0.0 : static_cast<double>(falsePositives) / absent;
+    }
+
+    double rejectRate() const
+    {
+        return lookups == 0 ? 0.0 : static_cast<double>(rejected) / lookups;
+    }
+};
+
+/**
+* The filter itself, working on already-mixed 64-bit hashes.
+*/
+class CountingBloomFilter
+{
+public:
+    explicit CountingBloomFilter(size_t capacity = 0);
+
+    void reset(size_t capacity);
+    void add(uint64_t hash);
+    void remove(uint64_t hash);
+    bool mayContain(uint64_t hash) const;
+
+    size_t capacity() const;
+    size_t memoryUsage() const;
+
+private:
+    size_t slot(uint64_t hash, uint64_t step, int i) const;
+    unsigned get(size_t slot) const;
+    void set(size_t slot, unsigned count);
+    static uint64_t stepOf(uint64_t hash);
+
+    static const unsigned COUNTER_MAX = 15;
+
+    std::vector<uint8_t> counters_;     // two 4-bit counters per byte
+    int bits_;                          // log2 of the number of counters
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the CountingBloomFilter class.
+  -----------------------------------------------
+*/
+
+inline CountingBloomFilter::CountingBloomFilter(size_t capacity) : bits_(0)
+{
+    reset(capacity);
+}
+
+/**
+* Empties the filter and sizes it for capacity keys.
+*/
+inline void CountingBloomFilter::reset(size_t capacity)
+{
+    int bits = 0;
+    while((size_t(1) << bits) < BLOOM_MIN_COUNTERS ||
+          (size_t(1) << bits) < capacity * BLOOM_COUNTERS_PER_KEY){
+        bits++;
+    }
+    std::vector<uint8_t> counters((size_t(1) << bits) / 2, 0);
+    counters_.swap(counters);
+    bits_ = bits;
+}
+
+inline void CountingBloomFilter::add(uint64_t hash)
+{
+    uint64_t step = stepOf(hash);
+    for(int i = 0; i < BLOOM_HASHES; ++i){
+        size_t s = slot(hash, step, i);
+        unsigned count = get(s);
+        if(count < COUNTER_MAX){
+            set(s, count + 1);
+        }
+    }
+}
+
+/**
+* Undoes add(hash). Only call it for a hash that was added.
+*/
+inline void CountingBloomFilter::remove(uint64_t hash)
+{
+    uint64_t step = stepOf(hash);
+    for(int i = 0; i < BLOOM_HASHES; ++i){
+        size_t s = slot(hash, step, i);
+        unsigned count = get(s);
+        if(count > 0 && count < COUNTER_MAX){
+            set(s, count - 1);
+        }
+    }
+}
+
+inline bool CountingBloomFilter::mayContain(uint64_t hash) const
+{
+    uint64_t step = stepOf(hash);
+    for(int i = 0; i < BLOOM_HASHES; ++i){
+        if(get(slot(hash, step, i)) == 0){
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+* Keys the filter holds before its false positive rate passes the target.
+*/
+inline size_t CountingBloomFilter::capacity() const
+{
+    return (size_t(1) << bits_) / BLOOM_COUNTERS_PER_KEY;
+}
+
+inline size_t CountingBloomFilter::memoryUsage() const
+{
+    return counters_.capacity();
+}
+
+/**
+* The i-th probe is hash + i * step, taking the top bits as the slot.
+*/
+inline size_t CountingBloomFilter::slot(uint64_t hash, uint64_t step, int i) const
+{
+    return static_cast<size_t>((hash + i * step) >> (64 - bits_));
+}
+
+inline unsigned CountingBloomFilter::get(size_t slot) const
+{
+    return (counters_[slot >> 1] >> ((slot & 1) * 4)) & 0xf;
+}
+
+inline void CountingBloomFilter::set(size_t slot, unsigned count)
+{
+    int shift = (slot & 1) * 4;
+    uint8_t& byte = counters_[slot >> 1];
+    byte = static_cast<uint8_t>((byte & ~(0xf << shift)) | (count << shift));
+}
+
+/**
+* A second, odd hash derived from the first for double hashing.
+*/
+inline uint64_t CountingBloomFilter::stepOf(uint64_t hash)
+{
+    hash ^= hash >> 31;
+    hash *= 0xBF58476D1CE4E5B9ull;
+    hash ^= hash >> 29;
+    return hash | 1;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the CountingBloomFilter class.
+  -----------------------------------------------
+*/
+
+/**
+* A search tree (AVLTree by default, or BinarySearchTree) whose find()
+* and operator[] consult a CountingBloomFilter first.
+*
+* Because the filter counts, a removed key can be taken back out of it.
+* insert(), remove() and node handles add or take out one key each;
+* clear(), copyFrom(), assignSorted() and the bulk erase and batch paths
+* refill the filter from the tree through bulkChanged().
+*/
+template <typename Key, typename Value,
+          template <typename, typename> class Tree = AVLTree,
+          typename Hash = std::hash<Key> >
+class FilteredTree : public Tree<Key, Value>
+{
+public:
+    typedef typename BinarySearchTree<Key, Value>::iterator iterator;
+
+    FilteredTree();
+    FilteredTree(const FilteredTree<Key, Value, Tree, Hash>& other);
+    FilteredTree(FilteredTree<Key, Value, Tree, Hash>&& other);
+    FilteredTree<Key, Value, Tree, Hash>& operator=(const FilteredTree<Key, Value, Tree, Hash>& other);
+    FilteredTree<Key, Value, Tree, Hash>& operator=(FilteredTree<Key, Value, Tree, Hash>&& other);
+
+    using BinarySearchTree<Key, Value>::insert;
+    virtual void insert(const std::pair<const Key, Value>& keyValuePair) override;
+    virtual void remove(const Key& key) override;
+
+    iterator find(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+    const FilterStats& filterStats() const;
+    void resetFilterStats();
+    size_t filterMemoryUsage() const;
+
+protected:
+    uint64_t hashOf(const Key& key) const;
+    Node<Key, Value>* filteredFind(const Key& key) const;
+    void rebuildFilter(size_t extra);
+    virtual void bulkChanged() override;
+    virtual Node<Key, Value>* linkNode(Node<Key, Value>* node) override;
+    virtual void unlinkNode(Node<Key, Value>* node) override;
+
+private:
+    CountingBloomFilter filter_;
+    Hash hasher_;
+    mutable FilterStats stats_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the FilteredTree class.
+  -----------------------------------------------
+*/
+
+template<typename Key, typename Value, template <typename, typename> class Tree, typename Hash>
+FilteredTree<Key, Value, Tree, Hash>::FilteredTree() :
+    Tree<Key, Value>(), filter_(0)
+{
+    resetFilterStats();
+}
+
+template<typename Key, typename Value, template <typename, typename> class Tree, typename Hash>
+FilteredTree<Key, Value, Tree, Hash>::FilteredTree(const FilteredTree<Key, Value, Tree, Hash>& other) :
+    Tree<Key, Value>(other), filter_(other.filter_), hasher_(other.hasher_)
+{
+    resetFilterStats();
+}
+
+template<typename Key, typename Value, template <typename, typename> class Tree, typename Hash>
+FilteredTree<Key, Value, Tree, Hash>::FilteredTree(FilteredTree<Key, Value, Tree, Hash>&& other) :
+    Tree<Key, Value>(std::move(other)),
+    filter_(std::move(other.filter_)),
+    hasher_(other.hasher_),
+    stats_(other.stats_)
+{
+    other.filter_.reset(0);
+}
+
+template<typename Key, typename Value, template <typename, typename> class Tree, typename Hash>
+FilteredTree<Key, Value, Tree, Hash>&
+FilteredTree<Key, Value, Tree, Hash>::operator=(const FilteredTree<Key, Value, Tree, Hash>& other)
+{
+    if(this != &other){
+        Tree<Key, Value>::operator=(other);
+        filter_ = other.filter_;
+        hasher_ = other.hasher_;
+    }
+    return *this;
+}
+
+template<typename Key, typename Value, template <typename, typename> class Tree, typename Hash>
+FilteredTree<Key, Value, Tree, Hash>&
+FilteredTree<Key, Value, Tree, Hash>::operator=(FilteredTree<Key, Value, Tree, Hash>&& other)
+{
+    if(this != &other){
+        Tree<Key, Value>::operator=(std::move(other));
+        filter_ = std::move(other.filter_);
+        hasher_ = other.hasher_;
+        other.filter_.reset(0);
+    }
+    return *this;
+}
+
+/**
+* A key the filter rejects is certainly new; otherwise the tree is asked.
+* The filter is grown before the tree changes, so a failed allocation
+* leaves both untouched.
+*/
+template<typename Key, typename Value, template <typename, typename> class Tree, typename Hash>
+void FilteredTree<Key, Value, Tree, Hash>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    uint64_t hash = hashOf(keyValuePair.first);
+    if(filter_.mayContain(hash) && this->internalFind(keyValuePair.first) != NULL){
+        Tree<Key, Value>::insert(keyValuePair);
+        return;
+    }
+    if(this->size_ + 1 > filter_.capacity()){
+        rebuildFilter(1);
+    }
+    Tree<Key, Value>::insert(keyValuePair);
+    filter_.add(hash);
+}
+
+template<typename Key, typename Value, template <typename, typename> class Tree, typename Hash>
+void FilteredTree<Key, Value, Tree, Hash>::remove(const Key& key)
+{
+    uint64_t hash = hashOf(key);
+    if(!filter_.mayContain(hash) || this->internalFind(key) == NULL){
+        return;
+    }
+    Tree<Key, Value>::remove(key);
+    filter_.remove(hash);
+}
+
+/**
+* Node handles keep the filter in sync the same way insert() and remove()
+* do.
+*/
+template<typename Key, typename Value, template <typename, typename> class Tree, typename Hash>
+Node<Key, Value>* FilteredTree<Key, Value, Tree, Hash>::linkNode(Node<Key, Value>* node)
+{
+    uint64_t hash = hashOf(node->getKey());
+    if(filter_.mayContain(hash)){
+        Node<Key, Value>* existing = this->internalFind(node->getKey());
+        if(existing != NULL){
+            return existing;
+        }
+    }
+    if(this->size_ + 1 > filter_.capacity()){
+        rebuildFilter(1);
+    }
+    Tree<Key, Value>::linkNode(node);
+    filter_.add(hash);
+    return node;
+}
+
+template<typename Key, typename Value, template <typename, typename> class Tree, typename Hash>
+void FilteredTree<Key, Value, Tree, Hash>::unlinkNode(Node<Key, Value>* node)
+{
+    uint64_t hash = hashOf(node->getKey());
+    Tree<Key, Value>::unlinkNode(node);
+    filter_.remove(hash);
+}
+
+template<typename Key, typename Value, template <typename, typename> class Tree, typename Hash>
+typename FilteredTree<Key, Value, Tree, Hash>::iterator
+FilteredTree<Key, Value, Tree, Hash>::find(const Key& key) const
+{
+    return this->makeIterator(filteredFind(key));
+}
+
+/**
+* @precondition The key exists in the map
+* Returns the value associated with the key
+*/
+template<typename Key, typename Value, template <typename, typename> class Tree, typename Hash>
+Value& FilteredTree<Key, Value, Tree, Hash>::operator[](const Key& key)
+{
+    Node<Key, Value>* node = filteredFind(key);
+    if(node == NULL) throw std::out_of_range("Invalid key");
+    return node->getValue();
+}
+
+template<typename Key, typename Value, template <typename, typename> class Tree, typename Hash>
+Value const & FilteredTree<Key, Value, Tree, Hash>::operator[](const Key& key) const
+{
+    Node<Key, Value>* node = filteredFind(key);
+    if(node == NULL) throw std::out_of_range("Invalid key");
+    return node->getValue();
+}
+
+template<typename Key, typename Value, template <typename, typename> class Tree, typename Hash>
+const FilterStats& FilteredTree<Key, Value, Tree, Hash>::filterStats() const
+{
+    return stats_;
+}
+
+template<typename Key, typename Value, template <typename, typename> class Tree, typename Hash>
+void FilteredTree<Key, Value, Tree, Hash>::resetFilterStats()
+{
+    stats_.lookups = 0;
+    stats_.rejected = 0;
+    stats_.falsePositives = 0;
+}
+
+template<typename Key, typename Value, template <typename, typename> class Tree, typename Hash>
+size_t FilteredTree<Key, Value, Tree, Hash>::filterMemoryUsage() const
+{
+    return filter_.memoryUsage();
+}
+
+template<typename Key, typename Value, template <typename, typename> class Tree, typename Hash>
+uint64_t FilteredTree<Key, Value, Tree, Hash>::hashOf(const Key& key) const
+{
+    return mixKeyHash(hasher_(key));
+}
+
+/**
+* internalFind() behind the filter, counting what the filter saved.
+*/
+template<typename Key, typename Value, template <typename, typename> class Tree, typename Hash>
+Node<Key, Value>* FilteredTree<Key, Value, Tree, Hash>::filteredFind(const Key& key) const
+{
+    stats_.lookups++;
+    if(!filter_.mayContain(hashOf(key))){
+        stats_.rejected++;
+        return NULL;
+    }
+    Node<Key, Value>* node = this->internalFind(key);
+    if(node == NULL){
+        stats_.falsePositives++;
+    }
+    return node;
+}
+
+/**
+* Re-adds every key to a filter sized for twice the keys the tree will
+* hold after extra more inserts, so growth rebuilds are amortized.
+*/
+template<typename Key, typename Value, template <typename, typename> class Tree, typename Hash>
+void FilteredTree<Key, Value, Tree, Hash>::rebuildFilter(size_t extra)
+{
+    std::vector<Node<Key, Value>*> nodes;
+    this->collectInOrder(this->root_, nodes);
+    CountingBloomFilter filter(2 * (nodes.size() + extra));
+    for(size_t i = 0; i < nodes.size(); ++i){
+        filter.add(hashOf(nodes[i]->getKey()));
+    }
+    filter_ = std::move(filter);
+}
+
+template<typename Key, typename Value, template <typename, typename> class Tree, typename Hash>
+void FilteredTree<Key, Value, Tree, Hash>::bulkChanged()
+{
+    Tree<Key, Value>::bulkChanged();
+    rebuildFilter(0);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the FilteredTree class.
+  -----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,505 @@
+#ifndef BST_SNAPSHOT_H
+#define BST_SNAPSHOT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "bst.h"
+
+/**
+* Binary snapshots of a BinarySearchTree (or AVLTree) whose keys and values
+* are trivially copyable.
+*
+* File layout (native byte order, checked through endianTag):
+*
+*   SnapshotHeader
+*   keys   column: count * sizeof(Key),   starting at keysOffset
+*   values column: count * sizeof(Value), starting at valuesOffset
+*
+* Both columns start on a SNAPSHOT_ALIGN boundary so that a mapped file
+* can be used in place. Keys are stored in increasing order. The checksum
+* is FNV-1a over the bytes of the keys column followed by the values column.
+* generation is an opaque number for the writer (LoggedAVLTree stores its
+* checkpoint count there); it sits in what was header padding, so files
+* written before it existed read as generation 0.
+*/
+
+#define SNAPSHOT_MAGIC "BSTSNAP1"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_ALIGN 64
+
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t endianTag;
+    uint32_t keySize;
+    uint32_t valueSize;
+    uint64_t count;
+    uint64_t keysOffset;
+    uint64_t valuesOffset;
+    uint64_t checksum;
+    uint64_t generation;
+};
+
+/**
+* Incremental 64-bit FNV-1a hash.
+*/
+class SnapshotChecksum
+{
+public:
+    SnapshotChecksum() : hash_(14695981039346656037ULL) { }
+
+    void update(const void* data, size_t len)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        uint64_t hash = hash_;
+        for(size_t i = 0; i < len; ++i){
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+        hash_ = hash;
+    }
+
+    uint64_t value() const { return hash_; }
+
+private:
+    uint64_t hash_;
+};
+
+static inline uint64_t snapshotAlignUp(uint64_t offset)
+{
+    return (offset + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+}
+
+static inline void snapshotPad(std::ofstream& out, uint64_t from, uint64_t to)
+{
+    static const char zeros[SNAPSHOT_ALIGN] = { 0 };
+    out.write(zeros, to - from);
+}
+
+/**
+* Forces the file or directory at path to disk. Throws std::runtime_error
+* on failure.
+*/
+static inline void snapshotSyncPath(const std::string& path, bool directory)
+{
+    int fd = ::open(path.c_str(), directory ? O_RDONLY | O_DIRECTORY : O_RDONLY);
+    if(fd < 0 || ::fsync(fd) != 0){
+        if(fd >= 0){
+            ::close(fd);
+        }
+        throw std::runtime_error("Cannot sync: " + path);
+    }
+    ::close(fd);
+}
+
+static inline std::string snapshotDirName(const std::string& path)
+{
+    size_t slash = path.find_last_of('/');
+    if(slash == std::string::npos){
+        return ".";
+    }
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+/**
+* Writes tree to path by streaming two in-order passes over it, one for
+* each column, and records generation in the header. The file is written
+* as path + ".tmp", synced, and renamed
+* over path, so a crash leaves either the old snapshot or the new one,
+* never a torn mix. Throws std::runtime_error if the file can't be
+* written; path is then left as it was.
+*/
+template<typename Key, typename Value>
+void saveSnapshot(const BinarySearchTree<Key, Value>& tree, const std::string& path, uint64_t generation = 0)
+{
+    static_assert(std::is_trivially_copyable<Key>::value, "snapshot keys must be trivially copyable");
+    static_assert(std::is_trivially_copyable<Value>::value, "snapshot values must be trivially copyable");
+    typedef typename BinarySearchTree<Key, Value>::iterator iterator;
+
+    std::string tempPath = path + ".tmp";
+    std::ofstream out(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+    if(!out){
+        throw std::runtime_error("Cannot open snapshot for writing: " + tempPath);
+    }
+
+    SnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.endianTag = 0x01020304;
+    header.keySize = sizeof(Key);
+    header.valueSize = sizeof(Value);
+    header.generation = generation;
+    header.keysOffset = snapshotAlignUp(sizeof(SnapshotHeader));
+
+    // placeholder header, rewritten once the count and checksum are known
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    snapshotPad(out, sizeof(header), header.keysOffset);
+
+    SnapshotChecksum checksum;
+    for(iterator it = tree.begin(); it != tree.end(); ++it){
+        out.write(reinterpret_cast<const char*>(&it->first), sizeof(Key));
+        checksum.update(&it->first, sizeof(Key));
+        header.count++;
+    }
+
+    uint64_t keysEnd = header.keysOffset + header.count * sizeof(Key);
+    header.valuesOffset = snapshotAlignUp(keysEnd);
+    snapshotPad(out, keysEnd, header.valuesOffset);
+
+    for(iterator it = tree.begin(); it != tree.end(); ++it){
+        out.write(reinterpret_cast<const char*>(&it->second), sizeof(Value));
+        checksum.update(&it->second, sizeof(Value));
+    }
+    header.checksum = checksum.value();
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+    if(!out){
+        std::remove(tempPath.c_str());
+        throw std::runtime_error("Error writing snapshot: " + tempPath);
+    }
+
+    try {
+        snapshotSyncPath(tempPath, false);
+    } catch(...) {
+        std::remove(tempPath.c_str());
+        throw;
+    }
+    if(std::rename(tempPath.c_str(), path.c_str()) != 0){
+        std::remove(tempPath.c_str());
+        throw std::runtime_error("Cannot install snapshot: " + path);
+    }
+    snapshotSyncPath(snapshotDirName(path), true);
+}
+
+/**
+* A read-only, memory-mapped view of a snapshot. Lookups binary search the
+* mapped key column directly, so opening a snapshot costs O(1) beyond the
+* optional checksum pass and pages are only read in as they are touched.
+*/
+template<typename Key, typename Value>
+class MappedSnapshot
+{
+public:
+    explicit MappedSnapshot(const std::string& path, bool verify = true);
+    ~MappedSnapshot();
+
+    size_t size() const;
+    bool empty() const;
+    uint64_t generation() const;
+    const Key* keys() const;
+    const Value* values() const;
+
+    /**
+    * An iterator over the snapshot in key order. Items are materialized
+    * as pairs since keys and values are stored in separate columns.
+    */
+    class iterator
+    {
+    public:
+        class ArrowProxy
+        {
+        public:
+            const std::pair<Key, Value>* operator->() const { return &item_; }
+        private:
+            friend class iterator;
+            ArrowProxy(const std::pair<Key, Value>& item) : item_(item) { }
+            std::pair<Key, Value> item_;
+        };
+
+        iterator();
+
+        std::pair<Key, Value> operator*() const;
+        ArrowProxy operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class MappedSnapshot<Key, Value>;
+        iterator(const MappedSnapshot<Key, Value>* snap, size_t index);
+        const MappedSnapshot<Key, Value>* snap_;
+        size_t index_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value const & operator[](const Key& key) const;
+
+    void loadInto(BinarySearchTree<Key, Value>& tree) const;
+
+private:
+    MappedSnapshot(const MappedSnapshot<Key, Value>&);
+    MappedSnapshot<Key, Value>& operator=(const MappedSnapshot<Key, Value>&);
+
+    size_t lowerBound(const Key& key) const;
+
+    void* map_;
+    size_t mapSize_;
+    size_t count_;
+    uint64_t generation_;
+    const Key* keys_;
+    const Value* values_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the MappedSnapshot class.
+  -----------------------------------------------
+*/
+
+/**
+* Maps the snapshot at path and validates its header. If verify is true
+* the checksum is also checked, which reads the whole file.
+* Throws std::runtime_error on any error.
+*/
+template<typename Key, typename Value>
+MappedSnapshot<Key, Value>::MappedSnapshot(const std::string& path, bool verify) :
+    map_(MAP_FAILED), mapSize_(0), count_(0), generation_(0), keys_(NULL), values_(NULL)
+{
+    static_assert(std::is_trivially_copyable<Key>::value, "snapshot keys must be trivially copyable");
+    static_assert(std::is_trivially_copyable<Value>::value, "snapshot values must be trivially copyable");
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0){
+        throw std::runtime_error("Cannot open snapshot: " + path);
+    }
+    struct stat st;
+    if(::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SnapshotHeader)){
+        ::close(fd);
+        throw std::runtime_error("Snapshot is truncated: " + path);
+    }
+    mapSize_ = st.st_size;
+    map_ = ::mmap(NULL, mapSize_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(map_ == MAP_FAILED){
+        throw std::runtime_error("Cannot map snapshot: " + path);
+    }
+
+    const SnapshotHeader* header = static_cast<const SnapshotHeader*>(map_);
+    const char* error = NULL;
+    if(std::memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0){
+        error = "Not a snapshot: ";
+    } else if(header->version != SNAPSHOT_VERSION || header->endianTag != 0x01020304){
+        error = "Unsupported snapshot version or byte order: ";
+    } else if(header->keySize != sizeof(Key) || header->valueSize != sizeof(Value)){
+        error = "Snapshot key/value sizes do not match: ";
+    } else if(header->keysOffset % SNAPSHOT_ALIGN != 0 || header->valuesOffset % SNAPSHOT_ALIGN != 0
+        || header->keysOffset > mapSize_ || header->valuesOffset > mapSize_
+        // divided rather than multiplied, so a corrupt count cannot wrap
+        || header->count > (mapSize_ - header->keysOffset) / sizeof(Key)
+        || header->count > (mapSize_ - header->valuesOffset) / sizeof(Value)){
+        error = "Snapshot is truncated: ";
+    }
+
+    if(error == NULL){
+        const char* base = static_cast<const char*>(map_);
+        count_ = header->count;
+        generation_ = header->generation;
+        keys_ = reinterpret_cast<const Key*>(base + header->keysOffset);
+        values_ = reinterpret_cast<const Value*>(base + header->valuesOffset);
+        if(verify){
+            SnapshotChecksum checksum;
+            checksum.update(keys_, count_ * sizeof(Key));
+            checksum.update(values_, count_ * sizeof(Value));
+            if(checksum.value() != header->checksum){
+                error = "Snapshot checksum mismatch: ";
+            }
+        }
+    }
+
+    if(error != NULL){
+        ::munmap(map_, mapSize_);
+        throw std::runtime_error(error + path);
+    }
+}
+
+template<typename Key, typename Value>
+MappedSnapshot<Key, Value>::~MappedSnapshot()
+{
+    ::munmap(map_, mapSize_);
+}
+
+template<typename Key, typename Value>
+size_t MappedSnapshot<Key, Value>::size() const
+{
+    return count_;
+}
+
+template<typename Key, typename Value>
+bool MappedSnapshot<Key, Value>::empty() const
+{
+    return count_ == 0;
+}
+
+/**
+* Returns the generation given to saveSnapshot().
+*/
+template<typename Key, typename Value>
+uint64_t MappedSnapshot<Key, Value>::generation() const
+{
+    return generation_;
+}
+
+template<typename Key, typename Value>
+const Key* MappedSnapshot<Key, Value>::keys() const
+{
+    return keys_;
+}
+
+template<typename Key, typename Value>
+const Value* MappedSnapshot<Key, Value>::values() const
+{
+    return values_;
+}
+
+/**
+* Returns the index of the first key that is not less than key.
+*/
+template<typename Key, typename Value>
+size_t MappedSnapshot<Key, Value>::lowerBound(const Key& key) const
+{
+    size_t lo = 0;
+    size_t len = count_;
+    while(len > 0){
+        size_t half = len / 2;
+        if(keys_[lo + half] < key){
+            lo += half + 1;
+            len -= half + 1;
+        } else {
+            len = half;
+        }
+    }
+    return lo;
+}
+
+template<typename Key, typename Value>
+typename MappedSnapshot<Key, Value>::iterator
+MappedSnapshot<Key, Value>::begin() const
+{
+    return iterator(this, 0);
+}
+
+template<typename Key, typename Value>
+typename MappedSnapshot<Key, Value>::iterator
+MappedSnapshot<Key, Value>::end() const
+{
+    return iterator(this, count_);
+}
+
+/**
+* Returns an iterator to the item with the given key or end().
+*/
+template<typename Key, typename Value>
+typename MappedSnapshot<Key, Value>::iterator
+MappedSnapshot<Key, Value>::find(const Key& key) const
+{
+    size_t index = lowerBound(key);
+    if(index < count_ && keys_[index] == key){
+        return iterator(this, index);
+    }
+    return end();
+}
+
+/**
+* Returns a reference into the mapped value column.
+* Throws std::out_of_range if the key doesn't exist.
+*/
+template<typename Key, typename Value>
+Value const & MappedSnapshot<Key, Value>::operator[](const Key& key) const
+{
+    size_t index = lowerBound(key);
+    if(index == count_ || !(keys_[index] == key)) throw std::out_of_range("Invalid key");
+    return values_[index];
+}
+
+/**
+* Replaces the contents of tree with the snapshot's items using a linear
+* time balanced rebuild. AVLTrees receive correct balances.
+*/
+template<typename Key, typename Value>
+void MappedSnapshot<Key, Value>::loadInto(BinarySearchTree<Key, Value>& tree) const
+{
+    tree.assignSorted(keys_, values_, count_);
+}
+
+template<typename Key, typename Value>
+MappedSnapshot<Key, Value>::iterator::iterator() :
+    snap_(NULL), index_(0)
+{
+
+}
+
+template<typename Key, typename Value>
+MappedSnapshot<Key, Value>::iterator::iterator(const MappedSnapshot<Key, Value>* snap, size_t index) :
+    snap_(snap), index_(index)
+{
+
+}
+
+template<typename Key, typename Value>
+std::pair<Key, Value> MappedSnapshot<Key, Value>::iterator::operator*() const
+{
+    return std::pair<Key, Value>(snap_->keys_[index_], snap_->values_[index_]);
+}
+
+template<typename Key, typename Value>
+typename MappedSnapshot<Key, Value>::iterator::ArrowProxy
+MappedSnapshot<Key, Value>::iterator::operator->() const
+{
+    return ArrowProxy(**this);
+}
+
+template<typename Key, typename Value>
+bool MappedSnapshot<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return snap_ == rhs.snap_ && index_ == rhs.index_;
+}
+
+template<typename Key, typename Value>
+bool MappedSnapshot<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+template<typename Key, typename Value>
+typename MappedSnapshot<Key, Value>::iterator&
+MappedSnapshot<Key, Value>::iterator::operator++()
+{
+    ++index_;
+    return *this;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the MappedSnapshot class.
+  -----------------------------------------------
+*/
+
+/**
+* Replaces the contents of tree with the snapshot stored at path.
+*/
+template<typename Key, typename Value>
+void loadSnapshot(BinarySearchTree<Key, Value>& tree, const std::string& path)
+{
+    MappedSnapshot<Key, Value> snap(path);
+    snap.loadInto(tree);
+}
+
+#endif
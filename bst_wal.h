@@ -0,0 +1,670 @@
+#ifndef BST_WAL_H
+#define BST_WAL_H
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "avlbst.h"
+#include "bst_snapshot.h"
+
+/**
+* Write-ahead logging for AVLTree.
+*
+* A LoggedAVLTree keeps two files next to each other:
+*
+*   <base>.snap  the last checkpoint, in the bst_snapshot.h format
+*   <base>.wal   every insert/remove since that checkpoint
+*
+* The log is a WalHeader followed by fixed-size records, each holding an
+* op byte, a checksum, the key and the value. Recovery loads the snapshot
+* and replays the log up to the first torn or corrupt record.
+*
+* Both headers carry a checkpoint generation. A checkpoint installs a
+* snapshot with the next generation and only then empties the log and
+* stamps it with that generation, so a crash between the two steps leaves
+* a log older than the snapshot. Recovery discards such a log instead of
+* replaying it: its records are already in the snapshot, and replaying
+* them over a snapshot taken after a bulk operation (clear(), say) would
+* bring back keys the operation removed.
+*/
+
+#define WAL_MAGIC "BSTWAL02"
+#define WAL_BUFFER_BYTES (64 * 1024)
+
+enum SyncPolicy
+{
+    SYNC_EVERY_WRITE,   // fdatasync after every operation
+    SYNC_GROUP,         // fdatasync once per groupSize operations
+    SYNC_NONE           // leave flushing to the OS
+};
+
+/**
+* Options for a LoggedAVLTree. checkpointEvery is the number of logged
+* operations after which a checkpoint is taken automatically (0 means
+* only on request).
+*/
+struct WalOptions
+{
+    WalOptions() : policy(SYNC_GROUP), groupSize(128), checkpointEvery(0) { }
+
+    SyncPolicy policy;
+    size_t groupSize;
+    size_t checkpointEvery;
+};
+
+struct WalHeader
+{
+    char magic[8];
+    uint32_t keySize;
+    uint32_t valueSize;
+    uint64_t generation;
+};
+
+enum WalOp
+{
+    WAL_INSERT = 1,
+    WAL_REMOVE = 2
+};
+
+/**
+* An append-only file of insert/remove records with group commit.
+*/
+template<typename Key, typename Value>
+class OperationLog
+{
+public:
+    OperationLog(const std::string& path, SyncPolicy policy, size_t groupSize, uint64_t generation);
+    ~OperationLog();
+
+    void append(WalOp op, const Key& key, const Value* value);
+    void commit();
+    void reset(uint64_t generation);
+    size_t pending() const;
+
+    template<typename Apply>
+    static void replay(const std::string& path, uint64_t generation, Apply apply);
+
+private:
+    OperationLog(const OperationLog<Key, Value>&);
+    OperationLog<Key, Value>& operator=(const OperationLog<Key, Value>&);
+
+    struct Record
+    {
+        uint8_t op;
+        uint8_t pad[3];
+        uint32_t checksum;
+        Key key;
+        Value value;
+    };
+
+    static uint32_t recordChecksum(const Record& rec);
+    void writeBuffer();
+
+    int fd_;
+    SyncPolicy policy_;
+    size_t groupSize_;
+    size_t pending_;
+    std::vector<char> buffer_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the OperationLog class.
+  -----------------------------------------------
+*/
+
+/**
+* Opens the log at path for appending, writing a header stamped with
+* generation if it is new. Throws std::runtime_error on failure.
+*/
+template<typename Key, typename Value>
+OperationLog<Key, Value>::OperationLog(const std::string& path, SyncPolicy policy, size_t groupSize, uint64_t generation) :
+    fd_(-1), policy_(policy), groupSize_(groupSize == 0 ? 1 : groupSize), pending_(0)
+{
+    static_assert(std::is_trivially_copyable<Key>::value, "logged keys must be trivially copyable");
+    static_assert(std::is_trivially_copyable<Value>::value, "logged values must be trivially copyable");
+
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if(fd_ < 0){
+        throw std::runtime_error("Cannot open log: " + path);
+    }
+    struct stat st;
+    if(::fstat(fd_, &st) != 0){
+        ::close(fd_);
+        throw std::runtime_error("Cannot stat log: " + path);
+    }
+    if(st.st_size == 0){
+        reset(generation);
+    }
+    buffer_.reserve(WAL_BUFFER_BYTES);
+}
+
+/**
+* Commits anything still buffered. Errors are swallowed here; call
+* commit() beforehand to see them.
+*/
+template<typename Key, typename Value>
+OperationLog<Key, Value>::~OperationLog()
+{
+    try {
+        commit();
+    } catch(...) {
+    }
+    ::close(fd_);
+}
+
+template<typename Key, typename Value>
+uint32_t OperationLog<Key, Value>::recordChecksum(const Record& rec)
+{
+    SnapshotChecksum checksum;
+    checksum.update(&rec.op, sizeof(rec.op));
+    checksum.update(&rec.key, sizeof(Key));
+    if(rec.op == WAL_INSERT){
+        checksum.update(&rec.value, sizeof(Value));
+    }
+    return static_cast<uint32_t>(checksum.value() ^ (checksum.value() >> 32));
+}
+
+/**
+* Adds an operation to the log. value is ignored for removes. Depending
+* on the sync policy the record is made durable now, with the rest of its
+* group, or whenever the OS gets to it.
+*/
+template<typename Key, typename Value>
+void OperationLog<Key, Value>::append(WalOp op, const Key& key, const Value* value)
+{
+    Record rec;
+    std::memset(static_cast<void*>(&rec), 0, sizeof(rec));
+    rec.op = op;
+    rec.key = key;
+    if(value != NULL){
+        rec.value = *value;
+    }
+    rec.checksum = recordChecksum(rec);
+
+    const char* bytes = reinterpret_cast<const char*>(&rec);
+    buffer_.insert(buffer_.end(), bytes, bytes + sizeof(rec));
+    pending_++;
+
+    if(policy_ == SYNC_EVERY_WRITE || (policy_ == SYNC_GROUP && pending_ >= groupSize_)){
+        commit();
+    } else if(buffer_.size() >= WAL_BUFFER_BYTES){
+        writeBuffer();
+    }
+}
+
+template<typename Key, typename Value>
+void OperationLog<Key, Value>::writeBuffer()
+{
+    size_t done = 0;
+    while(done < buffer_.size()){
+        ssize_t written = ::write(fd_, &buffer_[done], buffer_.size() - done);
+        if(written < 0){
+            throw std::runtime_error("Write to log failed");
+        }
+        done += written;
+    }
+    buffer_.clear();
+}
+
+/**
+* Writes out every buffered record and, unless the policy is SYNC_NONE,
+* waits for them to reach the disk with a single fdatasync.
+*/
+template<typename Key, typename Value>
+void OperationLog<Key, Value>::commit()
+{
+    writeBuffer();
+    if(policy_ != SYNC_NONE && pending_ > 0 && ::fdatasync(fd_) != 0){
+        throw std::runtime_error("fdatasync of log failed");
+    }
+    pending_ = 0;
+}
+
+/**
+* Drops every record, leaving just a header stamped with generation. Used
+* after a checkpoint.
+*/
+template<typename Key, typename Value>
+void OperationLog<Key, Value>::reset(uint64_t generation)
+{
+    buffer_.clear();
+    pending_ = 0;
+
+    WalHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, WAL_MAGIC, sizeof(header.magic));
+    header.keySize = sizeof(Key);
+    header.valueSize = sizeof(Value);
+    header.generation = generation;
+
+    if(::ftruncate(fd_, 0) != 0
+        || ::write(fd_, &header, sizeof(header)) != static_cast<ssize_t>(sizeof(header))
+        || ::fsync(fd_) != 0){
+        throw std::runtime_error("Cannot reset log");
+    }
+}
+
+/**
+* Returns the number of operations not yet committed.
+*/
+template<typename Key, typename Value>
+size_t OperationLog<Key, Value>::pending() const
+{
+    return pending_;
+}
+
+/**
+* Calls apply(op, key, value) for each intact record of the log at path,
+* then cuts off any torn or corrupt tail so new records follow the last
+* good one. A missing log replays nothing, and so does a log stamped with
+* an older generation than the snapshot being recovered; that log is
+* emptied. A log newer than the snapshot throws std::runtime_error.
+*/
+template<typename Key, typename Value>
+template<typename Apply>
+void OperationLog<Key, Value>::replay(const std::string& path, uint64_t generation, Apply apply)
+{
+    int fd = ::open(path.c_str(), O_RDWR);
+    if(fd < 0){
+        return;
+    }
+
+    WalHeader header;
+    ssize_t got = ::read(fd, &header, sizeof(header));
+    if(got != static_cast<ssize_t>(sizeof(header))){
+        // crashed while writing the header; start over
+        ::ftruncate(fd, 0);
+        ::close(fd);
+        return;
+    }
+    if(std::memcmp(header.magic, WAL_MAGIC, sizeof(header.magic)) != 0
+        || header.keySize != sizeof(Key) || header.valueSize != sizeof(Value)){
+        ::close(fd);
+        throw std::runtime_error("Not a log of this type: " + path);
+    }
+    if(header.generation > generation){
+        ::close(fd);
+        throw std::runtime_error("Log is newer than its snapshot: " + path);
+    }
+    if(header.generation < generation){
+        // crashed after installing a checkpoint but before emptying the log
+        ::ftruncate(fd, 0);
+        ::fsync(fd);
+        ::close(fd);
+        return;
+    }
+
+    off_t good = sizeof(header);
+    std::vector<char> chunk(WAL_BUFFER_BYTES / sizeof(Record) * sizeof(Record) + sizeof(Record));
+    size_t have = 0;
+    bool intact = true;
+    while(intact){
+        got = ::read(fd, &chunk[have], chunk.size() - have);
+        if(got <= 0){
+            break;
+        }
+        have += got;
+        size_t used = 0;
+        while(have - used >= sizeof(Record)){
+            Record rec;
+            std::memcpy(static_cast<void*>(&rec), &chunk[used], sizeof(Record));
+            if((rec.op != WAL_INSERT && rec.op != WAL_REMOVE) || rec.checksum != recordChecksum(rec)){
+                intact = false;
+                break;
+            }
+            apply(static_cast<WalOp>(rec.op), rec.key, rec.value);
+            used += sizeof(Record);
+            good += sizeof(Record);
+        }
+        std::memmove(&chunk[0], &chunk[used], have - used);
+        have -= used;
+    }
+
+    struct stat st;
+    if(::fstat(fd, &st) == 0 && st.st_size != good){
+        ::ftruncate(fd, good);
+        ::fsync(fd);
+    }
+    ::close(fd);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the OperationLog class.
+  -----------------------------------------------
+*/
+
+/**
+* An AVLTree whose inserts and removes are logged before being applied,
+* so the tree can be rebuilt after a crash. Operations that replace many
+* nodes at once (clear(), copyFrom(), assignSorted(), and the bulk paths
+* of erase_if(), erase_range() and apply_batch()) are not logged key by
+* key; they take a checkpoint instead, and are durable once they return.
+*
+* Values are changed only through insert(): operator[], front(), back()
+* and the iterators give read-only access, since a write through them
+* would never reach the log.
+*/
+template <class Key, class Value>
+class LoggedAVLTree : public AVLTree<Key, Value>
+{
+public:
+    LoggedAVLTree(const std::string& basePath, const WalOptions& options = WalOptions());
+    virtual ~LoggedAVLTree();
+
+    /**
+    * An iterator that reads items but cannot change their values. It
+    * converts to a BinarySearchTree iterator for extract().
+    */
+    class iterator : public BinarySearchTree<Key, Value>::iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key, Value> const & operator*() const;
+        std::pair<const Key, Value> const * operator->() const;
+
+        iterator& operator++();
+
+    protected:
+        friend class LoggedAVLTree<Key, Value>;
+        iterator(const typename BinarySearchTree<Key, Value>::iterator& it);
+    };
+
+    using BinarySearchTree<Key, Value>::insert;
+    virtual void insert(const std::pair<const Key, Value>& new_item);
+    iterator insert(NodeHandle<Key, Value>&& handle);
+    virtual void remove(const Key& key);
+    void sync();
+    void checkpoint();
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator erase(iterator first, iterator last);
+    Value const & operator[](const Key& key) const;
+    std::pair<const Key, Value> const & front() const;
+    std::pair<const Key, Value> const & back() const;
+
+protected:
+    void logged(WalOp op, const Key& key, const Value* value);
+    void maybeCheckpoint();
+    virtual void bulkChanged() override;
+    virtual Node<Key, Value>* linkNode(Node<Key, Value>* node) override;
+    virtual void unlinkNode(Node<Key, Value>* node) override;
+
+private:
+    LoggedAVLTree(const LoggedAVLTree<Key, Value>&);
+    LoggedAVLTree<Key, Value>& operator=(const LoggedAVLTree<Key, Value>&);
+
+    struct Replayer
+    {
+        LoggedAVLTree<Key, Value>* tree;
+        void operator()(WalOp op, const Key& key, const Value& value) const
+        {
+            if(op == WAL_INSERT){
+                tree->AVLTree<Key, Value>::insert(std::make_pair(key, value));
+            } else {
+                tree->AVLTree<Key, Value>::remove(key);
+            }
+        }
+    };
+
+    std::string snapPath_;
+    std::string logPath_;
+    WalOptions options_;
+    size_t sinceCheckpoint_;
+    uint64_t generation_;
+    OperationLog<Key, Value>* log_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the LoggedAVLTree class.
+  -----------------------------------------------
+*/
+
+template<class Key, class Value>
+LoggedAVLTree<Key, Value>::iterator::iterator() :
+    BinarySearchTree<Key, Value>::iterator()
+{
+
+}
+
+template<class Key, class Value>
+LoggedAVLTree<Key, Value>::iterator::iterator(const typename BinarySearchTree<Key, Value>::iterator& it) :
+    BinarySearchTree<Key, Value>::iterator(it)
+{
+
+}
+
+template<class Key, class Value>
+std::pair<const Key, Value> const &
+LoggedAVLTree<Key, Value>::iterator::operator*() const
+{
+    return BinarySearchTree<Key, Value>::iterator::operator*();
+}
+
+template<class Key, class Value>
+std::pair<const Key, Value> const *
+LoggedAVLTree<Key, Value>::iterator::operator->() const
+{
+    return BinarySearchTree<Key, Value>::iterator::operator->();
+}
+
+template<class Key, class Value>
+typename LoggedAVLTree<Key, Value>::iterator&
+LoggedAVLTree<Key, Value>::iterator::operator++()
+{
+    BinarySearchTree<Key, Value>::iterator::operator++();
+    return *this;
+}
+
+/**
+* Recovers the tree from basePath's checkpoint and log (if any) and
+* opens the log for new operations.
+*/
+template<class Key, class Value>
+LoggedAVLTree<Key, Value>::LoggedAVLTree(const std::string& basePath, const WalOptions& options) :
+    AVLTree<Key, Value>(),
+    snapPath_(basePath + ".snap"),
+    logPath_(basePath + ".wal"),
+    options_(options),
+    sinceCheckpoint_(0),
+    generation_(0),
+    log_(NULL)
+{
+    if(::access(snapPath_.c_str(), F_OK) == 0){
+        MappedSnapshot<Key, Value> snap(snapPath_);
+        snap.loadInto(*this);
+        generation_ = snap.generation();
+    }
+    Replayer replayer;
+    replayer.tree = this;
+    OperationLog<Key, Value>::replay(logPath_, generation_, replayer);
+    log_ = new OperationLog<Key, Value>(logPath_, options_.policy, options_.groupSize, generation_);
+}
+
+template<class Key, class Value>
+LoggedAVLTree<Key, Value>::~LoggedAVLTree()
+{
+    delete log_;
+}
+
+template<class Key, class Value>
+void LoggedAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& new_item)
+{
+    logged(WAL_INSERT, new_item.first, &new_item.second);
+    AVLTree<Key, Value>::insert(new_item);
+    maybeCheckpoint();
+}
+
+template<class Key, class Value>
+void LoggedAVLTree<Key, Value>::remove(const Key& key)
+{
+    logged(WAL_REMOVE, key, NULL);
+    AVLTree<Key, Value>::remove(key);
+    maybeCheckpoint();
+}
+
+template<class Key, class Value>
+typename LoggedAVLTree<Key, Value>::iterator
+LoggedAVLTree<Key, Value>::insert(NodeHandle<Key, Value>&& handle)
+{
+    return iterator(BinarySearchTree<Key, Value>::insert(std::move(handle)));
+}
+
+template<class Key, class Value>
+typename LoggedAVLTree<Key, Value>::iterator LoggedAVLTree<Key, Value>::begin() const
+{
+    return iterator(BinarySearchTree<Key, Value>::begin());
+}
+
+template<class Key, class Value>
+typename LoggedAVLTree<Key, Value>::iterator LoggedAVLTree<Key, Value>::end() const
+{
+    return iterator(BinarySearchTree<Key, Value>::end());
+}
+
+template<class Key, class Value>
+typename LoggedAVLTree<Key, Value>::iterator LoggedAVLTree<Key, Value>::find(const Key& key) const
+{
+    return iterator(BinarySearchTree<Key, Value>::find(key));
+}
+
+template<class Key, class Value>
+typename LoggedAVLTree<Key, Value>::iterator LoggedAVLTree<Key, Value>::lower_bound(const Key& key) const
+{
+    return iterator(BinarySearchTree<Key, Value>::lower_bound(key));
+}
+
+template<class Key, class Value>
+typename LoggedAVLTree<Key, Value>::iterator
+LoggedAVLTree<Key, Value>::erase(iterator first, iterator last)
+{
+    return iterator(BinarySearchTree<Key, Value>::erase(first, last));
+}
+
+/**
+* @precondition The key exists in the tree
+* Returns the value associated with the key
+*/
+template<class Key, class Value>
+Value const & LoggedAVLTree<Key, Value>::operator[](const Key& key) const
+{
+    return BinarySearchTree<Key, Value>::operator[](key);
+}
+
+template<class Key, class Value>
+std::pair<const Key, Value> const & LoggedAVLTree<Key, Value>::front() const
+{
+    return BinarySearchTree<Key, Value>::front();
+}
+
+template<class Key, class Value>
+std::pair<const Key, Value> const & LoggedAVLTree<Key, Value>::back() const
+{
+    return BinarySearchTree<Key, Value>::back();
+}
+
+/**
+* Nodes moved in or out through node handles are logged as the insert or
+* remove they amount to.
+*/
+template<class Key, class Value>
+Node<Key, Value>* LoggedAVLTree<Key, Value>::linkNode(Node<Key, Value>* node)
+{
+    Node<Key, Value>* existing = this->internalFind(node->getKey());
+    if(existing != NULL){
+        return existing;
+    }
+    logged(WAL_INSERT, node->getKey(), &node->getValue());
+    AVLTree<Key, Value>::linkNode(node);
+    maybeCheckpoint();
+    return node;
+}
+
+template<class Key, class Value>
+void LoggedAVLTree<Key, Value>::unlinkNode(Node<Key, Value>* node)
+{
+    logged(WAL_REMOVE, node->getKey(), NULL);
+    AVLTree<Key, Value>::unlinkNode(node);
+    maybeCheckpoint();
+}
+
+/**
+* A bulk operation changed the tree without passing through the log, so
+* the whole tree is checkpointed. The snapshot loaded while recovering
+* arrives here too, before the log is open, and needs no checkpoint.
+*/
+template<class Key, class Value>
+void LoggedAVLTree<Key, Value>::bulkChanged()
+{
+    AVLTree<Key, Value>::bulkChanged();
+    if(log_ != NULL){
+        checkpoint();
+    }
+}
+
+/**
+* Makes every operation so far durable, regardless of the sync policy.
+*/
+template<class Key, class Value>
+void LoggedAVLTree<Key, Value>::sync()
+{
+    log_->commit();
+    if(options_.policy == SYNC_NONE){
+        snapshotSyncPath(logPath_, false);
+    }
+}
+
+/**
+* Writes the whole tree to a new snapshot of the next generation, which
+* saveSnapshot() installs atomically over the old one, then empties the
+* log and moves it to that generation.
+*/
+template<class Key, class Value>
+void LoggedAVLTree<Key, Value>::checkpoint()
+{
+    sync();
+    saveSnapshot(*this, snapPath_, generation_ + 1);
+    generation_++;
+    log_->reset(generation_);
+    sinceCheckpoint_ = 0;
+}
+
+template<class Key, class Value>
+void LoggedAVLTree<Key, Value>::logged(WalOp op, const Key& key, const Value* value)
+{
+    log_->append(op, key, value);
+    sinceCheckpoint_++;
+}
+
+/**
+* Takes an automatic checkpoint once enough operations have been logged.
+* Called after the operation is applied so the snapshot includes it.
+*/
+template<class Key, class Value>
+void LoggedAVLTree<Key, Value>::maybeCheckpoint()
+{
+    if(options_.checkpointEvery != 0 && sinceCheckpoint_ >= options_.checkpointEvery){
+        checkpoint();
+    }
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the LoggedAVLTree class.
+  -----------------------------------------------
+*/
+
+#endif
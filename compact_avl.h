@@ -0,0 +1,371 @@
+#ifndef COMPACT_AVL_H
+#define COMPACT_AVL_H
+
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "index_avl.h"
+
+/**
+* A memory-compact AVL tree with the BinarySearchTree interface.
+*
+* Nodes live in a pool of fixed-size chunks and are named by 32-bit ids
+* instead of pointers. A node holds its item and three 32-bit links; the
+* low 30 bits of the parent link are the parent's id and the top 2 bits
+* hold balance + 1, so there is no separate balance field, no vptr and no
+* per-node heap allocation. For int keys and values a node is 20 bytes,
+* against 48 bytes (plus allocator overhead) for an AVLNode.
+*
+* Ids are 1-based so that 0 can play the role of NULL, which limits a
+* tree to 2^30 - 1 nodes. The pool, links and search come from
+* PooledAVLTree; this class lays out the nodes in a ChunkedArray.
+*/
+
+#define COMPACT_CHUNK_SHIFT 12
+
+/**
+* Uninitialized storage for an array of T that grows a chunk of
+* 2^COMPACT_CHUNK_SHIFT elements at a time, so elements never move and
+* growing never copies. Constructing and destroying elements is up to the
+* owner.
+*/
+template <typename T>
+class ChunkedArray
+{
+public:
+    ChunkedArray();
+    ~ChunkedArray();
+
+    T& operator[](size_t index) const;
+    void grow(size_t count);
+    void release();
+    size_t memoryUsage() const;
+
+    static const size_t CHUNK_SIZE = size_t(1) << COMPACT_CHUNK_SHIFT;
+
+private:
+    ChunkedArray(const ChunkedArray<T>&);
+    ChunkedArray<T>& operator=(const ChunkedArray<T>&);
+
+    std::vector<T*> chunks_;
+};
+
+template<typename T>
+ChunkedArray<T>::ChunkedArray()
+{
+
+}
+
+template<typename T>
+ChunkedArray<T>::~ChunkedArray()
+{
+    release();
+}
+
+template<typename T>
+T& ChunkedArray<T>::operator[](size_t index) const
+{
+    return chunks_[index >> COMPACT_CHUNK_SHIFT][index & (CHUNK_SIZE - 1)];
+}
+
+/**
+* Makes sure indices [0, count) have storage.
+*/
+template<typename T>
+void ChunkedArray<T>::grow(size_t count)
+{
+    while(chunks_.size() * CHUNK_SIZE < count){
+        chunks_.push_back(static_cast<T*>(::operator new(CHUNK_SIZE * sizeof(T))));
+    }
+}
+
+/**
+* Frees every chunk. Any live elements must already be destroyed.
+*/
+template<typename T>
+void ChunkedArray<T>::release()
+{
+    for(size_t i = 0; i < chunks_.size(); ++i){
+        ::operator delete(chunks_[i]);
+    }
+    chunks_.clear();
+}
+
+template<typename T>
+size_t ChunkedArray<T>::memoryUsage() const
+{
+    return chunks_.size() * CHUNK_SIZE * sizeof(T) + chunks_.capacity() * sizeof(T*);
+}
+
+template <typename Key, typename Value>
+class CompactAVLTree : public PooledAVLTree<CompactAVLTree<Key, Value>, Key>
+{
+public:
+    typedef uint32_t NodeId;
+
+    CompactAVLTree();
+    ~CompactAVLTree();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    size_t memoryUsage() const;
+
+    /**
+    * An internal iterator class for traversing the contents of the tree.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class CompactAVLTree<Key, Value>;
+        iterator(CompactAVLTree<Key, Value>* tree, NodeId id);
+        CompactAVLTree<Key, Value>* tree_;
+        NodeId current_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    struct CompactNode
+    {
+        std::pair<const Key, Value> item;
+        PackedLinks links;
+    };
+
+    static const bool TRIVIAL_ITEMS = std::is_trivially_destructible<std::pair<const Key, Value> >::value;
+
+    CompactNode& node(NodeId id) const;
+    PackedLinks& links(NodeId id) const;
+    const Key& key(NodeId id) const;
+    void growPool(size_t count);
+    void releasePool();
+    void destroyItem(NodeId id);
+
+private:
+    friend class PooledAVLTree<CompactAVLTree<Key, Value>, Key>;
+
+    CompactAVLTree(const CompactAVLTree<Key, Value>&);
+    CompactAVLTree<Key, Value>& operator=(const CompactAVLTree<Key, Value>&);
+
+    ChunkedArray<CompactNode> nodes_;
+};
+
+/*
+--------------------------------------------------------------
+Begin implementations for the CompactAVLTree::iterator class.
+---------------------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+CompactAVLTree<Key, Value>::iterator::iterator() :
+    tree_(NULL), current_(0)
+{
+
+}
+
+template<typename Key, typename Value>
+CompactAVLTree<Key, Value>::iterator::iterator(CompactAVLTree<Key, Value>* tree, NodeId id) :
+    tree_(tree), current_(id)
+{
+
+}
+
+template<typename Key, typename Value>
+std::pair<const Key,Value>& CompactAVLTree<Key, Value>::iterator::operator*() const
+{
+    return tree_->node(current_).item;
+}
+
+template<typename Key, typename Value>
+std::pair<const Key,Value>* CompactAVLTree<Key, Value>::iterator::operator->() const
+{
+    return &(tree_->node(current_).item);
+}
+
+template<typename Key, typename Value>
+bool CompactAVLTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return current_ == rhs.current_;
+}
+
+template<typename Key, typename Value>
+bool CompactAVLTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return current_ != rhs.current_;
+}
+
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::iterator&
+CompactAVLTree<Key, Value>::iterator::operator++()
+{
+    if(current_ != 0){
+        current_ = tree_->successor(current_);
+    }
+    return *this;
+}
+
+/*
+-------------------------------------------------------------
+End implementations for the CompactAVLTree::iterator class.
+-------------------------------------------------------------
+*/
+
+/*
+-----------------------------------------------------
+Begin implementations for the CompactAVLTree class.
+-----------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+CompactAVLTree<Key, Value>::CompactAVLTree()
+{
+
+}
+
+template<typename Key, typename Value>
+CompactAVLTree<Key, Value>::~CompactAVLTree()
+{
+    this->clear();
+}
+
+/**
+* Returns the bytes held by the tree: its node chunks, the chunk table
+* and the tree object itself.
+*/
+template<typename Key, typename Value>
+size_t CompactAVLTree<Key, Value>::memoryUsage() const
+{
+    return nodes_.memoryUsage() + sizeof(*this);
+}
+
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::iterator
+CompactAVLTree<Key, Value>::begin() const
+{
+    CompactAVLTree<Key, Value>* self = const_cast<CompactAVLTree<Key, Value>*>(this);
+    return iterator(self, self->getSmallestNode());
+}
+
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::iterator
+CompactAVLTree<Key, Value>::end() const
+{
+    return iterator(const_cast<CompactAVLTree<Key, Value>*>(this), 0);
+}
+
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::iterator
+CompactAVLTree<Key, Value>::find(const Key& key) const
+{
+    return iterator(const_cast<CompactAVLTree<Key, Value>*>(this), this->internalFind(key));
+}
+
+/**
+* @precondition The key exists in the map
+* Returns the value associated with the key
+*/
+template<typename Key, typename Value>
+Value& CompactAVLTree<Key, Value>::operator[](const Key& key)
+{
+    NodeId id = this->internalFind(key);
+    if(id == 0) throw std::out_of_range("Invalid key");
+    return node(id).item.second;
+}
+
+template<typename Key, typename Value>
+Value const & CompactAVLTree<Key, Value>::operator[](const Key& key) const
+{
+    NodeId id = this->internalFind(key);
+    if(id == 0) throw std::out_of_range("Invalid key");
+    return node(id).item.second;
+}
+
+/**
+* Inserts an item, overwriting the value if the key already exists.
+*/
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    NodeId parent;
+    bool goLeft;
+    NodeId id = this->findInsertPoint(keyValuePair.first, parent, goLeft);
+    if(id != 0){
+        node(id).item.second = keyValuePair.second;
+        return;
+    }
+
+    id = this->nextFreeSlot();
+    new (&node(id).item) std::pair<const Key, Value>(keyValuePair);
+    this->linkSlot(id, parent, goLeft);
+}
+
+/**
+* Removes the item with the given key if it exists.
+*/
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::remove(const Key& key)
+{
+    this->removeKey(key);
+}
+
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::CompactNode&
+CompactAVLTree<Key, Value>::node(NodeId id) const
+{
+    return nodes_[id - 1];
+}
+
+template<typename Key, typename Value>
+PackedLinks& CompactAVLTree<Key, Value>::links(NodeId id) const
+{
+    return nodes_[id - 1].links;
+}
+
+template<typename Key, typename Value>
+const Key& CompactAVLTree<Key, Value>::key(NodeId id) const
+{
+    return nodes_[id - 1].item.first;
+}
+
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::growPool(size_t count)
+{
+    nodes_.grow(count);
+}
+
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::releasePool()
+{
+    nodes_.release();
+}
+
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::destroyItem(NodeId id)
+{
+    node(id).item.~pair();
+}
+
+/*
+---------------------------------------------------
+End implementations for the CompactAVLTree class.
+---------------------------------------------------
+*/
+
+#endif
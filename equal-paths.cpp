@@ -8,60 +8,65 @@ using namespace std;
 
 
 // You may add any prototypes of helper functions here
-int treeHeight (Node* node);
+void noteLeaf(int depth, int& leafDepth, bool& equal);
 
-int treeHeight (Node* node){
-  if(node == nullptr || (node->left == nullptr && node->right == nullptr)){
-    return 0;
+void noteLeaf(int depth, int& leafDepth, bool& equal){
+  if(leafDepth < 0){
+    leafDepth = depth;
+  } else if(depth != leafDepth){
+    equal = false;
   }
-
-
-  int leftHeight = 0;
-  int rightHeight = 0;
-
-  if(node->left != nullptr){
-    leftHeight = treeHeight(node->left);
-  }
-
-  if(node->right != nullptr){
-    rightHeight = treeHeight(node->right);
-  }
-
-  if(leftHeight > rightHeight){
-    return leftHeight + 1;
-  } else {
-    return rightHeight + 1;
-  }
-
 }
 
+/**
+ * Morris in-order walk: instead of a stack, each node's in-order
+ * predecessor temporarily points back to it through its empty right
+ * link. The walk takes constant space at any depth and removes every
+ * thread again before returning, so it always runs to the end.
+ *
+ * A leaf is a node with no left child whose right link is empty or is a
+ * thread. Depth drops by the length of the predecessor path whenever a
+ * thread is followed back up.
+ */
 bool equalPaths(Node * root)
-{ 
-  // Add your code below
-  if(root == nullptr){
-    return true;
-  }
-
-  if(root->left == nullptr && root->right == nullptr){
-      return true;
-  }
-  
-  if (root->left != nullptr && root->right != nullptr){
-    int leftHeight = treeHeight(root->left);
-    int rightHeight = treeHeight(root->right);
-    
-    if(leftHeight != rightHeight){
-      return false;
+{
+  int leafDepth = -1;
+  bool equal = true;
+  int depth = 0;
+  Node* curr = root;
+
+  while(curr != nullptr){
+    if(curr->left == nullptr){
+      if(curr->right == nullptr){
+        noteLeaf(depth, leafDepth, equal);
+      }
+      curr = curr->right;
+      depth++;
+      continue;
     }
 
-    return equalPaths(root->left) && equalPaths(root->right);
-  }
+    Node* pred = curr->left;
+    int steps = 1;
+    while(pred->right != nullptr && pred->right != curr){
+      pred = pred->right;
+      steps++;
+    }
 
-  if(root->left){
-    return equalPaths(root->left);
+    if(pred->right == nullptr){
+      // first visit: thread the predecessor back here and go left
+      pred->right = curr;
+      curr = curr->left;
+      depth++;
+    } else {
+      // back through the thread, which counted one step below pred
+      pred->right = nullptr;
+      depth -= steps + 1;
+      if(pred->left == nullptr){
+        noteLeaf(depth + steps, leafDepth, equal);
+      }
+      curr = curr->right;
+      depth++;
+    }
   }
-
-  return equalPaths(root->right);
-
+  return equal;
 }
-
@@ -0,0 +1,393 @@
+#ifndef HASHED_AVL_H
+#define HASHED_AVL_H
+
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* An AVLTree with an open-addressing hash index from keys to nodes, so
+* find() and operator[] take one probe on average while begin() and the
+* iterators still walk the keys in order.
+*
+* The index uses linear probing with backward-shift deletion and keeps
+* each key's hash next to its node pointer, so most mismatched slots are
+* skipped without touching the node. It stores node pointers rather than
+* positions: rotations and nodeSwap() relink nodes but never move a key to
+* another node, so entries stay valid until their node is removed, or
+* replaced by compaction, which repoints them.
+*
+* The index follows every change to the tree: insert(), remove() and node
+* handles add or drop one slot, and clear(), copyFrom(), assignSorted()
+* and the bulk erase and batch paths rebuild the table through
+* bulkChanged().
+*
+* find() and operator[] are not virtual in BinarySearchTree, so the
+* versions here hide the base ones rather than override them. Called
+* through a BinarySearchTree or AVLTree reference they still give the
+* right answer, but by walking the tree instead of probing the index.
+*/
+template <typename Key, typename Value, typename Hash = std::hash<Key> >
+class HashedAVLTree : public AVLTree<Key, Value>
+{
+public:
+    typedef typename BinarySearchTree<Key, Value>::iterator iterator;
+
+    HashedAVLTree();
+    HashedAVLTree(const HashedAVLTree<Key, Value, Hash>& other);
+    HashedAVLTree(HashedAVLTree<Key, Value, Hash>&& other);
+    HashedAVLTree<Key, Value, Hash>& operator=(const HashedAVLTree<Key, Value, Hash>& other);
+    HashedAVLTree<Key, Value, Hash>& operator=(HashedAVLTree<Key, Value, Hash>&& other);
+
+    using BinarySearchTree<Key, Value>::insert;
+    virtual void insert(const std::pair<const Key, Value>& new_item) override;
+    virtual void remove(const Key& key) override;
+
+    iterator find(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+    size_t indexMemoryUsage() const;
+
+protected:
+    struct Slot
+    {
+        uint64_t hash;
+        Node<Key, Value>* node;     // NULL for an empty slot
+    };
+
+    uint64_t hashOf(const Key& key) const;
+    size_t home(uint64_t hash) const;
+    Node<Key, Value>* lookup(const Key& key) const;
+    void reserveIndex(size_t count);
+    void indexInsert(Node<Key, Value>* node);
+    void indexErase(const Key& key);
+    void rebuildIndex();
+    virtual void bulkChanged() override;
+    virtual Node<Key, Value>* linkNode(Node<Key, Value>* node) override;
+    virtual void unlinkNode(Node<Key, Value>* node) override;
+    virtual void nodeRelocated(Node<Key, Value>* from, Node<Key, Value>* to) override;
+
+    // Slot tables never fill beyond MAX_LOAD_NUM / MAX_LOAD_DEN
+    static const size_t MAX_LOAD_NUM = 3;
+    static const size_t MAX_LOAD_DEN = 4;
+
+private:
+    std::vector<Slot> slots_;
+    size_t indexCount_;
+    int indexBits_;
+    Hash hasher_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the HashedAVLTree class.
+  -----------------------------------------------
+*/
+
+template<class Key, class Value, class Hash>
+HashedAVLTree<Key, Value, Hash>::HashedAVLTree() :
+    AVLTree<Key, Value>(), indexCount_(0), indexBits_(0)
+{
+
+}
+
+template<class Key, class Value, class Hash>
+HashedAVLTree<Key, Value, Hash>::HashedAVLTree(const HashedAVLTree<Key, Value, Hash>& other) :
+    AVLTree<Key, Value>(other), indexCount_(0), indexBits_(0), hasher_(other.hasher_)
+{
+    rebuildIndex();
+}
+
+template<class Key, class Value, class Hash>
+HashedAVLTree<Key, Value, Hash>::HashedAVLTree(HashedAVLTree<Key, Value, Hash>&& other) :
+    AVLTree<Key, Value>(std::move(other)),
+    slots_(std::move(other.slots_)),
+    indexCount_(other.indexCount_),
+    indexBits_(other.indexBits_),
+    hasher_(other.hasher_)
+{
+    other.slots_.clear();
+    other.indexCount_ = 0;
+    other.indexBits_ = 0;
+}
+
+template<class Key, class Value, class Hash>
+HashedAVLTree<Key, Value, Hash>&
+HashedAVLTree<Key, Value, Hash>::operator=(const HashedAVLTree<Key, Value, Hash>& other)
+{
+    if(this != &other){
+        // the copy rebuilds the index through bulkChanged(), so the hasher
+        // is taken first; a failed copy leaves the tree and hasher as they were
+        Hash previous = hasher_;
+        hasher_ = other.hasher_;
+        try {
+            AVLTree<Key, Value>::operator=(other);
+        } catch(...) {
+            hasher_ = previous;
+            throw;
+        }
+    }
+    return *this;
+}
+
+template<class Key, class Value, class Hash>
+HashedAVLTree<Key, Value, Hash>&
+HashedAVLTree<Key, Value, Hash>::operator=(HashedAVLTree<Key, Value, Hash>&& other)
+{
+    if(this != &other){
+        AVLTree<Key, Value>::operator=(std::move(other));
+        slots_ = std::move(other.slots_);
+        indexCount_ = other.indexCount_;
+        indexBits_ = other.indexBits_;
+        hasher_ = other.hasher_;
+        other.slots_.clear();
+        other.indexCount_ = 0;
+        other.indexBits_ = 0;
+    }
+    return *this;
+}
+
+/**
+* Existing keys are updated through the index without walking the tree.
+* A new key gets its node from createNode() and is linked in by
+* AVLTree::linkNode(), so the tree is walked once and the node is in hand
+* for indexing. The slot table is grown first so that indexing the new
+* node cannot fail.
+*/
+template<class Key, class Value, class Hash>
+void HashedAVLTree<Key, Value, Hash>::insert(const std::pair<const Key, Value>& new_item)
+{
+    Node<Key, Value>* node = lookup(new_item.first);
+    if(node != NULL){
+        node->setValue(new_item.second);
+        return;
+    }
+    reserveIndex(indexCount_ + 1);
+    node = this->createNode(new_item.first, new_item.second, NULL);
+    AVLTree<Key, Value>::linkNode(node);
+    indexInsert(node);
+}
+
+template<class Key, class Value, class Hash>
+void HashedAVLTree<Key, Value, Hash>::remove(const Key& key)
+{
+    if(lookup(key) == NULL){
+        return;
+    }
+    indexErase(key);
+    AVLTree<Key, Value>::remove(key);
+}
+
+/**
+* Node handles keep the index in sync the same way insert() and remove()
+* do. The index is grown before the tree changes.
+*/
+template<class Key, class Value, class Hash>
+Node<Key, Value>* HashedAVLTree<Key, Value, Hash>::linkNode(Node<Key, Value>* node)
+{
+    Node<Key, Value>* existing = lookup(node->getKey());
+    if(existing != NULL){
+        return existing;
+    }
+    reserveIndex(indexCount_ + 1);
+    AVLTree<Key, Value>::linkNode(node);
+    indexInsert(node);
+    return node;
+}
+
+template<class Key, class Value, class Hash>
+void HashedAVLTree<Key, Value, Hash>::unlinkNode(Node<Key, Value>* node)
+{
+    indexErase(node->getKey());
+    AVLTree<Key, Value>::unlinkNode(node);
+}
+
+/**
+* Repoints from's slot at to. The probe run is matched on the pointer, so
+* no key is compared.
+*/
+template<class Key, class Value, class Hash>
+void HashedAVLTree<Key, Value, Hash>::nodeRelocated(Node<Key, Value>* from, Node<Key, Value>* to)
+{
+    size_t mask = slots_.size() - 1;
+    size_t i = home(hashOf(to->getKey()));
+    while(slots_[i].node != from){
+        i = (i + 1) & mask;
+    }
+    slots_[i].node = to;
+}
+
+template<class Key, class Value, class Hash>
+typename HashedAVLTree<Key, Value, Hash>::iterator
+HashedAVLTree<Key, Value, Hash>::find(const Key& key) const
+{
+    return this->makeIterator(lookup(key));
+}
+
+/**
+* @precondition The key exists in the map
+* Returns the value associated with the key
+*/
+template<class Key, class Value, class Hash>
+Value& HashedAVLTree<Key, Value, Hash>::operator[](const Key& key)
+{
+    Node<Key, Value>* node = lookup(key);
+    if(node == NULL) throw std::out_of_range("Invalid key");
+    return node->getValue();
+}
+
+template<class Key, class Value, class Hash>
+Value const & HashedAVLTree<Key, Value, Hash>::operator[](const Key& key) const
+{
+    Node<Key, Value>* node = lookup(key);
+    if(node == NULL) throw std::out_of_range("Invalid key");
+    return node->getValue();
+}
+
+/**
+* Bytes held by the slot table, on top of the tree's own nodes.
+*/
+template<class Key, class Value, class Hash>
+size_t HashedAVLTree<Key, Value, Hash>::indexMemoryUsage() const
+{
+    return slots_.capacity() * sizeof(Slot);
+}
+
+template<class Key, class Value, class Hash>
+uint64_t HashedAVLTree<Key, Value, Hash>::hashOf(const Key& key) const
+{
+    return mixKeyHash(hasher_(key));
+}
+
+template<class Key, class Value, class Hash>
+size_t HashedAVLTree<Key, Value, Hash>::home(uint64_t hash) const
+{
+    return static_cast<size_t>(hash >> (64 - indexBits_));
+}
+
+template<class Key, class Value, class Hash>
+Node<Key, Value>* HashedAVLTree<Key, Value, Hash>::lookup(const Key& key) const
+{
+    if(indexCount_ == 0){
+        return NULL;
+    }
+    uint64_t hash = hashOf(key);
+    size_t mask = slots_.size() - 1;
+    for(size_t i = home(hash); ; i = (i + 1) & mask){
+        const Slot& slot = slots_[i];
+        if(slot.node == NULL){
+            return NULL;
+        }
+        if(slot.hash == hash && slot.node->getKey() == key){
+            return slot.node;
+        }
+    }
+}
+
+/**
+* Makes room for count entries, doubling the table and reinserting every
+* entry when the load limit would be passed.
+*/
+template<class Key, class Value, class Hash>
+void HashedAVLTree<Key, Value, Hash>::reserveIndex(size_t count)
+{
+    if(count * MAX_LOAD_DEN <= slots_.size() * MAX_LOAD_NUM){
+        return;
+    }
+    int bits = indexBits_ > 0 ? indexBits_ : 4;    // at least 16 slots
+    while(count * MAX_LOAD_DEN > (size_t(1) << bits) * MAX_LOAD_NUM){
+        bits++;
+    }
+
+    Slot empty = { 0, NULL };
+    std::vector<Slot> old(size_t(1) << bits, empty);
+    old.swap(slots_);
+    indexBits_ = bits;
+    indexCount_ = 0;
+    for(size_t i = 0; i < old.size(); ++i){
+        if(old[i].node != NULL){
+            indexInsert(old[i].node);
+        }
+    }
+}
+
+/**
+* Adds a node whose key is not yet indexed. The caller has reserved room.
+*/
+template<class Key, class Value, class Hash>
+void HashedAVLTree<Key, Value, Hash>::indexInsert(Node<Key, Value>* node)
+{
+    uint64_t hash = hashOf(node->getKey());
+    size_t mask = slots_.size() - 1;
+    size_t i = home(hash);
+    while(slots_[i].node != NULL){
+        i = (i + 1) & mask;
+    }
+    slots_[i].hash = hash;
+    slots_[i].node = node;
+    indexCount_++;
+}
+
+/**
+* Removes key's slot, then shifts later entries of the probe run back so
+* that lookups never need tombstones.
+*/
+template<class Key, class Value, class Hash>
+void HashedAVLTree<Key, Value, Hash>::indexErase(const Key& key)
+{
+    uint64_t hash = hashOf(key);
+    size_t mask = slots_.size() - 1;
+    size_t hole = home(hash);
+    while(!(slots_[hole].hash == hash && slots_[hole].node->getKey() == key)){
+        hole = (hole + 1) & mask;
+    }
+
+    size_t next = (hole + 1) & mask;
+    while(slots_[next].node != NULL){
+        // an entry may fill the hole if its home is not in (hole, next]
+        size_t want = home(slots_[next].hash);
+        if(((next - want) & mask) >= ((next - hole) & mask)){
+            slots_[hole] = slots_[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    slots_[hole].node = NULL;
+    indexCount_--;
+}
+
+/**
+* Re-indexes every node after the tree was replaced wholesale.
+*/
+template<class Key, class Value, class Hash>
+void HashedAVLTree<Key, Value, Hash>::rebuildIndex()
+{
+    slots_.clear();
+    indexCount_ = 0;
+    indexBits_ = 0;
+
+    std::vector<Node<Key, Value>*> nodes;
+    this->collectInOrder(this->root_, nodes);
+    reserveIndex(nodes.size());
+    for(size_t i = 0; i < nodes.size(); ++i){
+        indexInsert(nodes[i]);
+    }
+}
+
+template<class Key, class Value, class Hash>
+void HashedAVLTree<Key, Value, Hash>::bulkChanged()
+{
+    AVLTree<Key, Value>::bulkChanged();
+    rebuildIndex();
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the HashedAVLTree class.
+  -----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,325 @@
+#ifndef HOTCOLD_AVL_H
+#define HOTCOLD_AVL_H
+
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "index_avl.h"
+#include "compact_avl.h"
+
+/**
+* An AVL tree that splits each node into a hot part and a cold part.
+*
+* The hot part holds only what a search touches: the key, 32-bit child
+* and parent links and the balance (the PackedLinks of PooledAVLTree). Hot
+* parts are packed densely in their own array, so a lookup walks cache
+* lines full of keys and links no matter how large the values are. Values
+* live in a separate cold array at the same index and are only touched
+* once the search has found its key.
+*
+* Since the key and value are no longer stored together, iterators yield
+* a pair of references rather than a reference to a pair.
+*/
+template <typename Key, typename Value>
+class HotColdAVLTree : public PooledAVLTree<HotColdAVLTree<Key, Value>, Key>
+{
+public:
+    typedef uint32_t NodeId;
+    typedef std::pair<const Key&, Value&> reference;
+
+    HotColdAVLTree();
+    ~HotColdAVLTree();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    size_t memoryUsage() const;
+
+    /**
+    * An internal iterator class for traversing the contents of the tree.
+    */
+    class iterator
+    {
+    public:
+        class ArrowProxy
+        {
+        public:
+            const reference* operator->() const { return &item_; }
+        private:
+            friend class iterator;
+            ArrowProxy(const reference& item) : item_(item) { }
+            reference item_;
+        };
+
+        iterator();
+
+        reference operator*() const;
+        ArrowProxy operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class HotColdAVLTree<Key, Value>;
+        iterator(HotColdAVLTree<Key, Value>* tree, NodeId id);
+        HotColdAVLTree<Key, Value>* tree_;
+        NodeId current_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    struct HotNode
+    {
+        Key key;
+        PackedLinks links;
+    };
+
+    static const bool TRIVIAL_ITEMS = std::is_trivially_destructible<Key>::value &&
+        std::is_trivially_destructible<Value>::value;
+
+    HotNode& hot(NodeId id) const;
+    Value& cold(NodeId id) const;
+    PackedLinks& links(NodeId id) const;
+    const Key& key(NodeId id) const;
+    void growPool(size_t count);
+    void releasePool();
+    void destroyItem(NodeId id);
+
+private:
+    friend class PooledAVLTree<HotColdAVLTree<Key, Value>, Key>;
+
+    HotColdAVLTree(const HotColdAVLTree<Key, Value>&);
+    HotColdAVLTree<Key, Value>& operator=(const HotColdAVLTree<Key, Value>&);
+
+    ChunkedArray<HotNode> hot_;
+    ChunkedArray<Value> cold_;
+};
+
+/*
+--------------------------------------------------------------
+Begin implementations for the HotColdAVLTree::iterator class.
+---------------------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+HotColdAVLTree<Key, Value>::iterator::iterator() :
+    tree_(NULL), current_(0)
+{
+
+}
+
+template<typename Key, typename Value>
+HotColdAVLTree<Key, Value>::iterator::iterator(HotColdAVLTree<Key, Value>* tree, NodeId id) :
+    tree_(tree), current_(id)
+{
+
+}
+
+template<typename Key, typename Value>
+typename HotColdAVLTree<Key, Value>::reference
+HotColdAVLTree<Key, Value>::iterator::operator*() const
+{
+    return reference(tree_->hot(current_).key, tree_->cold(current_));
+}
+
+template<typename Key, typename Value>
+typename HotColdAVLTree<Key, Value>::iterator::ArrowProxy
+HotColdAVLTree<Key, Value>::iterator::operator->() const
+{
+    return ArrowProxy(**this);
+}
+
+template<typename Key, typename Value>
+bool HotColdAVLTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return current_ == rhs.current_;
+}
+
+template<typename Key, typename Value>
+bool HotColdAVLTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return current_ != rhs.current_;
+}
+
+template<typename Key, typename Value>
+typename HotColdAVLTree<Key, Value>::iterator&
+HotColdAVLTree<Key, Value>::iterator::operator++()
+{
+    if(current_ != 0){
+        current_ = tree_->successor(current_);
+    }
+    return *this;
+}
+
+/*
+-------------------------------------------------------------
+End implementations for the HotColdAVLTree::iterator class.
+-------------------------------------------------------------
+*/
+
+/*
+-----------------------------------------------------
+Begin implementations for the HotColdAVLTree class.
+-----------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+HotColdAVLTree<Key, Value>::HotColdAVLTree()
+{
+
+}
+
+template<typename Key, typename Value>
+HotColdAVLTree<Key, Value>::~HotColdAVLTree()
+{
+    this->clear();
+}
+
+template<typename Key, typename Value>
+size_t HotColdAVLTree<Key, Value>::memoryUsage() const
+{
+    return hot_.memoryUsage() + cold_.memoryUsage() + sizeof(*this);
+}
+
+template<typename Key, typename Value>
+typename HotColdAVLTree<Key, Value>::iterator
+HotColdAVLTree<Key, Value>::begin() const
+{
+    HotColdAVLTree<Key, Value>* self = const_cast<HotColdAVLTree<Key, Value>*>(this);
+    return iterator(self, self->getSmallestNode());
+}
+
+template<typename Key, typename Value>
+typename HotColdAVLTree<Key, Value>::iterator
+HotColdAVLTree<Key, Value>::end() const
+{
+    return iterator(const_cast<HotColdAVLTree<Key, Value>*>(this), 0);
+}
+
+template<typename Key, typename Value>
+typename HotColdAVLTree<Key, Value>::iterator
+HotColdAVLTree<Key, Value>::find(const Key& key) const
+{
+    return iterator(const_cast<HotColdAVLTree<Key, Value>*>(this), this->internalFind(key));
+}
+
+/**
+* @precondition The key exists in the map
+* Returns the value associated with the key
+*/
+template<typename Key, typename Value>
+Value& HotColdAVLTree<Key, Value>::operator[](const Key& key)
+{
+    NodeId id = this->internalFind(key);
+    if(id == 0) throw std::out_of_range("Invalid key");
+    return cold(id);
+}
+
+template<typename Key, typename Value>
+Value const & HotColdAVLTree<Key, Value>::operator[](const Key& key) const
+{
+    NodeId id = this->internalFind(key);
+    if(id == 0) throw std::out_of_range("Invalid key");
+    return cold(id);
+}
+
+/**
+* Inserts an item, overwriting the value if the key already exists. The
+* value is constructed before the key so that a throwing key copy only
+* has the value to undo.
+*/
+template<typename Key, typename Value>
+void HotColdAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    NodeId parent;
+    bool goLeft;
+    NodeId id = this->findInsertPoint(keyValuePair.first, parent, goLeft);
+    if(id != 0){
+        cold(id) = keyValuePair.second;
+        return;
+    }
+
+    id = this->nextFreeSlot();
+    new (&cold(id)) Value(keyValuePair.second);
+    try {
+        new (&hot(id).key) Key(keyValuePair.first);
+    } catch(...) {
+        cold(id).~Value();
+        throw;
+    }
+    this->linkSlot(id, parent, goLeft);
+}
+
+/**
+* Removes the item with the given key if it exists.
+*/
+template<typename Key, typename Value>
+void HotColdAVLTree<Key, Value>::remove(const Key& key)
+{
+    this->removeKey(key);
+}
+
+template<typename Key, typename Value>
+typename HotColdAVLTree<Key, Value>::HotNode&
+HotColdAVLTree<Key, Value>::hot(NodeId id) const
+{
+    return hot_[id - 1];
+}
+
+template<typename Key, typename Value>
+Value& HotColdAVLTree<Key, Value>::cold(NodeId id) const
+{
+    return cold_[id - 1];
+}
+
+template<typename Key, typename Value>
+PackedLinks& HotColdAVLTree<Key, Value>::links(NodeId id) const
+{
+    return hot_[id - 1].links;
+}
+
+template<typename Key, typename Value>
+const Key& HotColdAVLTree<Key, Value>::key(NodeId id) const
+{
+    return hot_[id - 1].key;
+}
+
+/**
+* Grows the hot and cold arrays together, so an id indexes both.
+*/
+template<typename Key, typename Value>
+void HotColdAVLTree<Key, Value>::growPool(size_t count)
+{
+    hot_.grow(count);
+    cold_.grow(count);
+}
+
+template<typename Key, typename Value>
+void HotColdAVLTree<Key, Value>::releasePool()
+{
+    hot_.release();
+    cold_.release();
+}
+
+template<typename Key, typename Value>
+void HotColdAVLTree<Key, Value>::destroyItem(NodeId id)
+{
+    hot(id).key.~Key();
+    cold(id).~Value();
+}
+
+/*
+---------------------------------------------------
+End implementations for the HotColdAVLTree class.
+---------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,665 @@
+#ifndef INDEX_AVL_H
+#define INDEX_AVL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+/**
+* AVL rebalancing for trees whose nodes are named by integer ids rather
+* than Node pointers, such as PagedTree and CompactAVLTree. Id 0 plays the
+* role of NULL, and balances follow the AVLNode convention (height of the
+* right subtree minus height of the left).
+*
+* Derived (CRTP) must provide, for any non-zero id:
+*
+*   NodeId getParent(NodeId), getLeft(NodeId), getRight(NodeId)
+*   int getBalance(NodeId)
+*   void setParent(NodeId, NodeId), setLeft(NodeId, NodeId),
+*        setRight(NodeId, NodeId), setBalance(NodeId, int)
+*   NodeId getRoot() const, void setRoot(NodeId)
+*
+* and declare IndexAVLOps<Derived, NodeId> a friend if those are not public.
+* setBalance() is only ever given -1, 0 or 1: a subtree that reaches -2 or
+* 2 is rotated first and its nodes are given their final balances.
+*/
+template <typename Derived, typename NodeId>
+class IndexAVLOps
+{
+protected:
+    NodeId getSmallestNode();
+    NodeId successor(NodeId id);
+    void replaceChild(NodeId parent, NodeId oldChild, NodeId newChild);
+    void rotateLeft(NodeId x);
+    void rotateRight(NodeId x);
+    void insertFix(NodeId child);
+    void removeFix(NodeId parent, bool removedLeft);
+    void detach(NodeId target, bool rebalance = true);
+    void swapNodes(NodeId n1, NodeId n2);
+
+private:
+    Derived& self() { return static_cast<Derived&>(*this); }
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the IndexAVLOps class.
+  -----------------------------------------------
+*/
+
+template<typename Derived, typename NodeId>
+NodeId IndexAVLOps<Derived, NodeId>::getSmallestNode()
+{
+    NodeId node = self().getRoot();
+    if(node == 0){
+        return 0;
+    }
+    while(self().getLeft(node) != 0){
+        node = self().getLeft(node);
+    }
+    return node;
+}
+
+template<typename Derived, typename NodeId>
+NodeId IndexAVLOps<Derived, NodeId>::successor(NodeId id)
+{
+    NodeId temp = self().getRight(id);
+    if(temp != 0){
+        while(self().getLeft(temp) != 0){
+            temp = self().getLeft(temp);
+        }
+        return temp;
+    }
+
+    NodeId prev = id;
+    temp = self().getParent(id);
+    while(temp != 0 && self().getLeft(temp) != prev){
+        prev = temp;
+        temp = self().getParent(temp);
+    }
+    return temp;
+}
+
+/**
+* Points parent's link to oldChild (or the root) at newChild.
+*/
+template<typename Derived, typename NodeId>
+void IndexAVLOps<Derived, NodeId>::replaceChild(NodeId parent, NodeId oldChild, NodeId newChild)
+{
+    if(parent == 0){
+        self().setRoot(newChild);
+    } else if(self().getLeft(parent) == oldChild){
+        self().setLeft(parent, newChild);
+    } else {
+        self().setRight(parent, newChild);
+    }
+}
+
+/**
+* Rotates x's right child up into x's place. Balances are left to the
+* caller.
+*/
+template<typename Derived, typename NodeId>
+void IndexAVLOps<Derived, NodeId>::rotateLeft(NodeId x)
+{
+    NodeId y = self().getRight(x);
+    NodeId inner = self().getLeft(y);
+    NodeId par = self().getParent(x);
+
+    self().setRight(x, inner);
+    if(inner != 0){
+        self().setParent(inner, x);
+    }
+    self().setParent(y, par);
+    replaceChild(par, x, y);
+    self().setLeft(y, x);
+    self().setParent(x, y);
+}
+
+template<typename Derived, typename NodeId>
+void IndexAVLOps<Derived, NodeId>::rotateRight(NodeId x)
+{
+    NodeId y = self().getLeft(x);
+    NodeId inner = self().getRight(y);
+    NodeId par = self().getParent(x);
+
+    self().setLeft(x, inner);
+    if(inner != 0){
+        self().setParent(inner, x);
+    }
+    self().setParent(y, par);
+    replaceChild(par, x, y);
+    self().setRight(y, x);
+    self().setParent(x, y);
+}
+
+/**
+* Updates balances from a newly inserted node upward, doing at most one
+* single or double rotation.
+*/
+template<typename Derived, typename NodeId>
+void IndexAVLOps<Derived, NodeId>::insertFix(NodeId child)
+{
+    NodeId par = self().getParent(child);
+    while(par != 0){
+        int balance = self().getBalance(par) + (self().getLeft(par) == child ? -1 : 1);
+        if(balance == 0){
+            self().setBalance(par, 0);
+            return;
+        }
+        if(balance == 1 || balance == -1){
+            self().setBalance(par, balance);
+            child = par;
+            par = self().getParent(par);
+            continue;
+        }
+
+        int childBalance = self().getBalance(child);
+        if(balance == -2 && childBalance == -1){
+            rotateRight(par);
+            self().setBalance(par, 0);
+            self().setBalance(child, 0);
+        } else if(balance == 2 && childBalance == 1){
+            rotateLeft(par);
+            self().setBalance(par, 0);
+            self().setBalance(child, 0);
+        } else if(balance == -2){
+            NodeId grand = self().getRight(child);
+            int grandBalance = self().getBalance(grand);
+            rotateLeft(child);
+            rotateRight(par);
+            self().setBalance(par, grandBalance == -1 ? 1 : 0);
+            self().setBalance(child, grandBalance == 1 ? -1 : 0);
+            self().setBalance(grand, 0);
+        } else {
+            NodeId grand = self().getLeft(child);
+            int grandBalance = self().getBalance(grand);
+            rotateRight(child);
+            rotateLeft(par);
+            self().setBalance(par, grandBalance == 1 ? -1 : 0);
+            self().setBalance(child, grandBalance == -1 ? 1 : 0);
+            self().setBalance(grand, 0);
+        }
+        return;
+    }
+}
+
+/**
+* Updates balances upward from the parent of a removed node, rotating
+* wherever a subtree became unbalanced, until a subtree's height is
+* unchanged.
+*/
+template<typename Derived, typename NodeId>
+void IndexAVLOps<Derived, NodeId>::removeFix(NodeId par, bool removedLeft)
+{
+    while(par != 0){
+        int balance = self().getBalance(par) + (removedLeft ? 1 : -1);
+        if(balance >= -1 && balance <= 1){
+            self().setBalance(par, balance);
+            if(balance != 0){
+                return;
+            }
+        }
+
+        NodeId subtreeRoot = par;
+        if(balance == 2 || balance == -2){
+            bool rightHeavy = (balance == 2);
+            NodeId child = rightHeavy ? self().getRight(par) : self().getLeft(par);
+            int childBalance = self().getBalance(child);
+            int sign = rightHeavy ? 1 : -1;
+
+            if(childBalance == 0){
+                if(rightHeavy) rotateLeft(par); else rotateRight(par);
+                self().setBalance(par, sign);
+                self().setBalance(child, -sign);
+                return;
+            }
+            if(childBalance == sign){
+                if(rightHeavy) rotateLeft(par); else rotateRight(par);
+                self().setBalance(par, 0);
+                self().setBalance(child, 0);
+                subtreeRoot = child;
+            } else {
+                NodeId grand = rightHeavy ? self().getLeft(child) : self().getRight(child);
+                int grandBalance = self().getBalance(grand);
+                if(rightHeavy){
+                    rotateRight(child);
+                    rotateLeft(par);
+                } else {
+                    rotateLeft(child);
+                    rotateRight(par);
+                }
+                self().setBalance(par, grandBalance == sign ? -sign : 0);
+                self().setBalance(child, grandBalance == -sign ? sign : 0);
+                self().setBalance(grand, 0);
+                subtreeRoot = grand;
+            }
+        }
+
+        // this subtree got shorter, so keep going
+        NodeId next = self().getParent(subtreeRoot);
+        removedLeft = (next != 0 && self().getLeft(next) == subtreeRoot);
+        par = next;
+    }
+}
+
+/**
+* Splices out target, which must have at most one child, and (unless
+* rebalance is false) rebalances from its old parent. The caller frees
+* target afterwards.
+*/
+template<typename Derived, typename NodeId>
+void IndexAVLOps<Derived, NodeId>::detach(NodeId target, bool rebalance)
+{
+    NodeId par = self().getParent(target);
+    NodeId child = self().getLeft(target) != 0 ? self().getLeft(target) : self().getRight(target);
+    bool removedLeft = (par != 0 && self().getLeft(par) == target);
+
+    if(child != 0){
+        self().setParent(child, par);
+    }
+    replaceChild(par, target, child);
+
+    if(par != 0 && rebalance){
+        removeFix(par, removedLeft);
+    }
+}
+
+/**
+* Exchanges the positions (and balances) of two nodes, the same way
+* BinarySearchTree::nodeSwap() does for Node pointers, so that items
+* never have to be copied between nodes.
+*/
+template<typename Derived, typename NodeId>
+void IndexAVLOps<Derived, NodeId>::swapNodes(NodeId n1, NodeId n2)
+{
+    if(n1 == n2 || n1 == 0 || n2 == 0){
+        return;
+    }
+    Derived& d = self();
+    NodeId n1p = d.getParent(n1);
+    NodeId n1r = d.getRight(n1);
+    NodeId n1lt = d.getLeft(n1);
+    bool n1isLeft = (n1p != 0 && d.getLeft(n1p) == n1);
+    NodeId n2p = d.getParent(n2);
+    NodeId n2r = d.getRight(n2);
+    NodeId n2lt = d.getLeft(n2);
+    bool n2isLeft = (n2p != 0 && d.getLeft(n2p) == n2);
+    int n1b = d.getBalance(n1);
+    int n2b = d.getBalance(n2);
+
+    d.setParent(n1, n2p);
+    d.setParent(n2, n1p);
+    d.setLeft(n1, n2lt);
+    d.setLeft(n2, n1lt);
+    d.setRight(n1, n2r);
+    d.setRight(n2, n1r);
+    d.setBalance(n1, n2b);
+    d.setBalance(n2, n1b);
+
+    if(n1r == n2){
+        d.setRight(n2, n1);
+        d.setParent(n1, n2);
+    } else if(n2r == n1){
+        d.setRight(n1, n2);
+        d.setParent(n2, n1);
+    } else if(n1lt == n2){
+        d.setLeft(n2, n1);
+        d.setParent(n1, n2);
+    } else if(n2lt == n1){
+        d.setLeft(n1, n2);
+        d.setParent(n2, n1);
+    }
+
+    if(n1p != 0 && n1p != n2){
+        if(n1isLeft) d.setLeft(n1p, n2);
+        else d.setRight(n1p, n2);
+    }
+    if(n1r != 0 && n1r != n2){
+        d.setParent(n1r, n2);
+    }
+    if(n1lt != 0 && n1lt != n2){
+        d.setParent(n1lt, n2);
+    }
+
+    if(n2p != 0 && n2p != n1){
+        if(n2isLeft) d.setLeft(n2p, n1);
+        else d.setRight(n2p, n1);
+    }
+    if(n2r != 0 && n2r != n1){
+        d.setParent(n2r, n1);
+    }
+    if(n2lt != 0 && n2lt != n1){
+        d.setParent(n2lt, n1);
+    }
+
+    if(d.getRoot() == n1){
+        d.setRoot(n2);
+    } else if(d.getRoot() == n2){
+        d.setRoot(n1);
+    }
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the IndexAVLOps class.
+  -----------------------------------------------
+*/
+
+/**
+* The links of a pooled node: two child ids, and the parent id with the
+* node's balance + 1 packed into the top two bits.
+*/
+struct PackedLinks
+{
+    uint32_t left;
+    uint32_t right;
+    uint32_t parentBits;    // parent id | (balance + 1) << INDEX_BITS
+};
+
+/**
+* The node pool, links and search shared by the id-based AVL containers
+* (CompactAVLTree, HotColdAVLTree and KeySet). Ids are 1-based, so a pool
+* holds at most 2^30 - 1 nodes, and freed ids are kept on a list threaded
+* through left.
+*
+* Derived (CRTP) supplies its node layout and value access:
+*
+*   PackedLinks& links(NodeId) const
+*   const Key& key(NodeId) const
+*   void growPool(size_t count)     gives ids 1 to count storage
+*   void releasePool()              frees all storage
+*   void destroyItem(NodeId)        destroys what the node holds
+*   static const bool TRIVIAL_ITEMS destroyItem() may be skipped
+*
+* It constructs a node's contents itself, between nextFreeSlot() and
+* linkSlot(), and declares PooledAVLTree<Derived, Key> a friend if the
+* members above are not public.
+*/
+template <typename Derived, typename Key>
+class PooledAVLTree : public IndexAVLOps<Derived, uint32_t>
+{
+public:
+    typedef uint32_t NodeId;
+
+    void clear();
+    bool empty() const;
+    size_t size() const;
+
+protected:
+    PooledAVLTree();
+
+    static const uint32_t INDEX_BITS = 30;
+    static const uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+
+    NodeId getParent(NodeId id) const;
+    NodeId getLeft(NodeId id) const;
+    NodeId getRight(NodeId id) const;
+    int getBalance(NodeId id) const;
+    void setParent(NodeId id, NodeId parent);
+    void setLeft(NodeId id, NodeId left);
+    void setRight(NodeId id, NodeId right);
+    void setBalance(NodeId id, int balance);
+    NodeId getRoot() const;
+    void setRoot(NodeId root);
+
+    NodeId internalFind(const Key& key) const;
+    NodeId findInsertPoint(const Key& key, NodeId& parent, bool& goLeft) const;
+    NodeId nextFreeSlot();
+    void linkSlot(NodeId id, NodeId parent, bool goLeft, bool rebalance = true);
+    void removeKey(const Key& key, bool rebalance = true);
+
+private:
+    friend class IndexAVLOps<Derived, NodeId>;
+
+    Derived& derived() { return static_cast<Derived&>(*this); }
+    const Derived& derived() const { return static_cast<const Derived&>(*this); }
+
+    NodeId root_;
+    NodeId freeHead_;
+    NodeId nextSlot_;
+    size_t count_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the PooledAVLTree class.
+  -----------------------------------------------
+*/
+
+template<typename Derived, typename Key>
+PooledAVLTree<Derived, Key>::PooledAVLTree() :
+    root_(0), freeHead_(0), nextSlot_(0), count_(0)
+{
+
+}
+
+/**
+* Destroys every live item and gives the pool back to the heap. Items
+* are only live in nodes reachable from the root.
+*/
+template<typename Derived, typename Key>
+void PooledAVLTree<Derived, Key>::clear()
+{
+    if(!Derived::TRIVIAL_ITEMS){
+        NodeId id = this->getSmallestNode();
+        while(id != 0){
+            NodeId next = this->successor(id);
+            derived().destroyItem(id);
+            id = next;
+        }
+    }
+    derived().releasePool();
+    root_ = 0;
+    freeHead_ = 0;
+    nextSlot_ = 0;
+    count_ = 0;
+}
+
+template<typename Derived, typename Key>
+bool PooledAVLTree<Derived, Key>::empty() const
+{
+    return root_ == 0;
+}
+
+template<typename Derived, typename Key>
+size_t PooledAVLTree<Derived, Key>::size() const
+{
+    return count_;
+}
+
+template<typename Derived, typename Key>
+typename PooledAVLTree<Derived, Key>::NodeId PooledAVLTree<Derived, Key>::getParent(NodeId id) const
+{
+    return derived().links(id).parentBits & INDEX_MASK;
+}
+
+template<typename Derived, typename Key>
+typename PooledAVLTree<Derived, Key>::NodeId PooledAVLTree<Derived, Key>::getLeft(NodeId id) const
+{
+    return derived().links(id).left;
+}
+
+template<typename Derived, typename Key>
+typename PooledAVLTree<Derived, Key>::NodeId PooledAVLTree<Derived, Key>::getRight(NodeId id) const
+{
+    return derived().links(id).right;
+}
+
+template<typename Derived, typename Key>
+int PooledAVLTree<Derived, Key>::getBalance(NodeId id) const
+{
+    return static_cast<int>(derived().links(id).parentBits >> INDEX_BITS) - 1;
+}
+
+template<typename Derived, typename Key>
+void PooledAVLTree<Derived, Key>::setParent(NodeId id, NodeId parent)
+{
+    PackedLinks& n = derived().links(id);
+    n.parentBits = (n.parentBits & ~INDEX_MASK) | parent;
+}
+
+template<typename Derived, typename Key>
+void PooledAVLTree<Derived, Key>::setLeft(NodeId id, NodeId left)
+{
+    derived().links(id).left = left;
+}
+
+template<typename Derived, typename Key>
+void PooledAVLTree<Derived, Key>::setRight(NodeId id, NodeId right)
+{
+    derived().links(id).right = right;
+}
+
+/**
+* Two bits hold balance + 1, which is enough because IndexAVLOps only
+* stores -1, 0 or 1.
+*/
+template<typename Derived, typename Key>
+void PooledAVLTree<Derived, Key>::setBalance(NodeId id, int balance)
+{
+    PackedLinks& n = derived().links(id);
+    uint32_t bits = static_cast<uint32_t>(balance + 1);
+    n.parentBits = (n.parentBits & INDEX_MASK) | (bits << INDEX_BITS);
+}
+
+template<typename Derived, typename Key>
+typename PooledAVLTree<Derived, Key>::NodeId PooledAVLTree<Derived, Key>::getRoot() const
+{
+    return root_;
+}
+
+template<typename Derived, typename Key>
+void PooledAVLTree<Derived, Key>::setRoot(NodeId root)
+{
+    root_ = root;
+}
+
+template<typename Derived, typename Key>
+typename PooledAVLTree<Derived, Key>::NodeId PooledAVLTree<Derived, Key>::internalFind(const Key& key) const
+{
+    NodeId id = root_;
+    while(id != 0){
+        const Key& current = derived().key(id);
+        if(key < current){
+            id = derived().links(id).left;
+        } else if(current < key){
+            id = derived().links(id).right;
+        } else {
+            return id;
+        }
+    }
+    return 0;
+}
+
+/**
+* Returns the node holding key, or 0 after setting parent and goLeft to
+* where a node for it would be linked (parent is 0 for an empty tree).
+*/
+template<typename Derived, typename Key>
+typename PooledAVLTree<Derived, Key>::NodeId
+PooledAVLTree<Derived, Key>::findInsertPoint(const Key& key, NodeId& parent, bool& goLeft) const
+{
+    NodeId curr = root_;
+    parent = 0;
+    goLeft = false;
+    while(curr != 0){
+        const Key& current = derived().key(curr);
+        parent = curr;
+        if(key < current){
+            goLeft = true;
+            curr = derived().links(curr).left;
+        } else if(current < key){
+            goLeft = false;
+            curr = derived().links(curr).right;
+        } else {
+            return curr;
+        }
+    }
+    return 0;
+}
+
+/**
+* Returns the id the next node will use, the head of the free list or
+* the next never-used slot, and makes sure it has storage. The id is not
+* taken until linkSlot(), so a constructor that throws in between leaves
+* the pool unchanged. Throws std::length_error past 2^30 - 1 nodes.
+*/
+template<typename Derived, typename Key>
+typename PooledAVLTree<Derived, Key>::NodeId PooledAVLTree<Derived, Key>::nextFreeSlot()
+{
+    if(freeHead_ != 0){
+        return freeHead_;
+    }
+    if(nextSlot_ == INDEX_MASK){
+        throw std::length_error("Node pool is full");
+    }
+    derived().growPool(nextSlot_ + 1);
+    return nextSlot_ + 1;
+}
+
+/**
+* Takes the id from nextFreeSlot(), whose contents the caller has just
+* constructed, and links it below parent as findInsertPoint() reported.
+*/
+template<typename Derived, typename Key>
+void PooledAVLTree<Derived, Key>::linkSlot(NodeId id, NodeId parent, bool goLeft, bool rebalance)
+{
+    PackedLinks& n = derived().links(id);
+    if(id == freeHead_){
+        freeHead_ = n.left;
+    } else {
+        nextSlot_++;
+    }
+    n.left = 0;
+    n.right = 0;
+    n.parentBits = parent | (1u << INDEX_BITS);
+    count_++;
+
+    if(parent == 0){
+        root_ = id;
+    } else if(goLeft){
+        setLeft(parent, id);
+    } else {
+        setRight(parent, id);
+    }
+    if(rebalance){
+        this->insertFix(id);
+    }
+}
+
+/**
+* Removes the node holding key if there is one. A node with two children
+* is first swapped with its predecessor, then the node is destroyed and
+* its id pushed onto the free list.
+*/
+template<typename Derived, typename Key>
+void PooledAVLTree<Derived, Key>::removeKey(const Key& key, bool rebalance)
+{
+    NodeId target = internalFind(key);
+    if(target == 0){
+        return;
+    }
+
+    if(getLeft(target) != 0 && getRight(target) != 0){
+        NodeId pred = getLeft(target);
+        while(getRight(pred) != 0){
+            pred = getRight(pred);
+        }
+        this->swapNodes(target, pred);
+    }
+
+    this->detach(target, rebalance);
+    derived().destroyItem(target);
+    derived().links(target).left = freeHead_;
+    freeHead_ = target;
+    count_--;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the PooledAVLTree class.
+  -----------------------------------------------
+*/
+
+#endif
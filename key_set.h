@@ -0,0 +1,279 @@
+#ifndef KEY_SET_H
+#define KEY_SET_H
+
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include "index_avl.h"
+#include "compact_avl.h"
+
+/**
+* Sorted sets whose nodes store only a key.
+*
+* A Node always carries a std::pair<const Key, Value>, so AVLTree<Key, bool>
+* pays for a value (and its padding) plus a vptr in every node. KeySet
+* nodes hold just the key, two 32-bit child links and a 32-bit parent link
+* with the AVL balance packed into its top bits, and share their pool,
+* search and rotations with CompactAVLTree through PooledAVLTree.
+*
+* AVLSet<Key> keeps the tree balanced; BSTSet<Key> is the unbalanced
+* counterpart of BinarySearchTree.
+*/
+template <typename Key, bool Balanced>
+class KeySet : public PooledAVLTree<KeySet<Key, Balanced>, Key>
+{
+public:
+    typedef uint32_t NodeId;
+
+    KeySet();
+    ~KeySet();
+
+    void insert(const Key& key);
+    void remove(const Key& key);
+    size_t count(const Key& key) const;
+    size_t memoryUsage() const;
+
+    /**
+    * An internal iterator class for traversing the keys in order.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        const Key& operator*() const;
+        const Key* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class KeySet<Key, Balanced>;
+        iterator(KeySet<Key, Balanced>* set, NodeId id);
+        KeySet<Key, Balanced>* set_;
+        NodeId current_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+
+protected:
+    struct SetNode
+    {
+        Key key;
+        PackedLinks links;
+    };
+
+    static const bool TRIVIAL_ITEMS = std::is_trivially_destructible<Key>::value;
+
+    SetNode& node(NodeId id) const;
+    PackedLinks& links(NodeId id) const;
+    const Key& key(NodeId id) const;
+    void growPool(size_t count);
+    void releasePool();
+    void destroyItem(NodeId id);
+
+private:
+    friend class PooledAVLTree<KeySet<Key, Balanced>, Key>;
+
+    KeySet(const KeySet<Key, Balanced>&);
+    KeySet<Key, Balanced>& operator=(const KeySet<Key, Balanced>&);
+
+    ChunkedArray<SetNode> nodes_;
+};
+
+template <typename Key>
+using AVLSet = KeySet<Key, true>;
+
+template <typename Key>
+using BSTSet = KeySet<Key, false>;
+
+/*
+--------------------------------------------------------------
+Begin implementations for the KeySet::iterator class.
+---------------------------------------------------------------
+*/
+
+template<typename Key, bool Balanced>
+KeySet<Key, Balanced>::iterator::iterator() :
+    set_(NULL), current_(0)
+{
+
+}
+
+template<typename Key, bool Balanced>
+KeySet<Key, Balanced>::iterator::iterator(KeySet<Key, Balanced>* set, NodeId id) :
+    set_(set), current_(id)
+{
+
+}
+
+template<typename Key, bool Balanced>
+const Key& KeySet<Key, Balanced>::iterator::operator*() const
+{
+    return set_->node(current_).key;
+}
+
+template<typename Key, bool Balanced>
+const Key* KeySet<Key, Balanced>::iterator::operator->() const
+{
+    return &(set_->node(current_).key);
+}
+
+template<typename Key, bool Balanced>
+bool KeySet<Key, Balanced>::iterator::operator==(const iterator& rhs) const
+{
+    return current_ == rhs.current_;
+}
+
+template<typename Key, bool Balanced>
+bool KeySet<Key, Balanced>::iterator::operator!=(const iterator& rhs) const
+{
+    return current_ != rhs.current_;
+}
+
+template<typename Key, bool Balanced>
+typename KeySet<Key, Balanced>::iterator&
+KeySet<Key, Balanced>::iterator::operator++()
+{
+    if(current_ != 0){
+        current_ = set_->successor(current_);
+    }
+    return *this;
+}
+
+/*
+-------------------------------------------------------------
+End implementations for the KeySet::iterator class.
+-------------------------------------------------------------
+*/
+
+/*
+-----------------------------------------------------
+Begin implementations for the KeySet class.
+-----------------------------------------------------
+*/
+
+template<typename Key, bool Balanced>
+KeySet<Key, Balanced>::KeySet()
+{
+
+}
+
+template<typename Key, bool Balanced>
+KeySet<Key, Balanced>::~KeySet()
+{
+    this->clear();
+}
+
+/**
+* Returns 1 if the key is in the set and 0 otherwise.
+*/
+template<typename Key, bool Balanced>
+size_t KeySet<Key, Balanced>::count(const Key& key) const
+{
+    return this->internalFind(key) != 0 ? 1 : 0;
+}
+
+template<typename Key, bool Balanced>
+size_t KeySet<Key, Balanced>::memoryUsage() const
+{
+    return nodes_.memoryUsage() + sizeof(*this);
+}
+
+template<typename Key, bool Balanced>
+typename KeySet<Key, Balanced>::iterator
+KeySet<Key, Balanced>::begin() const
+{
+    KeySet<Key, Balanced>* self = const_cast<KeySet<Key, Balanced>*>(this);
+    return iterator(self, self->getSmallestNode());
+}
+
+template<typename Key, bool Balanced>
+typename KeySet<Key, Balanced>::iterator
+KeySet<Key, Balanced>::end() const
+{
+    return iterator(const_cast<KeySet<Key, Balanced>*>(this), 0);
+}
+
+template<typename Key, bool Balanced>
+typename KeySet<Key, Balanced>::iterator
+KeySet<Key, Balanced>::find(const Key& key) const
+{
+    return iterator(const_cast<KeySet<Key, Balanced>*>(this), this->internalFind(key));
+}
+
+/**
+* Adds key to the set if it isn't already there.
+*/
+template<typename Key, bool Balanced>
+void KeySet<Key, Balanced>::insert(const Key& key)
+{
+    NodeId parent;
+    bool goLeft;
+    if(this->findInsertPoint(key, parent, goLeft) != 0){
+        return;
+    }
+
+    NodeId id = this->nextFreeSlot();
+    new (&node(id).key) Key(key);
+    this->linkSlot(id, parent, goLeft, Balanced);
+}
+
+/**
+* Removes key from the set if it is there.
+*/
+template<typename Key, bool Balanced>
+void KeySet<Key, Balanced>::remove(const Key& key)
+{
+    this->removeKey(key, Balanced);
+}
+
+template<typename Key, bool Balanced>
+typename KeySet<Key, Balanced>::SetNode&
+KeySet<Key, Balanced>::node(NodeId id) const
+{
+    return nodes_[id - 1];
+}
+
+template<typename Key, bool Balanced>
+PackedLinks& KeySet<Key, Balanced>::links(NodeId id) const
+{
+    return nodes_[id - 1].links;
+}
+
+template<typename Key, bool Balanced>
+const Key& KeySet<Key, Balanced>::key(NodeId id) const
+{
+    return nodes_[id - 1].key;
+}
+
+template<typename Key, bool Balanced>
+void KeySet<Key, Balanced>::growPool(size_t count)
+{
+    nodes_.grow(count);
+}
+
+template<typename Key, bool Balanced>
+void KeySet<Key, Balanced>::releasePool()
+{
+    nodes_.release();
+}
+
+template<typename Key, bool Balanced>
+void KeySet<Key, Balanced>::destroyItem(NodeId id)
+{
+    node(id).key.~Key();
+}
+
+/*
+---------------------------------------------------
+End implementations for the KeySet class.
+---------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef KEY_TRAITS_H
+#define KEY_TRAITS_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/**
+* Key traits let a tree cache a small summary of each key in its node so
+* that most comparisons during a search can be settled without touching
+* the key itself.
+*
+* KeyTraits<Key> provides:
+*
+*   cached                true if nodes should store a Cache
+*   Cache                 the per-node summary
+*   makeCache(key)        builds the summary of a key
+*   compare(a, ca, b, cb) returns <0, 0 or >0 as a is less than, equal to
+*                         or greater than b, using the summaries first
+*
+* The default keeps no summary and compares with the key's own == and <.
+*/
+
+struct NoKeyCache
+{
+};
+
+template <typename Key>
+struct KeyTraits
+{
+    static const bool cached = false;
+    typedef NoKeyCache Cache;
+
+    static Cache makeCache(const Key&)
+    {
+        return Cache();
+    }
+
+    static int compare(const Key& a, const Cache&, const Key& b, const Cache&)
+    {
+        if(a == b){
+            return 0;
+        }
+        return a < b ? -1 : 1;
+    }
+};
+
+/**
+* std::string keys cache their first KEY_PREFIX_BYTES bytes, packed
+* big-endian into integers so that integer order matches the string's
+* (unsigned) byte order, plus their length. Two keys are only compared
+* in full when both are longer than the prefix and their prefixes match.
+* The prefix width can be set at compile time with -DKEY_PREFIX_WORDS=n.
+*/
+#ifndef KEY_PREFIX_WORDS
+#define KEY_PREFIX_WORDS 2
+#endif
+#define KEY_PREFIX_BYTES (KEY_PREFIX_WORDS * 8)
+
+struct StringKeyCache
+{
+    uint64_t prefix[KEY_PREFIX_WORDS];
+    uint32_t length;
+};
+
+template <>
+struct KeyTraits<std::string>
+{
+    static const bool cached = true;
+    typedef StringKeyCache Cache;
+
+    static Cache makeCache(const std::string& key)
+    {
+        Cache cache;
+        size_t length = key.size();
+        for(int w = 0; w < KEY_PREFIX_WORDS; ++w){
+            uint64_t word = 0;
+            for(int b = 0; b < 8; ++b){
+                size_t index = w * 8 + b;
+                unsigned char byte = index < length ? static_cast<unsigned char>(key[index]) : 0;
+                word = (word << 8) | byte;
+            }
+            cache.prefix[w] = word;
+        }
+        // lengths past the prefix only matter as "longer than the prefix"
+        cache.length = length > 0xffffffffu ? 0xffffffffu : static_cast<uint32_t>(length);
+        return cache;
+    }
+
+    static int compare(const std::string& a, const Cache& ca, const std::string& b, const Cache& cb)
+    {
+        for(int w = 0; w < KEY_PREFIX_WORDS; ++w){
+            if(ca.prefix[w] != cb.prefix[w]){
+                return ca.prefix[w] < cb.prefix[w] ? -1 : 1;
+            }
+        }
+        // equal prefixes: if either key fits in the prefix it is a prefix
+        // of the other, so the lengths decide
+        if(ca.length <= KEY_PREFIX_BYTES || cb.length <= KEY_PREFIX_BYTES){
+            if(ca.length == cb.length){
+                return 0;
+            }
+            return ca.length < cb.length ? -1 : 1;
+        }
+        size_t restA = a.size() - KEY_PREFIX_BYTES;
+        size_t restB = b.size() - KEY_PREFIX_BYTES;
+        int result = std::memcmp(a.data() + KEY_PREFIX_BYTES, b.data() + KEY_PREFIX_BYTES,
+            restA < restB ? restA : restB);
+        if(result != 0 || restA == restB){
+            return result;
+        }
+        return restA < restB ? -1 : 1;
+    }
+};
+
+/**
+* Spreads a std::hash value over all 64 bits with a golden-ratio multiply.
+* std::hash<int> is the identity, and the hash tables and filters built
+* on it take their positions from the top bits, where small integer keys
+* would otherwise all land together.
+*/
+inline uint64_t mixKeyHash(size_t hash)
+{
+    return static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+}
+
+/**
+* Holds a node's key cache. Empty (and free, thanks to the empty base
+* optimization) for keys whose traits keep no cache.
+*/
+template <typename Key, bool Cached = KeyTraits<Key>::cached>
+class NodeKeyCache
+{
+public:
+    typedef typename KeyTraits<Key>::Cache Cache;
+
+    explicit NodeKeyCache(const Key&) { }
+    Cache getKeyCache() const { return Cache(); }
+};
+
+template <typename Key>
+class NodeKeyCache<Key, true>
+{
+public:
+    typedef typename KeyTraits<Key>::Cache Cache;
+
+    explicit NodeKeyCache(const Key& key) : keyCache_(KeyTraits<Key>::makeCache(key)) { }
+    const Cache& getKeyCache() const { return keyCache_; }
+
+protected:
+    Cache keyCache_;
+};
+
+#endif
@@ -0,0 +1,805 @@
+#ifndef PAGED_BST_H
+#define PAGED_BST_H
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "index_avl.h"
+
+/**
+* An out-of-core ordered map for trivially copyable keys and values.
+*
+* Nodes are fixed-size records packed into PAGED_PAGE_SIZE pages of a local
+* file. Page 0 holds the tree's metadata; node ids are 1-based record
+* numbers and 0 plays the role of NULL. Pages are only touched through a
+* BufferPool that keeps a bounded number of them in memory and evicts with
+* the clock (second chance) policy, so the tree can be much larger than RAM.
+* The tree is kept AVL balanced, with the same balance convention as
+* AVLNode (height of right minus height of left).
+*/
+
+#define PAGED_PAGE_SIZE 4096
+#define PAGED_MAGIC "PAGEDBST"
+
+/**
+* I/O and cache counters for a BufferPool.
+*/
+struct PagedStats
+{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t pageReads;
+    uint64_t pageWrites;
+    uint64_t evictions;
+
+    double hitRate() const
+    {
+        uint64_t total = hits + misses;
+        return total == 0 ? 0.0 : static_cast<double>(hits) / total;
+    }
+};
+
+/**
+* A file accessed as an array of fixed-size pages.
+*/
+class PageFile
+{
+public:
+    explicit PageFile(const std::string& path);
+    ~PageFile();
+
+    uint64_t pageCount() const;
+    void read(uint64_t pageId, char* buffer);
+    void write(uint64_t pageId, const char* buffer);
+    void sync();
+
+private:
+    PageFile(const PageFile&);
+    PageFile& operator=(const PageFile&);
+
+    int fd_;
+    uint64_t pageCount_;
+};
+
+/**
+* A bounded cache of pages with clock replacement. A pointer returned by
+* fetch() stays valid until the next call to fetch().
+*/
+class BufferPool
+{
+public:
+    BufferPool(PageFile& file, size_t capacity);
+    ~BufferPool();
+
+    char* fetch(uint64_t pageId, bool forWrite);
+    void flush();
+    const PagedStats& stats() const;
+    void resetStats();
+
+private:
+    BufferPool(const BufferPool&);
+    BufferPool& operator=(const BufferPool&);
+
+    struct Frame
+    {
+        uint64_t pageId;
+        bool valid;
+        bool dirty;
+        bool referenced;
+    };
+
+    size_t findVictim();
+
+    PageFile& file_;
+    std::vector<Frame> frames_;
+    std::vector<char> data_;
+    std::unordered_map<uint64_t, size_t> pageTable_;
+    size_t hand_;
+    PagedStats stats_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the PageFile class.
+  -----------------------------------------------
+*/
+
+/**
+* Opens (creating if necessary) the page file at path.
+* Throws std::runtime_error on failure.
+*/
+inline PageFile::PageFile(const std::string& path) : fd_(-1), pageCount_(0)
+{
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if(fd_ < 0){
+        throw std::runtime_error("Cannot open page file: " + path);
+    }
+    struct stat st;
+    if(::fstat(fd_, &st) != 0){
+        ::close(fd_);
+        throw std::runtime_error("Cannot stat page file: " + path);
+    }
+    pageCount_ = st.st_size / PAGED_PAGE_SIZE;
+}
+
+inline PageFile::~PageFile()
+{
+    ::close(fd_);
+}
+
+inline uint64_t PageFile::pageCount() const
+{
+    return pageCount_;
+}
+
+/**
+* Reads a page. Pages past the end of the file read as zeros.
+*/
+inline void PageFile::read(uint64_t pageId, char* buffer)
+{
+    if(pageId >= pageCount_){
+        std::memset(buffer, 0, PAGED_PAGE_SIZE);
+        return;
+    }
+    if(::pread(fd_, buffer, PAGED_PAGE_SIZE, pageId * PAGED_PAGE_SIZE) != PAGED_PAGE_SIZE){
+        throw std::runtime_error("Short read from page file");
+    }
+}
+
+inline void PageFile::write(uint64_t pageId, const char* buffer)
+{
+    if(::pwrite(fd_, buffer, PAGED_PAGE_SIZE, pageId * PAGED_PAGE_SIZE) != PAGED_PAGE_SIZE){
+        throw std::runtime_error("Short write to page file");
+    }
+    if(pageId >= pageCount_){
+        pageCount_ = pageId + 1;
+    }
+}
+
+inline void PageFile::sync()
+{
+    if(::fsync(fd_) != 0){
+        throw std::runtime_error("fsync of page file failed");
+    }
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the PageFile class.
+  -----------------------------------------------
+*/
+
+/*
+  -----------------------------------------------
+  Begin implementations for the BufferPool class.
+  -----------------------------------------------
+*/
+
+inline BufferPool::BufferPool(PageFile& file, size_t capacity) :
+    file_(file),
+    frames_(capacity < 2 ? 2 : capacity),
+    data_(frames_.size() * PAGED_PAGE_SIZE),
+    hand_(0)
+{
+    for(size_t i = 0; i < frames_.size(); ++i){
+        frames_[i].valid = false;
+        frames_[i].dirty = false;
+        frames_[i].referenced = false;
+    }
+    resetStats();
+}
+
+/**
+* Writes back dirty pages. Errors are swallowed here; call flush()
+* beforehand to see them.
+*/
+inline BufferPool::~BufferPool()
+{
+    try {
+        flush();
+    } catch(...) {
+    }
+}
+
+/**
+* Returns the in-memory copy of a page, reading it in (and possibly
+* evicting another page) on a miss. forWrite marks the page dirty.
+*/
+inline char* BufferPool::fetch(uint64_t pageId, bool forWrite)
+{
+    std::unordered_map<uint64_t, size_t>::iterator found = pageTable_.find(pageId);
+    size_t index;
+    if(found != pageTable_.end()){
+        stats_.hits++;
+        index = found->second;
+    } else {
+        stats_.misses++;
+        index = findVictim();
+        Frame& victim = frames_[index];
+        if(victim.valid){
+            if(victim.dirty){
+                file_.write(victim.pageId, &data_[index * PAGED_PAGE_SIZE]);
+                stats_.pageWrites++;
+            }
+            pageTable_.erase(victim.pageId);
+            stats_.evictions++;
+            victim.valid = false;
+        }
+        if(pageId < file_.pageCount()){
+            stats_.pageReads++;
+        }
+        file_.read(pageId, &data_[index * PAGED_PAGE_SIZE]);
+        victim.pageId = pageId;
+        victim.valid = true;
+        victim.dirty = false;
+        pageTable_[pageId] = index;
+    }
+
+    Frame& frame = frames_[index];
+    frame.referenced = true;
+    if(forWrite){
+        frame.dirty = true;
+    }
+    return &data_[index * PAGED_PAGE_SIZE];
+}
+
+/**
+* Advances the clock hand until it finds a free frame or one whose
+* reference bit is clear, clearing reference bits as it passes.
+*/
+inline size_t BufferPool::findVictim()
+{
+    while(true){
+        Frame& frame = frames_[hand_];
+        size_t index = hand_;
+        hand_ = (hand_ + 1) % frames_.size();
+        if(!frame.valid || !frame.referenced){
+            return index;
+        }
+        frame.referenced = false;
+    }
+}
+
+/**
+* Writes every dirty page back to the file and syncs it.
+*/
+inline void BufferPool::flush()
+{
+    for(size_t i = 0; i < frames_.size(); ++i){
+        if(frames_[i].valid && frames_[i].dirty){
+            file_.write(frames_[i].pageId, &data_[i * PAGED_PAGE_SIZE]);
+            stats_.pageWrites++;
+            frames_[i].dirty = false;
+        }
+    }
+    file_.sync();
+}
+
+inline const PagedStats& BufferPool::stats() const
+{
+    return stats_;
+}
+
+inline void BufferPool::resetStats()
+{
+    std::memset(&stats_, 0, sizeof(stats_));
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the BufferPool class.
+  -----------------------------------------------
+*/
+
+/**
+* A paged, AVL balanced ordered map with the BinarySearchTree interface.
+* Since items live in the buffer pool rather than in stable heap nodes,
+* values are returned by copy and are updated through insert().
+*/
+template <typename Key, typename Value>
+class PagedTree : public IndexAVLOps<PagedTree<Key, Value>, uint64_t>
+{
+public:
+    typedef uint64_t NodeId;
+
+    PagedTree(const std::string& path, size_t poolPages);
+    ~PagedTree();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool empty() const;
+    size_t size() const;
+    void flush();
+
+    const PagedStats& stats() const;
+    void resetStats();
+
+    /**
+    * An iterator over the tree in key order. Items are copied out of the
+    * buffer pool when dereferenced.
+    */
+    class iterator
+    {
+    public:
+        class ArrowProxy
+        {
+        public:
+            const std::pair<Key, Value>* operator->() const { return &item_; }
+        private:
+            friend class iterator;
+            ArrowProxy(const std::pair<Key, Value>& item) : item_(item) { }
+            std::pair<Key, Value> item_;
+        };
+
+        iterator();
+
+        std::pair<Key, Value> operator*() const;
+        ArrowProxy operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class PagedTree<Key, Value>;
+        iterator(PagedTree<Key, Value>* tree, NodeId id);
+        PagedTree<Key, Value>* tree_;
+        NodeId current_;
+    };
+
+    iterator begin();
+    iterator end();
+    iterator find(const Key& key);
+    Value operator[](const Key& key);
+
+protected:
+    struct Record
+    {
+        Key key;
+        Value value;
+        NodeId parent;
+        NodeId left;
+        NodeId right;
+        int8_t balance;
+    };
+
+    struct Meta
+    {
+        char magic[8];
+        uint32_t keySize;
+        uint32_t valueSize;
+        NodeId root;
+        NodeId freeHead;
+        uint64_t count;
+        uint64_t nextSlot;
+    };
+
+    static const size_t RECORDS_PER_PAGE = PAGED_PAGE_SIZE / sizeof(Record);
+
+    // Record access through the buffer pool
+    Record* record(NodeId id, bool forWrite);
+    NodeId getParent(NodeId id);
+    NodeId getLeft(NodeId id);
+    NodeId getRight(NodeId id);
+    int8_t getBalance(NodeId id);
+    void setParent(NodeId id, NodeId parent);
+    void setLeft(NodeId id, NodeId left);
+    void setRight(NodeId id, NodeId right);
+    void setBalance(NodeId id, int8_t balance);
+
+    NodeId allocate(const Key& key, const Value& value, NodeId parent);
+    void release(NodeId id);
+
+    NodeId getRoot() const;
+    void setRoot(NodeId root);
+
+    NodeId internalFind(const Key& key);
+
+private:
+    friend class IndexAVLOps<PagedTree<Key, Value>, NodeId>;
+
+    PagedTree(const PagedTree<Key, Value>&);
+    PagedTree<Key, Value>& operator=(const PagedTree<Key, Value>&);
+
+    PageFile file_;
+    BufferPool pool_;
+    Meta meta_;
+};
+
+/*
+--------------------------------------------------------------
+Begin implementations for the PagedTree::iterator class.
+---------------------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+PagedTree<Key, Value>::iterator::iterator() :
+    tree_(NULL), current_(0)
+{
+
+}
+
+template<typename Key, typename Value>
+PagedTree<Key, Value>::iterator::iterator(PagedTree<Key, Value>* tree, NodeId id) :
+    tree_(tree), current_(id)
+{
+
+}
+
+template<typename Key, typename Value>
+std::pair<Key, Value> PagedTree<Key, Value>::iterator::operator*() const
+{
+    const Record* rec = tree_->record(current_, false);
+    return std::pair<Key, Value>(rec->key, rec->value);
+}
+
+template<typename Key, typename Value>
+typename PagedTree<Key, Value>::iterator::ArrowProxy
+PagedTree<Key, Value>::iterator::operator->() const
+{
+    return ArrowProxy(**this);
+}
+
+template<typename Key, typename Value>
+bool PagedTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return current_ == rhs.current_;
+}
+
+template<typename Key, typename Value>
+bool PagedTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return current_ != rhs.current_;
+}
+
+template<typename Key, typename Value>
+typename PagedTree<Key, Value>::iterator&
+PagedTree<Key, Value>::iterator::operator++()
+{
+    if(current_ != 0){
+        current_ = tree_->successor(current_);
+    }
+    return *this;
+}
+
+/*
+-------------------------------------------------------------
+End implementations for the PagedTree::iterator class.
+-------------------------------------------------------------
+*/
+
+/*
+-----------------------------------------------------
+Begin implementations for the PagedTree class.
+-----------------------------------------------------
+*/
+
+/**
+* Opens the tree stored at path, or creates an empty one, caching at
+* most poolPages pages in memory.
+*/
+template<typename Key, typename Value>
+PagedTree<Key, Value>::PagedTree(const std::string& path, size_t poolPages) :
+    file_(path), pool_(file_, poolPages)
+{
+    static_assert(std::is_trivially_copyable<Key>::value, "paged keys must be trivially copyable");
+    static_assert(std::is_trivially_copyable<Value>::value, "paged values must be trivially copyable");
+    static_assert(sizeof(Record) <= PAGED_PAGE_SIZE, "record does not fit in a page");
+
+    if(file_.pageCount() == 0){
+        std::memset(&meta_, 0, sizeof(meta_));
+        std::memcpy(meta_.magic, PAGED_MAGIC, sizeof(meta_.magic));
+        meta_.keySize = sizeof(Key);
+        meta_.valueSize = sizeof(Value);
+        return;
+    }
+
+    std::memcpy(&meta_, pool_.fetch(0, false), sizeof(meta_));
+    if(std::memcmp(meta_.magic, PAGED_MAGIC, sizeof(meta_.magic)) != 0
+        || meta_.keySize != sizeof(Key) || meta_.valueSize != sizeof(Value)){
+        throw std::runtime_error("Not a paged tree of this type: " + path);
+    }
+}
+
+template<typename Key, typename Value>
+PagedTree<Key, Value>::~PagedTree()
+{
+    try {
+        flush();
+    } catch(...) {
+    }
+}
+
+/**
+* Writes the metadata and every dirty page to disk.
+*/
+template<typename Key, typename Value>
+void PagedTree<Key, Value>::flush()
+{
+    std::memcpy(pool_.fetch(0, true), &meta_, sizeof(meta_));
+    pool_.flush();
+}
+
+template<typename Key, typename Value>
+bool PagedTree<Key, Value>::empty() const
+{
+    return meta_.root == 0;
+}
+
+template<typename Key, typename Value>
+size_t PagedTree<Key, Value>::size() const
+{
+    return meta_.count;
+}
+
+template<typename Key, typename Value>
+const PagedStats& PagedTree<Key, Value>::stats() const
+{
+    return pool_.stats();
+}
+
+template<typename Key, typename Value>
+void PagedTree<Key, Value>::resetStats()
+{
+    pool_.resetStats();
+}
+
+/**
+* Forgets every node. The file keeps its size and the old pages are
+* reused by later inserts.
+*/
+template<typename Key, typename Value>
+void PagedTree<Key, Value>::clear()
+{
+    meta_.root = 0;
+    meta_.freeHead = 0;
+    meta_.count = 0;
+    meta_.nextSlot = 0;
+}
+
+template<typename Key, typename Value>
+typename PagedTree<Key, Value>::iterator
+PagedTree<Key, Value>::begin()
+{
+    return iterator(this, this->getSmallestNode());
+}
+
+template<typename Key, typename Value>
+typename PagedTree<Key, Value>::iterator
+PagedTree<Key, Value>::end()
+{
+    return iterator(this, 0);
+}
+
+template<typename Key, typename Value>
+typename PagedTree<Key, Value>::iterator
+PagedTree<Key, Value>::find(const Key& key)
+{
+    return iterator(this, internalFind(key));
+}
+
+/**
+* Returns a copy of the value associated with the key.
+* Throws std::out_of_range if the key doesn't exist.
+*/
+template<typename Key, typename Value>
+Value PagedTree<Key, Value>::operator[](const Key& key)
+{
+    NodeId id = internalFind(key);
+    if(id == 0) throw std::out_of_range("Invalid key");
+    return record(id, false)->value;
+}
+
+/**
+* Inserts an item, overwriting the value if the key already exists,
+* then restores the AVL property on the way back up.
+*/
+template<typename Key, typename Value>
+void PagedTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    const Key& key = keyValuePair.first;
+    if(meta_.root == 0){
+        meta_.root = allocate(key, keyValuePair.second, 0);
+        return;
+    }
+
+    NodeId curr = meta_.root;
+    NodeId par = 0;
+    bool goLeft = false;
+    while(curr != 0){
+        Record* rec = record(curr, false);
+        par = curr;
+        if(key < rec->key){
+            goLeft = true;
+            curr = rec->left;
+        } else if(rec->key < key){
+            goLeft = false;
+            curr = rec->right;
+        } else {
+            record(curr, true)->value = keyValuePair.second;
+            return;
+        }
+    }
+
+    NodeId newNode = allocate(key, keyValuePair.second, par);
+    if(goLeft){
+        setLeft(par, newNode);
+    } else {
+        setRight(par, newNode);
+    }
+    this->insertFix(newNode);
+}
+
+/**
+* Removes the item with the given key if it exists. A node with two
+* children takes over its predecessor's item, and the predecessor's
+* record is freed instead.
+*/
+template<typename Key, typename Value>
+void PagedTree<Key, Value>::remove(const Key& key)
+{
+    NodeId target = internalFind(key);
+    if(target == 0){
+        return;
+    }
+
+    if(getLeft(target) != 0 && getRight(target) != 0){
+        NodeId pred = getLeft(target);
+        while(getRight(pred) != 0){
+            pred = getRight(pred);
+        }
+        Record copy = *record(pred, false);
+        Record* rec = record(target, true);
+        rec->key = copy.key;
+        rec->value = copy.value;
+        target = pred;
+    }
+
+    this->detach(target);
+    release(target);
+}
+
+/**
+* Returns the record for id from the buffer pool. The pointer is only
+* valid until the next record access.
+*/
+template<typename Key, typename Value>
+typename PagedTree<Key, Value>::Record*
+PagedTree<Key, Value>::record(NodeId id, bool forWrite)
+{
+    uint64_t slot = id - 1;
+    char* page = pool_.fetch(1 + slot / RECORDS_PER_PAGE, forWrite);
+    return reinterpret_cast<Record*>(page) + slot % RECORDS_PER_PAGE;
+}
+
+template<typename Key, typename Value>
+typename PagedTree<Key, Value>::NodeId PagedTree<Key, Value>::getParent(NodeId id)
+{
+    return record(id, false)->parent;
+}
+
+template<typename Key, typename Value>
+typename PagedTree<Key, Value>::NodeId PagedTree<Key, Value>::getLeft(NodeId id)
+{
+    return record(id, false)->left;
+}
+
+template<typename Key, typename Value>
+typename PagedTree<Key, Value>::NodeId PagedTree<Key, Value>::getRight(NodeId id)
+{
+    return record(id, false)->right;
+}
+
+template<typename Key, typename Value>
+int8_t PagedTree<Key, Value>::getBalance(NodeId id)
+{
+    return record(id, false)->balance;
+}
+
+template<typename Key, typename Value>
+void PagedTree<Key, Value>::setParent(NodeId id, NodeId parent)
+{
+    record(id, true)->parent = parent;
+}
+
+template<typename Key, typename Value>
+void PagedTree<Key, Value>::setLeft(NodeId id, NodeId left)
+{
+    record(id, true)->left = left;
+}
+
+template<typename Key, typename Value>
+void PagedTree<Key, Value>::setRight(NodeId id, NodeId right)
+{
+    record(id, true)->right = right;
+}
+
+template<typename Key, typename Value>
+void PagedTree<Key, Value>::setBalance(NodeId id, int8_t balance)
+{
+    record(id, true)->balance = balance;
+}
+
+/**
+* Takes a record from the free list, or the next never-used slot.
+*/
+template<typename Key, typename Value>
+typename PagedTree<Key, Value>::NodeId
+PagedTree<Key, Value>::allocate(const Key& key, const Value& value, NodeId parent)
+{
+    NodeId id;
+    if(meta_.freeHead != 0){
+        id = meta_.freeHead;
+        meta_.freeHead = getLeft(id);
+    } else {
+        id = ++meta_.nextSlot;
+    }
+
+    Record* rec = record(id, true);
+    rec->key = key;
+    rec->value = value;
+    rec->parent = parent;
+    rec->left = 0;
+    rec->right = 0;
+    rec->balance = 0;
+    meta_.count++;
+    return id;
+}
+
+/**
+* Pushes a record onto the free list, which is threaded through left.
+*/
+template<typename Key, typename Value>
+void PagedTree<Key, Value>::release(NodeId id)
+{
+    setLeft(id, meta_.freeHead);
+    meta_.freeHead = id;
+    meta_.count--;
+}
+
+template<typename Key, typename Value>
+typename PagedTree<Key, Value>::NodeId PagedTree<Key, Value>::getRoot() const
+{
+    return meta_.root;
+}
+
+template<typename Key, typename Value>
+void PagedTree<Key, Value>::setRoot(NodeId root)
+{
+    meta_.root = root;
+}
+
+template<typename Key, typename Value>
+typename PagedTree<Key, Value>::NodeId PagedTree<Key, Value>::internalFind(const Key& key)
+{
+    NodeId node = meta_.root;
+    while(node != 0){
+        const Record* rec = record(node, false);
+        if(key < rec->key){
+            node = rec->left;
+        } else if(rec->key < key){
+            node = rec->right;
+        } else {
+            return node;
+        }
+    }
+    return 0;
+}
+
+/*
+---------------------------------------------------
+End implementations for the PagedTree class.
+---------------------------------------------------
+*/
+
+#endif
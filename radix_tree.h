@@ -0,0 +1,1025 @@
+#ifndef RADIX_TREE_H
+#define RADIX_TREE_H
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "avlbst.h"
+
+/**
+* An adaptive radix tree (ART) for integral keys.
+*
+* A key is split into its bytes, most significant first, with the sign
+* bit flipped for signed types, so byte order is key order. Each inner
+* node branches on one byte and comes in four sizes that it grows and
+* shrinks between as children come and go:
+*
+*   Node4 / Node16   sorted byte array plus child array
+*   Node48           256-entry byte-to-slot index plus 48 children
+*   Node256          a child for every byte value
+*
+* Runs of bytes shared by every key below a node are stored once in the
+* node's prefix instead of as a chain of one-child nodes. Keys are at
+* most 8 bytes, so the whole prefix always fits and is compared exactly.
+*
+* Leaves are the std::pair<const Key, Value> items themselves, told apart
+* from inner nodes by a tag in the low bit of the child pointer. Lookups
+* cost at most sizeof(Key) node visits with no key comparisons until the
+* leaf, regardless of the number of keys.
+*
+* The interface is BinarySearchTree's ordered map (insert, remove, find,
+* lower_bound, operator[], in-order iterators). OrderedMap<Key, Value>
+* picks this tree for integral keys and AVLTree for everything else.
+*/
+
+// Longest stored prefix: a node's prefix never covers the last key byte
+#define RADIX_MAX_PREFIX 8
+
+enum RadixNodeType { RADIX_NODE4, RADIX_NODE16, RADIX_NODE48, RADIX_NODE256 };
+
+struct RadixNode
+{
+    uint8_t type;
+    uint8_t prefixLen;
+    uint16_t count;
+    uint8_t prefix[RADIX_MAX_PREFIX];
+};
+
+struct RadixNode4 : RadixNode
+{
+    uint8_t keys[4];
+    RadixNode* children[4];
+};
+
+struct RadixNode16 : RadixNode
+{
+    uint8_t keys[16];
+    RadixNode* children[16];
+};
+
+struct RadixNode48 : RadixNode
+{
+    uint8_t index[256];     // slot + 1 of each byte's child, 0 if none
+    RadixNode* children[48];
+};
+
+struct RadixNode256 : RadixNode
+{
+    RadixNode* children[256];
+};
+
+/**
+* Key-independent operations on inner nodes.
+*
+* A child position (pos) is a slot index in Node4 and Node16 and the
+* byte itself in Node48 and Node256; positions increase with the byte.
+* Growing and shrinking replace the node at *ref and keep nodeBytes, the
+* owner's running total of inner node bytes, up to date.
+*/
+class RadixNodes
+{
+public:
+    static bool isLeaf(const RadixNode* node);
+    static RadixNode* make(int type, size_t& nodeBytes);
+    static void destroy(RadixNode* node, size_t& nodeBytes);
+
+    static int findPos(const RadixNode* node, uint8_t byte);
+    static int lowerPos(const RadixNode* node, uint8_t byte);
+    static int nextPos(const RadixNode* node, int after);
+    static uint8_t byteAt(const RadixNode* node, int pos);
+    static RadixNode** childRef(RadixNode* node, int pos);
+    static RadixNode* childAt(const RadixNode* node, int pos);
+    static RadixNode** findChild(RadixNode* node, uint8_t byte);
+
+    static void addChild(RadixNode** ref, uint8_t byte, RadixNode* child, size_t& nodeBytes);
+    static void removeChild(RadixNode** ref, uint8_t byte, size_t& nodeBytes);
+
+private:
+    static int searchSorted(const uint8_t* keys, unsigned count, uint8_t byte, bool exact);
+    static RadixNode* moveTo(RadixNode* node, int type, size_t& nodeBytes);
+};
+
+/*
+--------------------------------------------------------------
+Begin implementations for the RadixNodes class.
+---------------------------------------------------------------
+*/
+
+inline bool RadixNodes::isLeaf(const RadixNode* node)
+{
+    return (reinterpret_cast<uintptr_t>(node) & 1) != 0;
+}
+
+inline RadixNode* RadixNodes::make(int type, size_t& nodeBytes)
+{
+    RadixNode* node;
+    switch(type){
+    case RADIX_NODE4:
+        node = new RadixNode4();
+        nodeBytes += sizeof(RadixNode4);
+        break;
+    case RADIX_NODE16:
+        node = new RadixNode16();
+        nodeBytes += sizeof(RadixNode16);
+        break;
+    case RADIX_NODE48:
+        node = new RadixNode48();
+        nodeBytes += sizeof(RadixNode48);
+        break;
+    default:
+        node = new RadixNode256();
+        nodeBytes += sizeof(RadixNode256);
+        break;
+    }
+    node->type = static_cast<uint8_t>(type);
+    node->prefixLen = 0;
+    node->count = 0;
+    return node;
+}
+
+inline void RadixNodes::destroy(RadixNode* node, size_t& nodeBytes)
+{
+    switch(node->type){
+    case RADIX_NODE4:
+        delete static_cast<RadixNode4*>(node);
+        nodeBytes -= sizeof(RadixNode4);
+        break;
+    case RADIX_NODE16:
+        delete static_cast<RadixNode16*>(node);
+        nodeBytes -= sizeof(RadixNode16);
+        break;
+    case RADIX_NODE48:
+        delete static_cast<RadixNode48*>(node);
+        nodeBytes -= sizeof(RadixNode48);
+        break;
+    default:
+        delete static_cast<RadixNode256*>(node);
+        nodeBytes -= sizeof(RadixNode256);
+        break;
+    }
+}
+
+/**
+* The slot of byte in a sorted key array (exact), or of the first key
+* not below it (!exact); -1 if there is none. Node16 compares all
+* sixteen bytes at once with SSE2.
+*/
+inline int RadixNodes::searchSorted(const uint8_t* keys, unsigned count, uint8_t byte, bool exact)
+{
+#if defined(__SSE2__)
+    if(count > 4){
+        __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys));
+        unsigned valid = (1u << count) - 1;
+        unsigned mask;
+        if(exact){
+            mask = _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(static_cast<char>(byte))));
+        } else {
+            // unsigned >= through signed compare: flip the top bits first
+            __m128i flip = _mm_set1_epi8(static_cast<char>(0x80));
+            __m128i below = _mm_cmplt_epi8(_mm_xor_si128(group, flip),
+                _mm_xor_si128(_mm_set1_epi8(static_cast<char>(byte)), flip));
+            mask = ~_mm_movemask_epi8(below);
+        }
+        mask &= valid;
+        return mask != 0 ? __builtin_ctz(mask) : -1;
+    }
+#endif
+    for(unsigned i = 0; i < count; ++i){
+        if(keys[i] >= byte){
+            return (keys[i] == byte || !exact) ? static_cast<int>(i) : -1;
+        }
+    }
+    return -1;
+}
+
+/**
+* The position of byte's child, or -1 if it has none.
+*/
+inline int RadixNodes::findPos(const RadixNode* node, uint8_t byte)
+{
+    switch(node->type){
+    case RADIX_NODE4:
+        return searchSorted(static_cast<const RadixNode4*>(node)->keys, node->count, byte, true);
+    case RADIX_NODE16:
+        return searchSorted(static_cast<const RadixNode16*>(node)->keys, node->count, byte, true);
+    case RADIX_NODE48:
+        return static_cast<const RadixNode48*>(node)->index[byte] != 0 ? byte : -1;
+    default:
+        return static_cast<const RadixNode256*>(node)->children[byte] != NULL ? byte : -1;
+    }
+}
+
+/**
+* The position of the first child whose byte is not below byte, or -1.
+*/
+inline int RadixNodes::lowerPos(const RadixNode* node, uint8_t byte)
+{
+    switch(node->type){
+    case RADIX_NODE4:
+        return searchSorted(static_cast<const RadixNode4*>(node)->keys, node->count, byte, false);
+    case RADIX_NODE16:
+        return searchSorted(static_cast<const RadixNode16*>(node)->keys, node->count, byte, false);
+    default:
+        return nextPos(node, static_cast<int>(byte) - 1);
+    }
+}
+
+/**
+* The first child position after after (-1 for the first child), or -1.
+*/
+inline int RadixNodes::nextPos(const RadixNode* node, int after)
+{
+    int pos = after + 1;
+    switch(node->type){
+    case RADIX_NODE4:
+    case RADIX_NODE16:
+        return pos < node->count ? pos : -1;
+    case RADIX_NODE48: {
+        const RadixNode48* n48 = static_cast<const RadixNode48*>(node);
+        for(; pos < 256; ++pos){
+            if(n48->index[pos] != 0){
+                return pos;
+            }
+        }
+        return -1;
+    }
+    default: {
+        const RadixNode256* n256 = static_cast<const RadixNode256*>(node);
+        for(; pos < 256; ++pos){
+            if(n256->children[pos] != NULL){
+                return pos;
+            }
+        }
+        return -1;
+    }
+    }
+}
+
+inline uint8_t RadixNodes::byteAt(const RadixNode* node, int pos)
+{
+    switch(node->type){
+    case RADIX_NODE4:
+        return static_cast<const RadixNode4*>(node)->keys[pos];
+    case RADIX_NODE16:
+        return static_cast<const RadixNode16*>(node)->keys[pos];
+    default:
+        return static_cast<uint8_t>(pos);
+    }
+}
+
+inline RadixNode** RadixNodes::childRef(RadixNode* node, int pos)
+{
+    switch(node->type){
+    case RADIX_NODE4:
+        return &static_cast<RadixNode4*>(node)->children[pos];
+    case RADIX_NODE16:
+        return &static_cast<RadixNode16*>(node)->children[pos];
+    case RADIX_NODE48: {
+        RadixNode48* n48 = static_cast<RadixNode48*>(node);
+        return &n48->children[n48->index[pos] - 1];
+    }
+    default:
+        return &static_cast<RadixNode256*>(node)->children[pos];
+    }
+}
+
+inline RadixNode* RadixNodes::childAt(const RadixNode* node, int pos)
+{
+    return *childRef(const_cast<RadixNode*>(node), pos);
+}
+
+inline RadixNode** RadixNodes::findChild(RadixNode* node, uint8_t byte)
+{
+    int pos = findPos(node, byte);
+    return pos < 0 ? NULL : childRef(node, pos);
+}
+
+/**
+* Copies node's prefix and children into a new node of the given type,
+* frees node and returns the copy.
+*/
+inline RadixNode* RadixNodes::moveTo(RadixNode* node, int type, size_t& nodeBytes)
+{
+    RadixNode* moved = make(type, nodeBytes);
+    moved->prefixLen = node->prefixLen;
+    memcpy(moved->prefix, node->prefix, node->prefixLen);
+    for(int pos = nextPos(node, -1); pos >= 0; pos = nextPos(node, pos)){
+        uint8_t byte = byteAt(node, pos);
+        RadixNode* child = childAt(node, pos);
+        // children arrive in byte order, so sorted nodes just append
+        switch(type){
+        case RADIX_NODE4: {
+            RadixNode4* n4 = static_cast<RadixNode4*>(moved);
+            n4->keys[n4->count] = byte;
+            n4->children[n4->count] = child;
+            break;
+        }
+        case RADIX_NODE16: {
+            RadixNode16* n16 = static_cast<RadixNode16*>(moved);
+            n16->keys[n16->count] = byte;
+            n16->children[n16->count] = child;
+            break;
+        }
+        case RADIX_NODE48: {
+            RadixNode48* n48 = static_cast<RadixNode48*>(moved);
+            n48->children[n48->count] = child;
+            n48->index[byte] = static_cast<uint8_t>(n48->count + 1);
+            break;
+        }
+        default:
+            static_cast<RadixNode256*>(moved)->children[byte] = child;
+            break;
+        }
+        moved->count++;
+    }
+    destroy(node, nodeBytes);
+    return moved;
+}
+
+/**
+* Adds child under byte (which must be free) to the node at *ref,
+* growing it into the next size first if it is full.
+*/
+inline void RadixNodes::addChild(RadixNode** ref, uint8_t byte, RadixNode* child, size_t& nodeBytes)
+{
+    RadixNode* node = *ref;
+    switch(node->type){
+    case RADIX_NODE4:
+    case RADIX_NODE16: {
+        unsigned capacity = node->type == RADIX_NODE4 ? 4 : 16;
+        if(node->count == capacity){
+            *ref = moveTo(node, node->type == RADIX_NODE4 ? RADIX_NODE16 : RADIX_NODE48, nodeBytes);
+            addChild(ref, byte, child, nodeBytes);
+            return;
+        }
+        uint8_t* keys = node->type == RADIX_NODE4 ?
+            static_cast<RadixNode4*>(node)->keys : static_cast<RadixNode16*>(node)->keys;
+        RadixNode** children = node->type == RADIX_NODE4 ?
+            static_cast<RadixNode4*>(node)->children : static_cast<RadixNode16*>(node)->children;
+        unsigned pos = node->count;
+        while(pos > 0 && keys[pos - 1] > byte){
+            keys[pos] = keys[pos - 1];
+            children[pos] = children[pos - 1];
+            pos--;
+        }
+        keys[pos] = byte;
+        children[pos] = child;
+        break;
+    }
+    case RADIX_NODE48: {
+        RadixNode48* n48 = static_cast<RadixNode48*>(node);
+        if(n48->count == 48){
+            *ref = moveTo(node, RADIX_NODE256, nodeBytes);
+            addChild(ref, byte, child, nodeBytes);
+            return;
+        }
+        // removals can leave holes anywhere in the slots
+        unsigned slot = 0;
+        while(n48->children[slot] != NULL){
+            slot++;
+        }
+        n48->children[slot] = child;
+        n48->index[byte] = static_cast<uint8_t>(slot + 1);
+        break;
+    }
+    default:
+        static_cast<RadixNode256*>(node)->children[byte] = child;
+        break;
+    }
+    node->count++;
+}
+
+/**
+* Removes byte's child from the node at *ref. The node shrinks to the
+* next size down once it is well under that size's capacity, and a Node4
+* left with one child is replaced by it, the child's prefix absorbing
+* the node's prefix and byte.
+*/
+inline void RadixNodes::removeChild(RadixNode** ref, uint8_t byte, size_t& nodeBytes)
+{
+    RadixNode* node = *ref;
+    switch(node->type){
+    case RADIX_NODE4:
+    case RADIX_NODE16: {
+        uint8_t* keys = node->type == RADIX_NODE4 ?
+            static_cast<RadixNode4*>(node)->keys : static_cast<RadixNode16*>(node)->keys;
+        RadixNode** children = node->type == RADIX_NODE4 ?
+            static_cast<RadixNode4*>(node)->children : static_cast<RadixNode16*>(node)->children;
+        int pos = findPos(node, byte);
+        for(unsigned i = pos; i + 1 < node->count; ++i){
+            keys[i] = keys[i + 1];
+            children[i] = children[i + 1];
+        }
+        break;
+    }
+    case RADIX_NODE48: {
+        RadixNode48* n48 = static_cast<RadixNode48*>(node);
+        n48->children[n48->index[byte] - 1] = NULL;
+        n48->index[byte] = 0;
+        break;
+    }
+    default:
+        static_cast<RadixNode256*>(node)->children[byte] = NULL;
+        break;
+    }
+    node->count--;
+
+    if(node->type == RADIX_NODE4 && node->count == 1){
+        RadixNode4* n4 = static_cast<RadixNode4*>(node);
+        RadixNode* child = n4->children[0];
+        if(!isLeaf(child)){
+            uint8_t prefix[RADIX_MAX_PREFIX];
+            unsigned len = node->prefixLen;
+            memcpy(prefix, node->prefix, len);
+            prefix[len++] = n4->keys[0];
+            memcpy(prefix + len, child->prefix, child->prefixLen);
+            len += child->prefixLen;
+            memcpy(child->prefix, prefix, len);
+            child->prefixLen = static_cast<uint8_t>(len);
+        }
+        *ref = child;
+        destroy(node, nodeBytes);
+    } else if(node->type == RADIX_NODE16 && node->count == 3){
+        *ref = moveTo(node, RADIX_NODE4, nodeBytes);
+    } else if(node->type == RADIX_NODE48 && node->count == 12){
+        *ref = moveTo(node, RADIX_NODE16, nodeBytes);
+    } else if(node->type == RADIX_NODE256 && node->count == 37){
+        *ref = moveTo(node, RADIX_NODE48, nodeBytes);
+    }
+}
+
+/*
+-------------------------------------------------------------
+End implementations for the RadixNodes class.
+-------------------------------------------------------------
+*/
+
+template <typename Key, typename Value>
+class RadixTree
+{
+    static_assert(std::is_integral<Key>::value && !std::is_same<Key, bool>::value,
+        "RadixTree needs an integral key");
+    static_assert(sizeof(Key) <= RADIX_MAX_PREFIX, "RadixTree keys are at most 8 bytes");
+
+public:
+    typedef std::pair<const Key, Value> Leaf;
+
+    RadixTree();
+    ~RadixTree();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool empty() const;
+    size_t size() const;
+    size_t memoryUsage() const;
+
+    /**
+    * An internal iterator class for traversing the contents of the tree.
+    * It keeps the path from the root, one frame per inner node.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class RadixTree<Key, Value>;
+        void descendLeftmost(const RadixNode* node);
+        void advance();
+
+        struct Frame
+        {
+            const RadixNode* node;
+            int pos;
+        };
+        // every inner node on a path consumes at least one key byte
+        Frame frames_[sizeof(Key)];
+        int depth_;
+        Leaf* leaf_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    static const unsigned KEY_BYTES = sizeof(Key);
+
+    static uint64_t keyBits(const Key& key);
+    static uint8_t keyByte(uint64_t bits, unsigned depth);
+    static unsigned prefixMismatch(const RadixNode* node, uint64_t bits, unsigned depth);
+    static RadixNode* tagLeaf(Leaf* leaf);
+    static Leaf* leafOf(const RadixNode* node);
+    Leaf* lookup(const Key& key) const;
+
+private:
+    RadixTree(const RadixTree<Key, Value>&);
+    RadixTree<Key, Value>& operator=(const RadixTree<Key, Value>&);
+
+    RadixNode* root_;
+    size_t count_;
+    size_t nodeBytes_;
+};
+
+/**
+* OrderedMap<Key, Value>::type is the ordered map engine for Key:
+* RadixTree for integral keys, AVLTree otherwise.
+*/
+template <typename Key, typename Value,
+    bool Radix = std::is_integral<Key>::value && !std::is_same<Key, bool>::value>
+struct OrderedMap
+{
+    typedef AVLTree<Key, Value> type;
+};
+
+template <typename Key, typename Value>
+struct OrderedMap<Key, Value, true>
+{
+    typedef RadixTree<Key, Value> type;
+};
+
+/*
+--------------------------------------------------------------
+Begin implementations for the RadixTree::iterator class.
+---------------------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+RadixTree<Key, Value>::iterator::iterator() :
+    depth_(0), leaf_(NULL)
+{
+
+}
+
+template<typename Key, typename Value>
+std::pair<const Key,Value>& RadixTree<Key, Value>::iterator::operator*() const
+{
+    return *leaf_;
+}
+
+template<typename Key, typename Value>
+std::pair<const Key,Value>* RadixTree<Key, Value>::iterator::operator->() const
+{
+    return leaf_;
+}
+
+template<typename Key, typename Value>
+bool RadixTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return leaf_ == rhs.leaf_;
+}
+
+template<typename Key, typename Value>
+bool RadixTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return leaf_ != rhs.leaf_;
+}
+
+template<typename Key, typename Value>
+typename RadixTree<Key, Value>::iterator&
+RadixTree<Key, Value>::iterator::operator++()
+{
+    advance();
+    return *this;
+}
+
+/**
+* Follows first children down from node to a leaf, recording the path.
+*/
+template<typename Key, typename Value>
+void RadixTree<Key, Value>::iterator::descendLeftmost(const RadixNode* node)
+{
+    while(!RadixNodes::isLeaf(node)){
+        Frame& frame = frames_[depth_++];
+        frame.node = node;
+        frame.pos = RadixNodes::nextPos(node, -1);
+        node = RadixNodes::childAt(node, frame.pos);
+    }
+    leaf_ = leafOf(node);
+}
+
+/**
+* Moves to the leftmost leaf of the next subtree to the right of the
+* deepest recorded position, or to the end.
+*/
+template<typename Key, typename Value>
+void RadixTree<Key, Value>::iterator::advance()
+{
+    while(depth_ > 0){
+        Frame& frame = frames_[depth_ - 1];
+        int pos = RadixNodes::nextPos(frame.node, frame.pos);
+        if(pos >= 0){
+            frame.pos = pos;
+            descendLeftmost(RadixNodes::childAt(frame.node, pos));
+            return;
+        }
+        depth_--;
+    }
+    leaf_ = NULL;
+}
+
+/*
+-------------------------------------------------------------
+End implementations for the RadixTree::iterator class.
+-------------------------------------------------------------
+*/
+
+/*
+-----------------------------------------------------
+Begin implementations for the RadixTree class.
+-----------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+RadixTree<Key, Value>::RadixTree() :
+    root_(NULL), count_(0), nodeBytes_(0)
+{
+
+}
+
+template<typename Key, typename Value>
+RadixTree<Key, Value>::~RadixTree()
+{
+    clear();
+}
+
+/**
+* Frees every leaf and inner node, taking them from an explicit stack that
+* each inner node pushes its children onto before it is destroyed.
+*/
+template<typename Key, typename Value>
+void RadixTree<Key, Value>::clear()
+{
+    std::vector<RadixNode*> nodes;
+    if(root_ != NULL){
+        nodes.push_back(root_);
+    }
+    while(!nodes.empty()){
+        RadixNode* node = nodes.back();
+        nodes.pop_back();
+        if(RadixNodes::isLeaf(node)){
+            delete leafOf(node);
+            continue;
+        }
+        for(int pos = RadixNodes::nextPos(node, -1); pos >= 0; pos = RadixNodes::nextPos(node, pos)){
+            nodes.push_back(RadixNodes::childAt(node, pos));
+        }
+        RadixNodes::destroy(node, nodeBytes_);
+    }
+    root_ = NULL;
+    count_ = 0;
+}
+
+template<typename Key, typename Value>
+bool RadixTree<Key, Value>::empty() const
+{
+    return root_ == NULL;
+}
+
+template<typename Key, typename Value>
+size_t RadixTree<Key, Value>::size() const
+{
+    return count_;
+}
+
+/**
+* Bytes held by inner nodes and leaves.
+*/
+template<typename Key, typename Value>
+size_t RadixTree<Key, Value>::memoryUsage() const
+{
+    return nodeBytes_ + count_ * sizeof(Leaf) + sizeof(*this);
+}
+
+template<typename Key, typename Value>
+typename RadixTree<Key, Value>::iterator
+RadixTree<Key, Value>::begin() const
+{
+    iterator it;
+    if(root_ != NULL){
+        it.descendLeftmost(root_);
+    }
+    return it;
+}
+
+template<typename Key, typename Value>
+typename RadixTree<Key, Value>::iterator
+RadixTree<Key, Value>::end() const
+{
+    return iterator();
+}
+
+template<typename Key, typename Value>
+typename RadixTree<Key, Value>::iterator
+RadixTree<Key, Value>::find(const Key& key) const
+{
+    uint64_t bits = keyBits(key);
+    iterator it;
+    const RadixNode* node = root_;
+    unsigned depth = 0;
+    while(node != NULL && !RadixNodes::isLeaf(node)){
+        if(prefixMismatch(node, bits, depth) < node->prefixLen){
+            return end();
+        }
+        depth += node->prefixLen;
+        int pos = RadixNodes::findPos(node, keyByte(bits, depth));
+        if(pos < 0){
+            return end();
+        }
+        typename iterator::Frame& frame = it.frames_[it.depth_++];
+        frame.node = node;
+        frame.pos = pos;
+        node = RadixNodes::childAt(node, pos);
+        depth++;
+    }
+    if(node == NULL || !(leafOf(node)->first == key)){
+        return end();
+    }
+    it.leaf_ = leafOf(node);
+    return it;
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key,
+* or the end iterator if there is none.
+*/
+template<typename Key, typename Value>
+typename RadixTree<Key, Value>::iterator
+RadixTree<Key, Value>::lower_bound(const Key& key) const
+{
+    uint64_t bits = keyBits(key);
+    iterator it;
+    const RadixNode* node = root_;
+    unsigned depth = 0;
+    if(node == NULL){
+        return it;
+    }
+    while(!RadixNodes::isLeaf(node)){
+        unsigned mismatch = prefixMismatch(node, bits, depth);
+        if(mismatch < node->prefixLen){
+            // the whole subtree is either above or below key
+            if(node->prefix[mismatch] > keyByte(bits, depth + mismatch)){
+                it.descendLeftmost(node);
+            } else {
+                it.advance();
+            }
+            return it;
+        }
+        depth += node->prefixLen;
+        uint8_t byte = keyByte(bits, depth);
+        int pos = RadixNodes::lowerPos(node, byte);
+        if(pos < 0){
+            it.advance();
+            return it;
+        }
+        typename iterator::Frame& frame = it.frames_[it.depth_++];
+        frame.node = node;
+        frame.pos = pos;
+        node = RadixNodes::childAt(node, pos);
+        if(RadixNodes::byteAt(frame.node, pos) > byte){
+            it.descendLeftmost(node);
+            return it;
+        }
+        depth++;
+    }
+    if(leafOf(node)->first < key){
+        it.advance();
+    } else {
+        it.leaf_ = leafOf(node);
+    }
+    return it;
+}
+
+/**
+* @precondition The key exists in the map
+* Returns the value associated with the key
+*/
+template<typename Key, typename Value>
+Value& RadixTree<Key, Value>::operator[](const Key& key)
+{
+    Leaf* leaf = lookup(key);
+    if(leaf == NULL) throw std::out_of_range("Invalid key");
+    return leaf->second;
+}
+
+template<typename Key, typename Value>
+Value const & RadixTree<Key, Value>::operator[](const Key& key) const
+{
+    Leaf* leaf = lookup(key);
+    if(leaf == NULL) throw std::out_of_range("Invalid key");
+    return leaf->second;
+}
+
+/**
+* Descends by key bytes to key's leaf. A leaf met on the way is the only
+* candidate; a mismatched prefix or missing child ends the search early.
+* If key is already in the tree its value is overwritten.
+*/
+template<typename Key, typename Value>
+void RadixTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    const Key& key = keyValuePair.first;
+    uint64_t bits = keyBits(key);
+    RadixNode** ref = &root_;
+    unsigned depth = 0;
+
+    while(*ref != NULL){
+        RadixNode* node = *ref;
+        if(RadixNodes::isLeaf(node)){
+            Leaf* leaf = leafOf(node);
+            if(leaf->first == key){
+                leaf->second = keyValuePair.second;
+                return;
+            }
+            // the two keys share every byte above depth; branch where they part
+            uint64_t other = keyBits(leaf->first);
+            RadixNode* split = RadixNodes::make(RADIX_NODE4, nodeBytes_);
+            unsigned len = 0;
+            while(keyByte(bits, depth + len) == keyByte(other, depth + len)){
+                split->prefix[len] = keyByte(bits, depth + len);
+                len++;
+            }
+            split->prefixLen = static_cast<uint8_t>(len);
+            RadixNodes::addChild(&split, keyByte(other, depth + len), node, nodeBytes_);
+            RadixNodes::addChild(&split, keyByte(bits, depth + len), tagLeaf(new Leaf(keyValuePair)), nodeBytes_);
+            *ref = split;
+            count_++;
+            return;
+        }
+
+        unsigned mismatch = prefixMismatch(node, bits, depth);
+        if(mismatch < node->prefixLen){
+            // split the prefix: a new node takes the shared part
+            RadixNode* split = RadixNodes::make(RADIX_NODE4, nodeBytes_);
+            split->prefixLen = static_cast<uint8_t>(mismatch);
+            memcpy(split->prefix, node->prefix, mismatch);
+            uint8_t nodeByte = node->prefix[mismatch];
+            node->prefixLen = static_cast<uint8_t>(node->prefixLen - mismatch - 1);
+            memmove(node->prefix, node->prefix + mismatch + 1, node->prefixLen);
+            RadixNodes::addChild(&split, nodeByte, node, nodeBytes_);
+            RadixNodes::addChild(&split, keyByte(bits, depth + mismatch), tagLeaf(new Leaf(keyValuePair)), nodeBytes_);
+            *ref = split;
+            count_++;
+            return;
+        }
+
+        depth += node->prefixLen;
+        uint8_t byte = keyByte(bits, depth);
+        RadixNode** child = RadixNodes::findChild(node, byte);
+        if(child == NULL){
+            RadixNodes::addChild(ref, byte, tagLeaf(new Leaf(keyValuePair)), nodeBytes_);
+            count_++;
+            return;
+        }
+        ref = child;
+        depth++;
+    }
+
+    *ref = tagLeaf(new Leaf(keyValuePair));
+    count_++;
+}
+
+/**
+* Removes key's leaf; its parent shrinks or is replaced by its last
+* remaining child as needed.
+*/
+template<typename Key, typename Value>
+void RadixTree<Key, Value>::remove(const Key& key)
+{
+    uint64_t bits = keyBits(key);
+    RadixNode** ref = &root_;
+    RadixNode** parentRef = NULL;
+    uint8_t parentByte = 0;
+    unsigned depth = 0;
+
+    while(*ref != NULL){
+        RadixNode* node = *ref;
+        if(RadixNodes::isLeaf(node)){
+            Leaf* leaf = leafOf(node);
+            if(!(leaf->first == key)){
+                return;
+            }
+            if(parentRef == NULL){
+                root_ = NULL;
+            } else {
+                RadixNodes::removeChild(parentRef, parentByte, nodeBytes_);
+            }
+            delete leaf;
+            count_--;
+            return;
+        }
+        if(prefixMismatch(node, bits, depth) < node->prefixLen){
+            return;
+        }
+        depth += node->prefixLen;
+        uint8_t byte = keyByte(bits, depth);
+        RadixNode** child = RadixNodes::findChild(node, byte);
+        if(child == NULL){
+            return;
+        }
+        parentRef = ref;
+        parentByte = byte;
+        ref = child;
+        depth++;
+    }
+}
+
+/**
+* The key as an unsigned number whose bytes, most significant first,
+* sort the same way as the keys.
+*/
+template<typename Key, typename Value>
+uint64_t RadixTree<Key, Value>::keyBits(const Key& key)
+{
+    typedef typename std::make_unsigned<Key>::type Unsigned;
+    uint64_t bits = static_cast<Unsigned>(key);
+    if(std::is_signed<Key>::value){
+        bits ^= uint64_t(1) << (8 * KEY_BYTES - 1);
+    }
+    return bits;
+}
+
+template<typename Key, typename Value>
+uint8_t RadixTree<Key, Value>::keyByte(uint64_t bits, unsigned depth)
+{
+    return static_cast<uint8_t>(bits >> (8 * (KEY_BYTES - 1 - depth)));
+}
+
+/**
+* The number of leading prefix bytes of node that match the key's bytes
+* from depth on.
+*/
+template<typename Key, typename Value>
+unsigned RadixTree<Key, Value>::prefixMismatch(const RadixNode* node, uint64_t bits, unsigned depth)
+{
+    unsigned i = 0;
+    while(i < node->prefixLen && node->prefix[i] == keyByte(bits, depth + i)){
+        i++;
+    }
+    return i;
+}
+
+template<typename Key, typename Value>
+RadixNode* RadixTree<Key, Value>::tagLeaf(Leaf* leaf)
+{
+    return reinterpret_cast<RadixNode*>(reinterpret_cast<uintptr_t>(leaf) | 1);
+}
+
+template<typename Key, typename Value>
+typename RadixTree<Key, Value>::Leaf* RadixTree<Key, Value>::leafOf(const RadixNode* node)
+{
+    return reinterpret_cast<Leaf*>(reinterpret_cast<uintptr_t>(node) & ~uintptr_t(1));
+}
+
+/**
+* find() without the iterator path, for operator[].
+*/
+template<typename Key, typename Value>
+typename RadixTree<Key, Value>::Leaf* RadixTree<Key, Value>::lookup(const Key& key) const
+{
+    uint64_t bits = keyBits(key);
+    const RadixNode* node = root_;
+    unsigned depth = 0;
+    while(node != NULL && !RadixNodes::isLeaf(node)){
+        if(prefixMismatch(node, bits, depth) < node->prefixLen){
+            return NULL;
+        }
+        depth += node->prefixLen;
+        int pos = RadixNodes::findPos(node, keyByte(bits, depth));
+        if(pos < 0){
+            return NULL;
+        }
+        node = RadixNodes::childAt(node, pos);
+        depth++;
+    }
+    if(node == NULL || !(leafOf(node)->first == key)){
+        return NULL;
+    }
+    return leafOf(node);
+}
+
+/*
+---------------------------------------------------
+End implementations for the RadixTree class.
+---------------------------------------------------
+*/
+
+#endif
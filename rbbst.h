@@ -0,0 +1,570 @@
+#ifndef RBBST_H
+#define RBBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include "bst.h"
+
+enum RBColor { RB_BLACK = 0, RB_RED = 1 };
+
+/**
+* A node for a red-black tree, which adds the node's color to a Node.
+*/
+template <typename Key, typename Value>
+class RBNode : public Node<Key, Value>
+{
+public:
+    // Constructor/destructor. New nodes are red.
+    RBNode(const Key& key, const Value& value, RBNode<Key, Value>* parent);
+    virtual ~RBNode();
+
+    // Getter/setter for the node's color.
+    RBColor getColor() const;
+    void setColor(RBColor color);
+    bool isRed() const;
+
+    // Getters for parent, left, and right, returning RBNodes.
+    virtual RBNode<Key, Value>* getParent() const override;
+    virtual RBNode<Key, Value>* getLeft() const override;
+    virtual RBNode<Key, Value>* getRight() const override;
+
+protected:
+    uint8_t color_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the RBNode class.
+  -------------------------------------------------
+*/
+
+/**
+* An explicit constructor to initialize the elements by calling the base class constructor
+*/
+template<class Key, class Value>
+RBNode<Key, Value>::RBNode(const Key& key, const Value& value, RBNode<Key, Value>* parent) :
+    Node<Key, Value>(key, value, parent), color_(RB_RED)
+{
+
+}
+
+/**
+* A destructor which does nothing.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>::~RBNode()
+{
+
+}
+
+template<class Key, class Value>
+RBColor RBNode<Key, Value>::getColor() const
+{
+    return static_cast<RBColor>(color_);
+}
+
+template<class Key, class Value>
+void RBNode<Key, Value>::setColor(RBColor color)
+{
+    color_ = static_cast<uint8_t>(color);
+}
+
+template<class Key, class Value>
+bool RBNode<Key, Value>::isRed() const
+{
+    return color_ == RB_RED;
+}
+
+/**
+* An overridden function for getting the parent since a static_cast is necessary to make sure
+* that our node is a RBNode.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>* RBNode<Key, Value>::getParent() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->parent_);
+}
+
+/**
+* Overridden for the same reasons as above.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>* RBNode<Key, Value>::getLeft() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->left_);
+}
+
+/**
+* Overridden for the same reasons as above.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>* RBNode<Key, Value>::getRight() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->right_);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the RBNode class.
+  -----------------------------------------------
+*/
+
+/**
+* A red-black tree. Each insert does at most two rotations and each
+* remove at most three, against O(log n) for AVLTree in the worst case,
+* at the cost of a somewhat taller tree (at most 2 log2(n + 1)).
+*/
+template <class Key, class Value>
+class RBTree : public BinarySearchTree<Key, Value>
+{
+public:
+    RBTree();
+    RBTree(const RBTree<Key, Value>& other);
+    RBTree(RBTree<Key, Value>&& other);
+    RBTree<Key, Value>& operator=(const RBTree<Key, Value>& other);
+    RBTree<Key, Value>& operator=(RBTree<Key, Value>&& other);
+
+    using BinarySearchTree<Key, Value>::insert;
+    virtual void insert(const std::pair<const Key, Value>& new_item);
+    virtual void remove(const Key& key);
+protected:
+    virtual void nodeSwap(RBNode<Key,Value>* n1, RBNode<Key,Value>* n2);
+    virtual Node<Key, Value>* cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const override;
+    virtual Node<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent) const override;
+    virtual void setBuiltBalance(Node<Key, Value>* node, int leftHeight, int rightHeight) const override;
+    virtual Node<Key, Value>* linkNode(Node<Key, Value>* node) override;
+    virtual void unlinkNode(Node<Key, Value>* node) override;
+    virtual bool acceptsNode(const Node<Key, Value>* node) const override;
+
+    void insertFix(RBNode<Key, Value>* node);
+    void removeFix(RBNode<Key, Value>* par, bool removedLeft);
+    static bool isRed(const RBNode<Key, Value>* node);
+
+    void rotateLeft(RBNode<Key,Value>* pivot);
+    void rotateRight(RBNode<Key,Value>* pivot);
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the RBTree class.
+  -----------------------------------------------
+*/
+
+template<class Key, class Value>
+RBTree<Key, Value>::RBTree() : BinarySearchTree<Key, Value>()
+{
+
+}
+
+/**
+* Copy constructor. As with AVLTree, the clone is done here where
+* cloneNode() resolves to the RBTree version.
+*/
+template<class Key, class Value>
+RBTree<Key, Value>::RBTree(const RBTree<Key, Value>& other) : BinarySearchTree<Key, Value>()
+{
+    this->cloneFrom(other);
+}
+
+template<class Key, class Value>
+RBTree<Key, Value>::RBTree(RBTree<Key, Value>&& other) :
+    BinarySearchTree<Key, Value>(std::move(other))
+{
+
+}
+
+template<class Key, class Value>
+RBTree<Key, Value>& RBTree<Key, Value>::operator=(const RBTree<Key, Value>& other)
+{
+    BinarySearchTree<Key, Value>::operator=(other);
+    return *this;
+}
+
+template<class Key, class Value>
+RBTree<Key, Value>& RBTree<Key, Value>::operator=(RBTree<Key, Value>&& other)
+{
+    BinarySearchTree<Key, Value>::operator=(std::move(other));
+    return *this;
+}
+
+/**
+* Inserts as in a plain BST, coloring the new node red, then repairs any
+* red node with a red parent. If key is already in the tree its value is
+* overwritten.
+*/
+template<class Key, class Value>
+void RBTree<Key, Value>::insert(const std::pair<const Key, Value>& new_item)
+{
+    const Key& key = new_item.first;
+    const Value& value = new_item.second;
+
+    if(this->root_ == nullptr){
+        RBNode<Key, Value>* root = new RBNode<Key, Value>(key, value, nullptr);
+        root->setColor(RB_BLACK);
+        this->root_ = root;
+        this->noteInserted(root);
+        return;
+    }
+
+    Node<Key, Value>* curr = this->root_;
+    Node<Key, Value>* par = nullptr;
+    typename BinarySearchTree<Key, Value>::KeyCache cache = KeyTraits<Key>::makeCache(key);
+    int cmp = 0;
+
+    while(curr != nullptr){
+        par = curr;
+        cmp = this->compareToNode(key, cache, curr);
+        if(cmp < 0){
+            curr = curr->getLeft();
+        } else if(cmp > 0){
+            curr = curr->getRight();
+        } else {
+            curr->setValue(value);
+            return;
+        }
+    }
+
+    RBNode<Key, Value>* rbPar = static_cast<RBNode<Key, Value>*>(par);
+    RBNode<Key, Value>* newNode = new RBNode<Key, Value>(key, value, rbPar);
+    if(cmp < 0){
+        par->setLeft(newNode);
+    } else {
+        par->setRight(newNode);
+    }
+    this->noteInserted(newNode);
+    insertFix(newNode);
+}
+
+/*
+ * As in AVLTree, a node with two children is first swapped with its
+ * predecessor, leaving a node with at most one child to unlink.
+ */
+template<class Key, class Value>
+void RBTree<Key, Value>::remove(const Key& key)
+{
+    RBNode<Key, Value>* target = static_cast<RBNode<Key, Value>*>(this->internalFind(key));
+    if(target == nullptr){
+        return;
+    }
+    RBTree<Key, Value>::unlinkNode(target);
+    this->destroyNode(target);
+}
+
+/**
+* Takes node out of the tree without freeing it, recoloring and rotating
+* as remove() does.
+*/
+template<class Key, class Value>
+void RBTree<Key, Value>::unlinkNode(Node<Key, Value>* node)
+{
+    RBNode<Key, Value>* target = static_cast<RBNode<Key, Value>*>(node);
+    this->noteRemoving(target);
+
+    if(target->getLeft() != nullptr && target->getRight() != nullptr){
+        RBNode<Key, Value>* pred = static_cast<RBNode<Key, Value>*>(this->predecessor(target));
+        nodeSwap(target, pred);
+    }
+
+    RBNode<Key, Value>* par = target->getParent();
+    RBNode<Key, Value>* child = target->getLeft();
+    if(child == nullptr){
+        child = target->getRight();
+    }
+
+    if(child != nullptr){
+        child->setParent(par);
+    }
+
+    bool removedLeft = false;
+    if(par == nullptr){
+        this->root_ = child;
+    } else if(target == par->getLeft()){
+        par->setLeft(child);
+        removedLeft = true;
+    } else {
+        par->setRight(child);
+    }
+
+    if(target->isRed()){
+        return;
+    }
+    if(child != nullptr && child->isRed()){
+        // the red child takes over the removed node's black
+        child->setColor(RB_BLACK);
+    } else if(par != nullptr){
+        removeFix(par, removedLeft);
+    }
+}
+
+/**
+* Links an unlinked RBNode in as insert() would have created it, so its
+* old color is discarded.
+*/
+template<class Key, class Value>
+Node<Key, Value>* RBTree<Key, Value>::linkNode(Node<Key, Value>* node)
+{
+    int cmp;
+    size_t depth;
+    Node<Key, Value>* par = this->findSlot(node->getKey(), cmp, depth);
+    if(par != nullptr && cmp == 0){
+        return par;
+    }
+    RBNode<Key, Value>* rbNode = static_cast<RBNode<Key, Value>*>(node);
+    this->attachNode(rbNode, par, cmp);
+    this->noteInserted(rbNode);
+    if(par == nullptr){
+        rbNode->setColor(RB_BLACK);
+    } else {
+        rbNode->setColor(RB_RED);
+        insertFix(rbNode);
+    }
+    return node;
+}
+
+template<class Key, class Value>
+bool RBTree<Key, Value>::acceptsNode(const Node<Key, Value>* node) const
+{
+    return typeid(*node) == typeid(RBNode<Key, Value>);
+}
+
+/**
+* Swaps two nodes' positions and colors, so each position keeps its color.
+*/
+template<class Key, class Value>
+void RBTree<Key, Value>::nodeSwap(RBNode<Key,Value>* n1, RBNode<Key,Value>* n2)
+{
+    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
+    RBColor tempC = n1->getColor();
+    n1->setColor(n2->getColor());
+    n2->setColor(tempC);
+}
+
+/**
+* Copies a node as an RBNode, keeping its color.
+*/
+template<class Key, class Value>
+Node<Key, Value>* RBTree<Key, Value>::cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const
+{
+    RBNode<Key, Value>* copy = new RBNode<Key, Value>(src->getKey(), src->getValue(),
+        static_cast<RBNode<Key, Value>*>(parent));
+    copy->setColor(static_cast<const RBNode<Key, Value>*>(src)->getColor());
+    return copy;
+}
+
+template<class Key, class Value>
+Node<Key, Value>* RBTree<Key, Value>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent) const
+{
+    return new RBNode<Key, Value>(key, value, static_cast<RBNode<Key, Value>*>(parent));
+}
+
+/**
+* Colors a bulk-built (height balanced) subtree. With rank(x) =
+* ceil(height(x) / 2), a child is red exactly when its rank equals its
+* parent's: sibling heights differ by at most one, so no red node gets a
+* red child and every path from a node to a leaf crosses the same number
+* of black nodes. The node itself is black until its own parent says
+* otherwise, which leaves the root black.
+*/
+template<class Key, class Value>
+void RBTree<Key, Value>::setBuiltBalance(Node<Key, Value>* node, int leftHeight, int rightHeight) const
+{
+    RBNode<Key, Value>* rbNode = static_cast<RBNode<Key, Value>*>(node);
+    int height = 1 + (leftHeight > rightHeight ? leftHeight : rightHeight);
+    int rank = (height + 1) / 2;
+
+    rbNode->setColor(RB_BLACK);
+    if(rbNode->getLeft() != nullptr){
+        rbNode->getLeft()->setColor((leftHeight + 1) / 2 == rank ? RB_RED : RB_BLACK);
+    }
+    if(rbNode->getRight() != nullptr){
+        rbNode->getRight()->setColor((rightHeight + 1) / 2 == rank ? RB_RED : RB_BLACK);
+    }
+}
+
+template<class Key, class Value>
+bool RBTree<Key, Value>::isRed(const RBNode<Key, Value>* node)
+{
+    return node != nullptr && node->isRed();
+}
+
+/**
+* Restores the red-black properties after node (red) was linked in.
+* Red uncles are handled by recoloring and moving up; a black uncle ends
+* the repair with one or two rotations.
+*/
+template<class Key, class Value>
+void RBTree<Key, Value>::insertFix(RBNode<Key, Value>* node)
+{
+    while(isRed(node->getParent())){
+        RBNode<Key, Value>* par = node->getParent();
+        RBNode<Key, Value>* grand = par->getParent();   // exists: the root is black
+
+        if(par == grand->getLeft()){
+            RBNode<Key, Value>* uncle = grand->getRight();
+            if(isRed(uncle)){
+                par->setColor(RB_BLACK);
+                uncle->setColor(RB_BLACK);
+                grand->setColor(RB_RED);
+                node = grand;
+                continue;
+            }
+            if(node == par->getRight()){
+                rotateLeft(par);
+                par = node;
+            }
+            par->setColor(RB_BLACK);
+            grand->setColor(RB_RED);
+            rotateRight(grand);
+        } else {
+            RBNode<Key, Value>* uncle = grand->getLeft();
+            if(isRed(uncle)){
+                par->setColor(RB_BLACK);
+                uncle->setColor(RB_BLACK);
+                grand->setColor(RB_RED);
+                node = grand;
+                continue;
+            }
+            if(node == par->getLeft()){
+                rotateRight(par);
+                par = node;
+            }
+            par->setColor(RB_BLACK);
+            grand->setColor(RB_RED);
+            rotateLeft(grand);
+        }
+        break;
+    }
+    static_cast<RBNode<Key, Value>*>(this->root_)->setColor(RB_BLACK);
+}
+
+/**
+* Repairs a missing black on par's left (removedLeft) or right side,
+* where a black node was unlinked. The deficient child may be null, so
+* it is tracked by its parent and side rather than by pointer.
+*/
+template<class Key, class Value>
+void RBTree<Key, Value>::removeFix(RBNode<Key, Value>* par, bool removedLeft)
+{
+    RBNode<Key, Value>* node = removedLeft ? par->getLeft() : par->getRight();
+
+    while(par != nullptr && !isRed(node)){
+        if(removedLeft){
+            RBNode<Key, Value>* sibling = par->getRight();
+            if(sibling->isRed()){
+                sibling->setColor(RB_BLACK);
+                par->setColor(RB_RED);
+                rotateLeft(par);
+                sibling = par->getRight();
+            }
+            if(!isRed(sibling->getLeft()) && !isRed(sibling->getRight())){
+                sibling->setColor(RB_RED);
+                node = par;
+            } else {
+                if(!isRed(sibling->getRight())){
+                    sibling->getLeft()->setColor(RB_BLACK);
+                    sibling->setColor(RB_RED);
+                    rotateRight(sibling);
+                    sibling = par->getRight();
+                }
+                sibling->setColor(par->getColor());
+                par->setColor(RB_BLACK);
+                sibling->getRight()->setColor(RB_BLACK);
+                rotateLeft(par);
+                node = static_cast<RBNode<Key, Value>*>(this->root_);
+                break;
+            }
+        } else {
+            RBNode<Key, Value>* sibling = par->getLeft();
+            if(sibling->isRed()){
+                sibling->setColor(RB_BLACK);
+                par->setColor(RB_RED);
+                rotateRight(par);
+                sibling = par->getLeft();
+            }
+            if(!isRed(sibling->getLeft()) && !isRed(sibling->getRight())){
+                sibling->setColor(RB_RED);
+                node = par;
+            } else {
+                if(!isRed(sibling->getLeft())){
+                    sibling->getRight()->setColor(RB_BLACK);
+                    sibling->setColor(RB_RED);
+                    rotateLeft(sibling);
+                    sibling = par->getLeft();
+                }
+                sibling->setColor(par->getColor());
+                par->setColor(RB_BLACK);
+                sibling->getLeft()->setColor(RB_BLACK);
+                rotateRight(par);
+                node = static_cast<RBNode<Key, Value>*>(this->root_);
+                break;
+            }
+        }
+        par = node->getParent();
+        if(par != nullptr){
+            removedLeft = (node == par->getLeft());
+        }
+    }
+    if(node != nullptr){
+        node->setColor(RB_BLACK);
+    }
+}
+
+template<class Key, class Value>
+void RBTree<Key, Value>::rotateLeft(RBNode<Key, Value>* pivot)
+{
+    RBNode<Key, Value>* newRoot = pivot->getRight();
+    RBNode<Key, Value>* newSubtree = newRoot->getLeft();
+    RBNode<Key, Value>* par = pivot->getParent();
+
+    newRoot->setParent(par);
+    if(par == nullptr){
+        this->root_ = newRoot;
+    } else if(pivot == par->getLeft()){
+        par->setLeft(newRoot);
+    } else {
+        par->setRight(newRoot);
+    }
+
+    newRoot->setLeft(pivot);
+    pivot->setParent(newRoot);
+
+    pivot->setRight(newSubtree);
+    if(newSubtree != nullptr){
+        newSubtree->setParent(pivot);
+    }
+}
+
+template<class Key, class Value>
+void RBTree<Key, Value>::rotateRight(RBNode<Key, Value>* pivot)
+{
+    RBNode<Key, Value>* newRoot = pivot->getLeft();
+    RBNode<Key, Value>* newSubtree = newRoot->getRight();
+    RBNode<Key, Value>* par = pivot->getParent();
+
+    newRoot->setParent(par);
+    if(par == nullptr){
+        this->root_ = newRoot;
+    } else if(pivot == par->getLeft()){
+        par->setLeft(newRoot);
+    } else {
+        par->setRight(newRoot);
+    }
+
+    newRoot->setRight(pivot);
+    pivot->setParent(newRoot);
+
+    pivot->setLeft(newSubtree);
+    if(newSubtree != nullptr){
+        newSubtree->setParent(pivot);
+    }
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the RBTree class.
+  -----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,465 @@
+#ifndef SCAPEGOATBST_H
+#define SCAPEGOATBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include "bst.h"
+
+struct ScapegoatStats
+{
+    uint64_t updates;           // inserts and removes that changed the tree
+    uint64_t rebuilds;
+    uint64_t rebuiltNodes;      // total size of all rebuilt subtrees
+
+    double nodesPerUpdate() const
+    {
+        return updates == 0 ? 0.0 : static_cast<double>(rebuiltNodes) / updates;
+    }
+};
+
+/**
+* A scapegoat tree: a BinarySearchTree of plain Nodes that keeps its
+* height within log base 1/alpha of its size using only two tree-wide
+* counters, the current size and the largest size since the last full
+* rebuild.
+*
+* An insert that lands too deep walks back up to the first ancestor whose
+* child on the path holds more than alpha of its keys (the scapegoat) and
+* rebuilds that subtree into perfect balance. Removes rebuild the whole
+* tree once the size drops below alpha of the recorded maximum. Rebuilds
+* relink the existing nodes in linear time and allocate nothing but a
+* pointer array. Updates are O(log n) amortized.
+*/
+template <class Key, class Value>
+class ScapegoatTree : public BinarySearchTree<Key, Value>
+{
+public:
+    explicit ScapegoatTree(double alpha = 0.7);
+    ScapegoatTree(const ScapegoatTree<Key, Value>& other);
+    ScapegoatTree(ScapegoatTree<Key, Value>&& other);
+    ScapegoatTree<Key, Value>& operator=(const ScapegoatTree<Key, Value>& other);
+    ScapegoatTree<Key, Value>& operator=(ScapegoatTree<Key, Value>&& other);
+
+    using BinarySearchTree<Key, Value>::insert;
+    virtual void insert(const std::pair<const Key, Value>& new_item);
+    virtual void remove(const Key& key);
+
+    const ScapegoatStats& stats() const;
+
+protected:
+    static size_t subtreeSize(const Node<Key, Value>* root);
+    static int subtreeDepth(const Node<Key, Value>* root);
+    void rebuild(Node<Key, Value>* root, size_t size);
+    static Node<Key, Value>* linkBalanced(std::vector<Node<Key, Value>*>& nodes,
+        size_t lo, size_t hi, Node<Key, Value>* parent);
+    void setMaxCount(size_t maxCount);
+    void rebuildAbove(Node<Key, Value>* node);
+    virtual void bulkChanged() override;
+    virtual Node<Key, Value>* linkNode(Node<Key, Value>* node) override;
+    virtual void unlinkNode(Node<Key, Value>* node) override;
+
+private:
+    double alpha_;
+    size_t maxCount_;
+    int maxDepth_;      // floor(log base 1/alpha of maxCount_)
+    ScapegoatStats stats_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the ScapegoatTree class.
+  -----------------------------------------------
+*/
+
+/**
+* alpha must be in (0.5, 1): smaller keeps the tree flatter at the cost
+* of more frequent rebuilds.
+*/
+template<class Key, class Value>
+ScapegoatTree<Key, Value>::ScapegoatTree(double alpha) :
+    BinarySearchTree<Key, Value>(), alpha_(alpha), maxCount_(0), maxDepth_(0)
+{
+    if(alpha_ <= 0.5 || alpha_ >= 1.0){
+        throw std::invalid_argument("alpha must be in (0.5, 1)");
+    }
+    stats_.updates = 0;
+    stats_.rebuilds = 0;
+    stats_.rebuiltNodes = 0;
+}
+
+template<class Key, class Value>
+ScapegoatTree<Key, Value>::ScapegoatTree(const ScapegoatTree<Key, Value>& other) :
+    BinarySearchTree<Key, Value>(other), alpha_(other.alpha_),
+    maxCount_(other.maxCount_), maxDepth_(other.maxDepth_), stats_(other.stats_)
+{
+
+}
+
+template<class Key, class Value>
+ScapegoatTree<Key, Value>::ScapegoatTree(ScapegoatTree<Key, Value>&& other) :
+    BinarySearchTree<Key, Value>(std::move(other)), alpha_(other.alpha_),
+    maxCount_(other.maxCount_), maxDepth_(other.maxDepth_), stats_(other.stats_)
+{
+    other.setMaxCount(0);
+}
+
+template<class Key, class Value>
+ScapegoatTree<Key, Value>& ScapegoatTree<Key, Value>::operator=(const ScapegoatTree<Key, Value>& other)
+{
+    if(this != &other){
+        // bulkChanged() sets the size bounds during the copy, so they must
+        // come from the new alpha; a failed copy leaves alpha as it was
+        double previous = alpha_;
+        alpha_ = other.alpha_;
+        try {
+            BinarySearchTree<Key, Value>::operator=(other);
+        } catch(...) {
+            alpha_ = previous;
+            throw;
+        }
+        stats_ = other.stats_;
+    }
+    return *this;
+}
+
+template<class Key, class Value>
+ScapegoatTree<Key, Value>& ScapegoatTree<Key, Value>::operator=(ScapegoatTree<Key, Value>&& other)
+{
+    if(this != &other){
+        BinarySearchTree<Key, Value>::operator=(std::move(other));
+        alpha_ = other.alpha_;
+        maxCount_ = other.maxCount_;
+        maxDepth_ = other.maxDepth_;
+        other.setMaxCount(0);
+    }
+    return *this;
+}
+
+/**
+* Inserts as in a plain BST while counting the new node's depth. If it is
+* deeper than log base 1/alpha of the maximum size, the scapegoat above
+* it is rebuilt. If key is already in the tree its value is overwritten.
+*/
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::insert(const std::pair<const Key, Value>& new_item)
+{
+    const Key& key = new_item.first;
+    const Value& value = new_item.second;
+
+    if(this->root_ == nullptr){
+        this->root_ = new Node<Key, Value>(key, value, nullptr);
+        this->noteInserted(this->root_);
+        setMaxCount(1);
+        stats_.updates++;
+        return;
+    }
+
+    Node<Key, Value>* curr = this->root_;
+    Node<Key, Value>* par = nullptr;
+    typename BinarySearchTree<Key, Value>::KeyCache cache = KeyTraits<Key>::makeCache(key);
+    int cmp = 0;
+    int depth = 0;
+
+    while(curr != nullptr){
+        par = curr;
+        cmp = this->compareToNode(key, cache, curr);
+        if(cmp < 0){
+            curr = curr->getLeft();
+        } else if(cmp > 0){
+            curr = curr->getRight();
+        } else {
+            curr->setValue(value);
+            return;
+        }
+        depth++;
+    }
+
+    Node<Key, Value>* node = new Node<Key, Value>(key, value, par);
+    if(cmp < 0){
+        par->setLeft(node);
+    } else {
+        par->setRight(node);
+    }
+    this->noteInserted(node);
+    if(this->size_ > maxCount_){
+        setMaxCount(this->size_);
+    }
+    stats_.updates++;
+
+    if(depth > maxDepth_){
+        rebuildAbove(node);
+    }
+}
+
+/**
+* Rebuilds the scapegoat above a node that was linked in too deep: the
+* first ancestor whose child on the path is alpha-weight-unbalanced.
+*/
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::rebuildAbove(Node<Key, Value>* node)
+{
+    Node<Key, Value>* child = node;
+    size_t childSize = 1;
+    while(true){
+        Node<Key, Value>* up = child->getParent();
+        if(up == nullptr){
+            // only reachable through rounding in maxDepth_
+            rebuild(child, childSize);
+            return;
+        }
+        Node<Key, Value>* sibling = (child == up->getLeft()) ? up->getRight() : up->getLeft();
+        size_t upSize = 1 + childSize + subtreeSize(sibling);
+        if(static_cast<double>(childSize) > alpha_ * static_cast<double>(upSize)){
+            rebuild(up, upSize);
+            return;
+        }
+        child = up;
+        childSize = upSize;
+    }
+}
+
+/**
+* Removes as in a plain BST, rebuilding the whole tree once the size has
+* dropped below alpha of the size recorded at the last full rebuild.
+*/
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::remove(const Key& key)
+{
+    Node<Key, Value>* node = this->internalFind(key);
+    if(node == nullptr){
+        return;
+    }
+    ScapegoatTree<Key, Value>::unlinkNode(node);
+    this->destroyNode(node);
+}
+
+/**
+* Links an unlinked node in as insert() would have created it, rebuilding
+* the scapegoat above it if it lands too deep.
+*/
+template<class Key, class Value>
+Node<Key, Value>* ScapegoatTree<Key, Value>::linkNode(Node<Key, Value>* node)
+{
+    int cmp;
+    size_t depth;
+    Node<Key, Value>* par = this->findSlot(node->getKey(), cmp, depth);
+    if(par != nullptr && cmp == 0){
+        return par;
+    }
+    this->attachNode(node, par, cmp);
+    this->noteInserted(node);
+    if(this->size_ > maxCount_){
+        setMaxCount(this->size_);
+    }
+    stats_.updates++;
+    if(static_cast<int>(depth) > maxDepth_){
+        rebuildAbove(node);
+    }
+    return node;
+}
+
+/**
+* Takes node out of the tree without freeing it, rebuilding the whole tree
+* if it has shrunk too far, as remove() does.
+*/
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::unlinkNode(Node<Key, Value>* node)
+{
+    BinarySearchTree<Key, Value>::unlinkNode(node);
+    stats_.updates++;
+
+    size_t count = this->size_;
+    if(static_cast<double>(count) < alpha_ * static_cast<double>(maxCount_)){
+        if(this->root_ != nullptr){
+            rebuild(this->root_, count);
+        }
+        setMaxCount(count);
+    }
+}
+
+template<class Key, class Value>
+const ScapegoatStats& ScapegoatTree<Key, Value>::stats() const
+{
+    return stats_;
+}
+
+/**
+* Counts the nodes under root without recursion, by a pre-order walk
+* that climbs back up with parent pointers.
+*/
+template<class Key, class Value>
+size_t ScapegoatTree<Key, Value>::subtreeSize(const Node<Key, Value>* root)
+{
+    if(root == nullptr){
+        return 0;
+    }
+    size_t count = 0;
+    const Node<Key, Value>* node = root;
+    while(true){
+        count++;
+        if(node->getLeft() != nullptr){
+            node = node->getLeft();
+        } else if(node->getRight() != nullptr){
+            node = node->getRight();
+        } else {
+            // climb to the nearest ancestor with an unvisited right child
+            while(true){
+                if(node == root){
+                    return count;
+                }
+                const Node<Key, Value>* par = node->getParent();
+                if(node == par->getLeft() && par->getRight() != nullptr){
+                    node = par->getRight();
+                    break;
+                }
+                node = par;
+            }
+        }
+    }
+}
+
+/**
+* The depth of the deepest node below root, counted from root.
+*/
+template<class Key, class Value>
+int ScapegoatTree<Key, Value>::subtreeDepth(const Node<Key, Value>* root)
+{
+    if(root == nullptr){
+        return 0;
+    }
+    int depth = 0;
+    int deepest = 0;
+    const Node<Key, Value>* node = root;
+    while(true){
+        if(depth > deepest){
+            deepest = depth;
+        }
+        if(node->getLeft() != nullptr){
+            node = node->getLeft();
+            depth++;
+        } else if(node->getRight() != nullptr){
+            node = node->getRight();
+            depth++;
+        } else {
+            // climb to the nearest ancestor with an unvisited right child
+            while(true){
+                if(node == root){
+                    return deepest;
+                }
+                const Node<Key, Value>* par = node->getParent();
+                depth--;
+                if(node == par->getLeft() && par->getRight() != nullptr){
+                    node = par->getRight();
+                    depth++;
+                    break;
+                }
+                node = par;
+            }
+        }
+    }
+}
+
+/**
+* Relinks the size nodes under root into a perfectly balanced subtree in
+* the same place.
+*/
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::rebuild(Node<Key, Value>* root, size_t size)
+{
+    std::vector<Node<Key, Value>*> nodes;
+    nodes.reserve(size);
+
+    // in-order walk, bounded by root
+    Node<Key, Value>* node = root;
+    while(node->getLeft() != nullptr){
+        node = node->getLeft();
+    }
+    while(node != nullptr){
+        nodes.push_back(node);
+        if(node->getRight() != nullptr){
+            node = node->getRight();
+            while(node->getLeft() != nullptr){
+                node = node->getLeft();
+            }
+        } else {
+            Node<Key, Value>* prev = node;
+            node = node->getParent();
+            while(prev != root && node->getRight() == prev){
+                prev = node;
+                node = node->getParent();
+            }
+            if(prev == root){
+                node = nullptr;
+            }
+        }
+    }
+
+    Node<Key, Value>* par = root->getParent();
+    bool wasLeft = (par != nullptr && par->getLeft() == root);
+    Node<Key, Value>* built = linkBalanced(nodes, 0, nodes.size(), par);
+    if(par == nullptr){
+        this->root_ = built;
+    } else if(wasLeft){
+        par->setLeft(built);
+    } else {
+        par->setRight(built);
+    }
+
+    stats_.rebuilds++;
+    stats_.rebuiltNodes += nodes.size();
+}
+
+template<class Key, class Value>
+Node<Key, Value>* ScapegoatTree<Key, Value>::linkBalanced(std::vector<Node<Key, Value>*>& nodes,
+    size_t lo, size_t hi, Node<Key, Value>* parent)
+{
+    if(lo >= hi){
+        return nullptr;
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    Node<Key, Value>* node = nodes[mid];
+    node->setParent(parent);
+    node->setLeft(linkBalanced(nodes, lo, mid, node));
+    node->setRight(linkBalanced(nodes, mid + 1, hi, node));
+    return node;
+}
+
+/**
+* Records a new maximum size along with the depth it allows.
+*/
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::setMaxCount(size_t maxCount)
+{
+    maxCount_ = maxCount;
+    maxDepth_ = maxCount <= 1 ? 0 :
+        static_cast<int>(std::floor(std::log(static_cast<double>(maxCount)) / std::log(1.0 / alpha_)));
+}
+
+/**
+* Bulk erases, batches and assignSorted() leave a perfectly balanced tree,
+* as a full rebuild does; copyFrom() copies the source's shape, which may
+* be too deep, in which case the whole tree is rebuilt. Either way the
+* maximum size starts over at the current size.
+*/
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::bulkChanged()
+{
+    BinarySearchTree<Key, Value>::bulkChanged();
+    setMaxCount(this->size_);
+    if(this->root_ != nullptr && subtreeDepth(this->root_) > maxDepth_){
+        rebuild(this->root_, this->size_);
+    }
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the ScapegoatTree class.
+  -----------------------------------------------
+*/
+
+#endif
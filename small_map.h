@@ -0,0 +1,625 @@
+#ifndef SMALL_MAP_H
+#define SMALL_MAP_H
+
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "avlbst.h"
+#include "bplus_tree.h"
+
+/**
+* A map for the common case of only a handful of entries. Up to Capacity
+* entries are kept inline, in sorted key and value arrays inside the map
+* object itself, so a small map costs no heap allocation at all. Once an
+* insert would go past Capacity the entries are moved into a Tree (an
+* AVLTree by default) and the map behaves like that tree; when removals
+* bring it back down to DEMOTE_SIZE entries it moves them inline again.
+* The gap between the two sizes keeps a map that hovers around Capacity
+* from converting on every operation.
+*
+* Inline searches go through SmallMapSearch<Key>: SSE2 compares for the
+* key types BPlusSearch vectorizes, a branchless binary search otherwise.
+*
+* As in BPlusTree, keys and values are stored apart while inline, so
+* iterators yield a pair of references rather than a reference to a pair.
+* Any insert or remove invalidates iterators.
+*/
+
+#ifndef SMALL_MAP_CAPACITY
+#define SMALL_MAP_CAPACITY 16
+#endif
+
+/**
+* Inline search: the first index among count sorted keys whose key is not
+* less than key. Halves the range with a conditional move rather than a
+* branch, so the cost does not depend on where the key falls.
+*/
+template <typename Key>
+struct SmallMapSearch
+{
+    static unsigned lowerBound(const Key* keys, unsigned count, const Key& key)
+    {
+        if(count == 0){
+            return 0;
+        }
+        const Key* base = keys;
+        while(count > 1){
+            unsigned half = count / 2;
+            base = base[half] < key ? base + half : base;
+            count -= half;
+        }
+        return static_cast<unsigned>(base - keys) + (*base < key);
+    }
+};
+
+#if defined(__SSE2__)
+template <> struct SmallMapSearch<int> : BPlusSearch<int> { };
+#endif
+#if defined(__SSE4_2__)
+template <> struct SmallMapSearch<long> : BPlusSearch<long> { };
+template <> struct SmallMapSearch<long long> : BPlusSearch<long long> { };
+#endif
+
+template <typename Key, typename Value,
+          unsigned Capacity = SMALL_MAP_CAPACITY,
+          template <typename, typename> class Tree = AVLTree>
+class SmallMap
+{
+public:
+    typedef std::pair<const Key&, Value&> reference;
+    typedef Tree<Key, Value> TreeType;
+
+    SmallMap();
+    SmallMap(const SmallMap& other);
+    SmallMap(SmallMap&& other);
+    SmallMap& operator=(const SmallMap& other);
+    SmallMap& operator=(SmallMap&& other);
+    ~SmallMap();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool empty() const;
+    size_t size() const;
+    bool promoted() const;
+    size_t memoryUsage() const;
+
+    /**
+    * An internal iterator class for traversing the contents of the map.
+    */
+    class iterator
+    {
+    public:
+        class ArrowProxy
+        {
+        public:
+            const reference* operator->() const { return &item_; }
+        private:
+            friend class iterator;
+            ArrowProxy(const reference& item) : item_(item) { }
+            reference item_;
+        };
+
+        iterator();
+
+        reference operator*() const;
+        ArrowProxy operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class SmallMap;
+        iterator(const SmallMap* map, unsigned index);
+        iterator(typename TreeType::iterator node);
+        // inline entries: the map and an index, with map_ null at the end
+        SmallMap* map_;
+        unsigned index_;
+        // promoted maps: an iterator into the tree
+        typename TreeType::iterator node_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+    // Entries left when a promoted map moves back inline
+    static const unsigned DEMOTE_SIZE = Capacity / 2;
+
+protected:
+    Key* keys() { return reinterpret_cast<Key*>(keySlots_); }
+    const Key* keys() const { return reinterpret_cast<const Key*>(keySlots_); }
+    Value* values() { return reinterpret_cast<Value*>(valueSlots_); }
+    const Value* values() const { return reinterpret_cast<const Value*>(valueSlots_); }
+
+    unsigned indexOf(const Key& key) const;
+    void promote();
+    void demote();
+    void destroyInline();
+    void copyFrom(const SmallMap& other);
+    void moveFrom(SmallMap& other);
+
+    template<typename T>
+    static void insertAt(T* items, unsigned count, unsigned pos, T& item);
+    template<typename T>
+    static void eraseAt(T* items, unsigned count, unsigned pos);
+    template<typename T>
+    static void moveRange(T* from, unsigned count, T* to);
+
+private:
+    typename std::aligned_storage<sizeof(Key), alignof(Key)>::type keySlots_[Capacity];
+    typename std::aligned_storage<sizeof(Value), alignof(Value)>::type valueSlots_[Capacity];
+    unsigned count_;
+    TreeType* tree_;
+};
+
+/*
+--------------------------------------------------------------
+Begin implementations for the SmallMap::iterator class.
+---------------------------------------------------------------
+*/
+
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+SmallMap<Key, Value, Capacity, Tree>::iterator::iterator() :
+    map_(NULL), index_(0), node_()
+{
+
+}
+
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+SmallMap<Key, Value, Capacity, Tree>::iterator::iterator(const SmallMap* map, unsigned index) :
+    map_(index < map->count_ ? const_cast<SmallMap*>(map) : NULL),
+    index_(index < map->count_ ? index : 0), node_()
+{
+
+}
+
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+SmallMap<Key, Value, Capacity, Tree>::iterator::iterator(typename TreeType::iterator node) :
+    map_(NULL), index_(0), node_(node)
+{
+
+}
+
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+typename SmallMap<Key, Value, Capacity, Tree>::reference
+SmallMap<Key, Value, Capacity, Tree>::iterator::operator*() const
+{
+    if(map_ != NULL){
+        return reference(map_->keys()[index_], map_->values()[index_]);
+    }
+    return reference(node_->first, node_->second);
+}
+
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+typename SmallMap<Key, Value, Capacity, Tree>::iterator::ArrowProxy
+SmallMap<Key, Value, Capacity, Tree>::iterator::operator->() const
+{
+    return ArrowProxy(**this);
+}
+
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+bool SmallMap<Key, Value, Capacity, Tree>::iterator::operator==(const iterator& rhs) const
+{
+    return map_ == rhs.map_ && index_ == rhs.index_ && node_ == rhs.node_;
+}
+
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+bool SmallMap<Key, Value, Capacity, Tree>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Steps through the inline arrays, or through the tree once promoted.
+*/
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+typename SmallMap<Key, Value, Capacity, Tree>::iterator&
+SmallMap<Key, Value, Capacity, Tree>::iterator::operator++()
+{
+    if(map_ != NULL){
+        if(++index_ == map_->count_){
+            map_ = NULL;
+            index_ = 0;
+        }
+    } else {
+        ++node_;
+    }
+    return *this;
+}
+
+/*
+-------------------------------------------------------------
+End implementations for the SmallMap::iterator class.
+-------------------------------------------------------------
+*/
+
+/*
+-----------------------------------------------
+Begin implementations for the SmallMap class.
+-----------------------------------------------
+*/
+
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+SmallMap<Key, Value, Capacity, Tree>::SmallMap() :
+    count_(0), tree_(NULL)
+{
+    static_assert(Capacity >= 2, "SmallMap needs room for at least two inline entries");
+}
+
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+SmallMap<Key, Value, Capacity, Tree>::SmallMap(const SmallMap& other) :
+    count_(0), tree_(NULL)
+{
+    copyFrom(other);
+}
+
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+SmallMap<Key, Value, Capacity, Tree>::SmallMap(SmallMap&& other) :
+    count_(0), tree_(NULL)
+{
+    moveFrom(other);
+}
+
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+SmallMap<Key, Value, Capacity, Tree>&
+SmallMap<Key, Value, Capacity, Tree>::operator=(const SmallMap& other)
+{
+    if(this != &other){
+        clear();
+        copyFrom(other);
+    }
+    return *this;
+}
+
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+SmallMap<Key, Value, Capacity, Tree>&
+SmallMap<Key, Value, Capacity, Tree>::operator=(SmallMap&& other)
+{
+    if(this != &other){
+        clear();
+        moveFrom(other);
+    }
+    return *this;
+}
+
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+SmallMap<Key, Value, Capacity, Tree>::~SmallMap()
+{
+    clear();
+}
+
+/**
+* If key is already in the map its value is overwritten. A new key that
+* does not fit inline promotes the map first.
+*/
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+void SmallMap<Key, Value, Capacity, Tree>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    if(tree_ == NULL){
+        unsigned pos = indexOf(keyValuePair.first);
+        if(pos < count_ && !(keyValuePair.first < keys()[pos])){
+            values()[pos] = keyValuePair.second;
+            return;
+        }
+        if(count_ < Capacity){
+            // both copies are made before anything shifts, so a throwing
+            // copy leaves the map unchanged
+            Key key(keyValuePair.first);
+            Value value(keyValuePair.second);
+            insertAt(keys(), count_, pos, key);
+            try {
+                insertAt(values(), count_, pos, value);
+            } catch(...) {
+                eraseAt(keys(), count_ + 1, pos);
+                throw;
+            }
+            ++count_;
+            return;
+        }
+        promote();
+    }
+    tree_->insert(keyValuePair);
+}
+
+/**
+* Removes key if present. A promoted map that shrinks to DEMOTE_SIZE
+* entries moves them back inline.
+*/
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+void SmallMap<Key, Value, Capacity, Tree>::remove(const Key& key)
+{
+    if(tree_ == NULL){
+        unsigned pos = indexOf(key);
+        if(pos < count_ && !(key < keys()[pos])){
+            eraseAt(keys(), count_, pos);
+            eraseAt(values(), count_, pos);
+            --count_;
+        }
+        return;
+    }
+    tree_->remove(key);
+    if(tree_->size() <= DEMOTE_SIZE){
+        demote();
+    }
+}
+
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+void SmallMap<Key, Value, Capacity, Tree>::clear()
+{
+    destroyInline();
+    delete tree_;
+    tree_ = NULL;
+}
+
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+bool SmallMap<Key, Value, Capacity, Tree>::empty() const
+{
+    return size() == 0;
+}
+
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+size_t SmallMap<Key, Value, Capacity, Tree>::size() const
+{
+    return tree_ != NULL ? tree_->size() : count_;
+}
+
+/**
+* True while the entries live in a tree rather than inline.
+*/
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+bool SmallMap<Key, Value, Capacity, Tree>::promoted() const
+{
+    return tree_ != NULL;
+}
+
+/**
+* Bytes held by the map: the object itself, plus the tree and an
+* AVLNode per entry once promoted (ignoring allocator overhead).
+*/
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+size_t SmallMap<Key, Value, Capacity, Tree>::memoryUsage() const
+{
+    size_t bytes = sizeof(*this);
+    if(tree_ != NULL){
+        bytes += sizeof(TreeType) + tree_->size() * sizeof(AVLNode<Key, Value>);
+    }
+    return bytes;
+}
+
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+typename SmallMap<Key, Value, Capacity, Tree>::iterator
+SmallMap<Key, Value, Capacity, Tree>::begin() const
+{
+    if(tree_ != NULL){
+        return iterator(tree_->begin());
+    }
+    return iterator(this, 0);
+}
+
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+typename SmallMap<Key, Value, Capacity, Tree>::iterator
+SmallMap<Key, Value, Capacity, Tree>::end() const
+{
+    return iterator();
+}
+
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+typename SmallMap<Key, Value, Capacity, Tree>::iterator
+SmallMap<Key, Value, Capacity, Tree>::find(const Key& key) const
+{
+    if(tree_ != NULL){
+        return iterator(tree_->find(key));
+    }
+    unsigned pos = indexOf(key);
+    if(pos < count_ && !(key < keys()[pos])){
+        return iterator(this, pos);
+    }
+    return end();
+}
+
+/**
+* Returns an iterator to the first entry whose key is not less than key.
+*/
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+typename SmallMap<Key, Value, Capacity, Tree>::iterator
+SmallMap<Key, Value, Capacity, Tree>::lower_bound(const Key& key) const
+{
+    if(tree_ != NULL){
+        return iterator(tree_->lower_bound(key));
+    }
+    return iterator(this, indexOf(key));
+}
+
+/**
+* @precondition The key exists in the map
+* Returns the value associated with the key
+*/
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+Value& SmallMap<Key, Value, Capacity, Tree>::operator[](const Key& key)
+{
+    iterator it = find(key);
+    if(it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+Value const & SmallMap<Key, Value, Capacity, Tree>::operator[](const Key& key) const
+{
+    iterator it = find(key);
+    if(it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+/**
+* Index of the first inline key not less than key.
+*/
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+unsigned SmallMap<Key, Value, Capacity, Tree>::indexOf(const Key& key) const
+{
+    return SmallMapSearch<Key>::lowerBound(keys(), count_, key);
+}
+
+/**
+* Builds a balanced tree from the inline entries, which are already
+* sorted, and then frees them. Nothing changes if building throws.
+*/
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+void SmallMap<Key, Value, Capacity, Tree>::promote()
+{
+    TreeType* tree = new TreeType();
+    try {
+        tree->assignSorted(keys(), values(), count_);
+    } catch(...) {
+        delete tree;
+        throw;
+    }
+    destroyInline();
+    tree_ = tree;
+}
+
+/**
+* Moves the tree's entries (at most DEMOTE_SIZE of them) back inline and
+* deletes the tree. If a copy throws, the map stays promoted.
+*/
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+void SmallMap<Key, Value, Capacity, Tree>::demote()
+{
+    unsigned count = 0;
+    try {
+        for(typename TreeType::iterator it = tree_->begin(); it != tree_->end(); ++it){
+            new (keys() + count) Key(it->first);
+            try {
+                new (values() + count) Value(it->second);
+            } catch(...) {
+                keys()[count].~Key();
+                throw;
+            }
+            ++count;
+        }
+    } catch(...) {
+        count_ = count;
+        destroyInline();
+        throw;
+    }
+    delete tree_;
+    tree_ = NULL;
+    count_ = count;
+}
+
+/**
+* Destroys the inline entries.
+*/
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+void SmallMap<Key, Value, Capacity, Tree>::destroyInline()
+{
+    for(unsigned i = 0; i < count_; ++i){
+        keys()[i].~Key();
+        values()[i].~Value();
+    }
+    count_ = 0;
+}
+
+/**
+* Copies other's entries into this map, which must be empty.
+*/
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+void SmallMap<Key, Value, Capacity, Tree>::copyFrom(const SmallMap& other)
+{
+    if(other.tree_ != NULL){
+        tree_ = new TreeType(*other.tree_);
+        return;
+    }
+    try {
+        for(; count_ < other.count_; ++count_){
+            new (keys() + count_) Key(other.keys()[count_]);
+            try {
+                new (values() + count_) Value(other.values()[count_]);
+            } catch(...) {
+                keys()[count_].~Key();
+                throw;
+            }
+        }
+    } catch(...) {
+        destroyInline();
+        throw;
+    }
+}
+
+/**
+* Takes other's entries, leaving it empty. This map must be empty.
+*/
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+void SmallMap<Key, Value, Capacity, Tree>::moveFrom(SmallMap& other)
+{
+    if(other.tree_ != NULL){
+        tree_ = other.tree_;
+        other.tree_ = NULL;
+        return;
+    }
+    moveRange(other.keys(), other.count_, keys());
+    moveRange(other.values(), other.count_, values());
+    count_ = other.count_;
+    other.count_ = 0;
+}
+
+/**
+* Moves item into position pos among count items, shifting the rest up
+* into slot count, which must be unconstructed.
+*/
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+template<typename T>
+void SmallMap<Key, Value, Capacity, Tree>::insertAt(T* items, unsigned count, unsigned pos, T& item)
+{
+    if(pos == count){
+        new (items + count) T(std::move(item));
+        return;
+    }
+    new (items + count) T(std::move(items[count - 1]));
+    for(unsigned i = count - 1; i > pos; --i){
+        items[i] = std::move(items[i - 1]);
+    }
+    items[pos] = std::move(item);
+}
+
+/**
+* Removes the item at pos among count, leaving slot count - 1 unconstructed.
+*/
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+template<typename T>
+void SmallMap<Key, Value, Capacity, Tree>::eraseAt(T* items, unsigned count, unsigned pos)
+{
+    for(unsigned i = pos; i + 1 < count; ++i){
+        items[i] = std::move(items[i + 1]);
+    }
+    items[count - 1].~T();
+}
+
+/**
+* Move-constructs count items into uninitialized storage and destroys
+* the originals.
+*/
+template<typename Key, typename Value, unsigned Capacity, template <typename, typename> class Tree>
+template<typename T>
+void SmallMap<Key, Value, Capacity, Tree>::moveRange(T* from, unsigned count, T* to)
+{
+    for(unsigned i = 0; i < count; ++i){
+        new (to + i) T(std::move(from[i]));
+        from[i].~T();
+    }
+}
+
+/*
+-----------------------------------------------
+End implementations for the SmallMap class.
+-----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,356 @@
+#ifndef SPLAYBST_H
+#define SPLAYBST_H
+
+#include <iostream>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include <stdexcept>
+#include "bst.h"
+
+/**
+* A splay tree: every access moves the key it found (or the last node on
+* its search path) to the root, so recently and frequently used keys stay
+* near the top. Splaying is top-down, in one pass from the root, and
+* needs no per-node metadata, so plain Nodes are used.
+*
+* To cut the writes splaying costs on read-mostly workloads, only a
+* sampled fraction of accesses can be made to splay; the others search,
+* insert and remove exactly as in BinarySearchTree. Hot keys are still
+* splayed often enough to stay near the root.
+*
+* find() and operator[] splay only when called on a non-const tree.
+*/
+template <class Key, class Value>
+class SplayTree : public BinarySearchTree<Key, Value>
+{
+public:
+    typedef typename BinarySearchTree<Key, Value>::iterator iterator;
+
+    explicit SplayTree(double splayFraction = 1.0);
+    SplayTree(const SplayTree<Key, Value>& other);
+    SplayTree(SplayTree<Key, Value>&& other);
+    SplayTree<Key, Value>& operator=(const SplayTree<Key, Value>& other);
+    SplayTree<Key, Value>& operator=(SplayTree<Key, Value>&& other);
+
+    using BinarySearchTree<Key, Value>::insert;
+    virtual void insert(const std::pair<const Key, Value>& new_item);
+    virtual void remove(const Key& key);
+
+    using BinarySearchTree<Key, Value>::find;
+    using BinarySearchTree<Key, Value>::operator[];
+    iterator find(const Key& key);
+    Value& operator[](const Key& key);
+
+    void setSplayFraction(double splayFraction);
+
+protected:
+    Node<Key, Value>* splay(Node<Key, Value>* root, const Key& key);
+    bool sampled();
+
+    // threshold_ out of 2^32 accesses splay; SPLAY_ALWAYS skips the draw
+    static const uint64_t SPLAY_ALWAYS = uint64_t(1) << 32;
+
+private:
+    uint64_t threshold_;
+    uint64_t sampleState_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the SplayTree class.
+  -----------------------------------------------
+*/
+
+template<class Key, class Value>
+SplayTree<Key, Value>::SplayTree(double splayFraction) :
+    BinarySearchTree<Key, Value>(), threshold_(SPLAY_ALWAYS), sampleState_(0x9E3779B97F4A7C15ull)
+{
+    setSplayFraction(splayFraction);
+}
+
+template<class Key, class Value>
+SplayTree<Key, Value>::SplayTree(const SplayTree<Key, Value>& other) :
+    BinarySearchTree<Key, Value>(other), threshold_(other.threshold_), sampleState_(other.sampleState_)
+{
+
+}
+
+template<class Key, class Value>
+SplayTree<Key, Value>::SplayTree(SplayTree<Key, Value>&& other) :
+    BinarySearchTree<Key, Value>(std::move(other)), threshold_(other.threshold_), sampleState_(other.sampleState_)
+{
+
+}
+
+template<class Key, class Value>
+SplayTree<Key, Value>& SplayTree<Key, Value>::operator=(const SplayTree<Key, Value>& other)
+{
+    BinarySearchTree<Key, Value>::operator=(other);
+    threshold_ = other.threshold_;
+    return *this;
+}
+
+template<class Key, class Value>
+SplayTree<Key, Value>& SplayTree<Key, Value>::operator=(SplayTree<Key, Value>&& other)
+{
+    BinarySearchTree<Key, Value>::operator=(std::move(other));
+    threshold_ = other.threshold_;
+    return *this;
+}
+
+/**
+* Sets the share of accesses that splay, from 0 (never, a plain BST) to
+* 1 (always, a classic splay tree).
+*/
+template<class Key, class Value>
+void SplayTree<Key, Value>::setSplayFraction(double splayFraction)
+{
+    if(splayFraction >= 1.0){
+        threshold_ = SPLAY_ALWAYS;
+    } else if(splayFraction <= 0.0){
+        threshold_ = 0;
+    } else {
+        threshold_ = static_cast<uint64_t>(splayFraction * static_cast<double>(SPLAY_ALWAYS));
+    }
+}
+
+/**
+* A sampled insert splays the key's neighbour to the root and puts the
+* new node above it; otherwise the BST insert is used.
+* If key is already in the tree its value is overwritten.
+*/
+template<class Key, class Value>
+void SplayTree<Key, Value>::insert(const std::pair<const Key, Value>& new_item)
+{
+    if(this->root_ == nullptr || !sampled()){
+        BinarySearchTree<Key, Value>::insert(new_item);
+        return;
+    }
+
+    Node<Key, Value>* root = splay(this->root_, new_item.first);
+    this->root_ = root;
+    typename BinarySearchTree<Key, Value>::KeyCache cache = KeyTraits<Key>::makeCache(new_item.first);
+    int cmp = this->compareToNode(new_item.first, cache, root);
+    if(cmp == 0){
+        root->setValue(new_item.second);
+        return;
+    }
+
+    Node<Key, Value>* node = new Node<Key, Value>(new_item.first, new_item.second, nullptr);
+    if(cmp < 0){
+        node->setLeft(root->getLeft());
+        node->setRight(root);
+        root->setLeft(nullptr);
+    } else {
+        node->setRight(root->getRight());
+        node->setLeft(root);
+        root->setRight(nullptr);
+    }
+    if(node->getLeft() != nullptr){
+        node->getLeft()->setParent(node);
+    }
+    if(node->getRight() != nullptr){
+        node->getRight()->setParent(node);
+    }
+    this->root_ = node;
+    this->noteInserted(node);
+}
+
+/**
+* A sampled remove splays the key to the root, then joins its subtrees
+* by splaying the left subtree's maximum to the top of that subtree;
+* otherwise the BST remove is used.
+*/
+template<class Key, class Value>
+void SplayTree<Key, Value>::remove(const Key& key)
+{
+    if(this->root_ == nullptr || !sampled()){
+        BinarySearchTree<Key, Value>::remove(key);
+        return;
+    }
+
+    Node<Key, Value>* root = splay(this->root_, key);
+    this->root_ = root;
+    typename BinarySearchTree<Key, Value>::KeyCache cache = KeyTraits<Key>::makeCache(key);
+    if(this->compareToNode(key, cache, root) != 0){
+        return;
+    }
+    this->noteRemoving(root);
+
+    Node<Key, Value>* left = root->getLeft();
+    Node<Key, Value>* right = root->getRight();
+    Node<Key, Value>* joined;
+    if(left == nullptr){
+        joined = right;
+    } else {
+        // every key on the left is smaller, so this brings its maximum up
+        left->setParent(nullptr);
+        joined = splay(left, key);
+        joined->setRight(right);
+        if(right != nullptr){
+            right->setParent(joined);
+        }
+    }
+    if(joined != nullptr){
+        joined->setParent(nullptr);
+    }
+    this->root_ = joined;
+    this->destroyNode(root);
+}
+
+/**
+* Returns an iterator to key, splaying it (or the last node on its search
+* path) to the root when the access is sampled.
+*/
+template<class Key, class Value>
+typename SplayTree<Key, Value>::iterator SplayTree<Key, Value>::find(const Key& key)
+{
+    if(this->root_ == nullptr || !sampled()){
+        return this->makeIterator(this->internalFind(key));
+    }
+    this->root_ = splay(this->root_, key);
+    typename BinarySearchTree<Key, Value>::KeyCache cache = KeyTraits<Key>::makeCache(key);
+    if(this->compareToNode(key, cache, this->root_) != 0){
+        return this->end();
+    }
+    return this->makeIterator(this->root_);
+}
+
+/**
+* @precondition The key exists in the map
+* Returns the value associated with the key
+*/
+template<class Key, class Value>
+Value& SplayTree<Key, Value>::operator[](const Key& key)
+{
+    iterator it = find(key);
+    if(it == this->end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+/**
+* Top-down splay of the subtree at root (whose parent must be null) for
+* key. Nodes passed on the way down are hung, in order, on a left tree of
+* smaller keys and a right tree of larger keys, which become the children
+* of the node the search ends at. Parent pointers are fixed as nodes are
+* linked. Returns the new subtree root, with a null parent.
+*/
+template<class Key, class Value>
+Node<Key, Value>* SplayTree<Key, Value>::splay(Node<Key, Value>* root, const Key& key)
+{
+    typename BinarySearchTree<Key, Value>::KeyCache cache = KeyTraits<Key>::makeCache(key);
+    Node<Key, Value>* leftTree = nullptr;
+    Node<Key, Value>* leftMax = nullptr;
+    Node<Key, Value>* rightTree = nullptr;
+    Node<Key, Value>* rightMin = nullptr;
+    Node<Key, Value>* t = root;
+
+    while(true){
+        int cmp = this->compareToNode(key, cache, t);
+        if(cmp < 0){
+            Node<Key, Value>* child = t->getLeft();
+            if(child == nullptr){
+                break;
+            }
+            if(this->compareToNode(key, cache, child) < 0){
+                // zig-zig: rotate right before linking
+                t->setLeft(child->getRight());
+                if(child->getRight() != nullptr){
+                    child->getRight()->setParent(t);
+                }
+                child->setRight(t);
+                t->setParent(child);
+                t = child;
+                if(t->getLeft() == nullptr){
+                    break;
+                }
+            }
+            // link t as the new minimum of the right tree
+            Node<Key, Value>* next = t->getLeft();
+            if(rightMin == nullptr){
+                rightTree = t;
+                t->setParent(nullptr);
+            } else {
+                rightMin->setLeft(t);
+                t->setParent(rightMin);
+            }
+            rightMin = t;
+            t = next;
+        } else if(cmp > 0){
+            Node<Key, Value>* child = t->getRight();
+            if(child == nullptr){
+                break;
+            }
+            if(this->compareToNode(key, cache, child) > 0){
+                // zag-zag: rotate left before linking
+                t->setRight(child->getLeft());
+                if(child->getLeft() != nullptr){
+                    child->getLeft()->setParent(t);
+                }
+                child->setLeft(t);
+                t->setParent(child);
+                t = child;
+                if(t->getRight() == nullptr){
+                    break;
+                }
+            }
+            // link t as the new maximum of the left tree
+            Node<Key, Value>* next = t->getRight();
+            if(leftMax == nullptr){
+                leftTree = t;
+                t->setParent(nullptr);
+            } else {
+                leftMax->setRight(t);
+                t->setParent(leftMax);
+            }
+            leftMax = t;
+            t = next;
+        } else {
+            break;
+        }
+    }
+
+    // reassemble: t's subtrees go to the inner edges of the side trees
+    if(leftMax != nullptr){
+        leftMax->setRight(t->getLeft());
+        if(t->getLeft() != nullptr){
+            t->getLeft()->setParent(leftMax);
+        }
+        t->setLeft(leftTree);
+        leftTree->setParent(t);
+    }
+    if(rightMin != nullptr){
+        rightMin->setLeft(t->getRight());
+        if(t->getRight() != nullptr){
+            t->getRight()->setParent(rightMin);
+        }
+        t->setRight(rightTree);
+        rightTree->setParent(t);
+    }
+    t->setParent(nullptr);
+    return t;
+}
+
+/**
+* Decides whether this access splays, with a xorshift64 draw.
+*/
+template<class Key, class Value>
+bool SplayTree<Key, Value>::sampled()
+{
+    if(threshold_ >= SPLAY_ALWAYS){
+        return true;
+    }
+    sampleState_ ^= sampleState_ << 13;
+    sampleState_ ^= sampleState_ >> 7;
+    sampleState_ ^= sampleState_ << 17;
+    return (sampleState_ >> 32) < threshold_;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the SplayTree class.
+  -----------------------------------------------
+*/
+
+#endif
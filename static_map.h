@@ -0,0 +1,297 @@
+#ifndef STATIC_MAP_H
+#define STATIC_MAP_H
+
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+
+/**
+* A fixed, read-only ordered map whose contents are laid out when the
+* program is compiled. Declared constexpr, a StaticMap is a constant in
+* the binary: building it costs nothing at startup and lookups touch no
+* heap. It has the find, lower_bound, operator[] and iterator interface
+* of BinarySearchTree.
+*
+*   constexpr std::pair<const int, int> entries[] = { {8, 80}, {2, 20}, {5, 50} };
+*   constexpr StaticMap<int, int, 3> limits(entries);
+*   static_assert(limits[5] == 50, "looked up at compile time");
+*
+* Entries may be listed in any order. The constructor sorts them, which
+* costs O(N^2) comparisons at compile time, so the map suits tables of up
+* to a few hundred entries. A duplicate key is an error at compile time
+* (std::invalid_argument if the map is built at run time). Key and Value
+* must be literal types and Key must have a constexpr operator<.
+*
+* The entries are kept in a sorted array. A search is a branchless binary
+* search whose steps are all known from N, so each step is its own
+* template instance and the whole search unrolls into a fixed sequence
+* of about log2(N) compares.
+*/
+
+/**
+* A list of indices 0..N-1 for expanding an array element by element
+* (std::index_sequence is C++14).
+*/
+template <unsigned... Is>
+struct StaticIndices
+{
+};
+
+template <unsigned N, unsigned... Is>
+struct MakeStaticIndices : MakeStaticIndices<N - 1, N - 1, Is...>
+{
+};
+
+template <unsigned... Is>
+struct MakeStaticIndices<0, Is...>
+{
+    typedef StaticIndices<Is...> type;
+};
+
+/**
+* One unrolled step of the search: Len entries starting at base remain,
+* and the first entry whose key is not less than key is among them or
+* just past them.
+*/
+template <unsigned Len>
+struct StaticMapSearch
+{
+    template <typename Entry, typename Key>
+    static constexpr unsigned lowerBound(const Entry* items, unsigned base, const Key& key)
+    {
+        return StaticMapSearch<Len - Len / 2>::lowerBound(items,
+            items[base + Len / 2].first < key ? base + Len / 2 : base, key);
+    }
+};
+
+template <>
+struct StaticMapSearch<1>
+{
+    template <typename Entry, typename Key>
+    static constexpr unsigned lowerBound(const Entry* items, unsigned base, const Key& key)
+    {
+        return base + (items[base].first < key ? 1 : 0);
+    }
+};
+
+template <typename Key, typename Value, unsigned N>
+class StaticMap
+{
+    static_assert(N > 0, "a StaticMap needs at least one entry");
+
+public:
+    typedef std::pair<const Key, Value> Entry;
+
+    constexpr StaticMap(const Entry (&entries)[N]);
+
+    /**
+    * An internal iterator class for traversing the contents of the map.
+    */
+    class iterator
+    {
+    public:
+        constexpr iterator() : current_(nullptr) { }
+
+        constexpr const Entry& operator*() const { return *current_; }
+        constexpr const Entry* operator->() const { return current_; }
+
+        constexpr bool operator==(const iterator& rhs) const { return current_ == rhs.current_; }
+        constexpr bool operator!=(const iterator& rhs) const { return current_ != rhs.current_; }
+
+        iterator& operator++() { ++current_; return *this; }
+
+    protected:
+        friend class StaticMap<Key, Value, N>;
+        constexpr explicit iterator(const Entry* current) : current_(current) { }
+        const Entry* current_;
+    };
+
+    constexpr iterator begin() const;
+    constexpr iterator end() const;
+    constexpr iterator find(const Key& key) const;
+    constexpr iterator lower_bound(const Key& key) const;
+    constexpr Value const & operator[](const Key& key) const;
+    constexpr size_t size() const;
+    constexpr bool empty() const;
+
+protected:
+    // Ranks of the entries as listed, passed between the constructors
+    struct Ranks
+    {
+        unsigned rank[N];
+    };
+
+    template <unsigned... Is>
+    constexpr StaticMap(const Entry (&entries)[N], StaticIndices<Is...> indices);
+    template <unsigned... Is>
+    constexpr StaticMap(const Entry (&entries)[N], const Ranks& ranks, StaticIndices<Is...>);
+
+    static constexpr unsigned countLess(const Entry (&entries)[N], unsigned i, unsigned lo, unsigned hi);
+    static constexpr unsigned sourceOf(const Ranks& ranks, unsigned rank, unsigned lo, unsigned hi);
+    static constexpr unsigned lesser(unsigned a, unsigned b);
+    static constexpr unsigned checkedSource(unsigned source);
+    constexpr unsigned indexOf(const Key& key) const;
+    constexpr bool holds(unsigned index, const Key& key) const;
+    constexpr iterator findAt(unsigned index, const Key& key) const;
+    constexpr Value const & valueAt(unsigned index, const Key& key) const;
+
+private:
+    Entry items_[N];
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the StaticMap class.
+  -----------------------------------------------
+*/
+
+template<typename Key, typename Value, unsigned N>
+constexpr StaticMap<Key, Value, N>::StaticMap(const Entry (&entries)[N]) :
+    StaticMap(entries, typename MakeStaticIndices<N>::type())
+{
+
+}
+
+/**
+* Ranks every entry (the number of keys below its own), so that the next
+* constructor can pick the entry for each sorted position.
+*/
+template<typename Key, typename Value, unsigned N>
+template <unsigned... Is>
+constexpr StaticMap<Key, Value, N>::StaticMap(const Entry (&entries)[N], StaticIndices<Is...> indices) :
+    StaticMap(entries, Ranks{ { countLess(entries, Is, 0, N)... } }, indices)
+{
+
+}
+
+/**
+* Fills position r with the entry of rank r. With distinct keys the ranks
+* are 0..N-1; a duplicate key leaves some rank without an entry.
+*/
+template<typename Key, typename Value, unsigned N>
+template <unsigned... Is>
+constexpr StaticMap<Key, Value, N>::StaticMap(const Entry (&entries)[N], const Ranks& ranks, StaticIndices<Is...>) :
+    items_{ entries[checkedSource(sourceOf(ranks, Is, 0, N))]... }
+{
+
+}
+
+template<typename Key, typename Value, unsigned N>
+constexpr typename StaticMap<Key, Value, N>::iterator StaticMap<Key, Value, N>::begin() const
+{
+    return iterator(items_);
+}
+
+template<typename Key, typename Value, unsigned N>
+constexpr typename StaticMap<Key, Value, N>::iterator StaticMap<Key, Value, N>::end() const
+{
+    return iterator(items_ + N);
+}
+
+template<typename Key, typename Value, unsigned N>
+constexpr typename StaticMap<Key, Value, N>::iterator StaticMap<Key, Value, N>::find(const Key& key) const
+{
+    return findAt(indexOf(key), key);
+}
+
+/**
+* Returns an iterator to the first entry whose key is not less than key.
+*/
+template<typename Key, typename Value, unsigned N>
+constexpr typename StaticMap<Key, Value, N>::iterator StaticMap<Key, Value, N>::lower_bound(const Key& key) const
+{
+    return iterator(items_ + indexOf(key));
+}
+
+/**
+* @precondition The key exists in the map
+* Returns the value associated with the key
+*/
+template<typename Key, typename Value, unsigned N>
+constexpr Value const & StaticMap<Key, Value, N>::operator[](const Key& key) const
+{
+    return valueAt(indexOf(key), key);
+}
+
+template<typename Key, typename Value, unsigned N>
+constexpr size_t StaticMap<Key, Value, N>::size() const
+{
+    return N;
+}
+
+template<typename Key, typename Value, unsigned N>
+constexpr bool StaticMap<Key, Value, N>::empty() const
+{
+    return false;
+}
+
+/**
+* The number of keys among entries lo..hi-1 below the key of entry i.
+* Splits the range in halves so the recursion is only log2(N) deep.
+*/
+template<typename Key, typename Value, unsigned N>
+constexpr unsigned StaticMap<Key, Value, N>::countLess(const Entry (&entries)[N], unsigned i, unsigned lo, unsigned hi)
+{
+    return hi - lo == 1 ? (entries[lo].first < entries[i].first ? 1 : 0) :
+        countLess(entries, i, lo, lo + (hi - lo) / 2) + countLess(entries, i, lo + (hi - lo) / 2, hi);
+}
+
+/**
+* The entry among lo..hi-1 of the given rank, or N if there is none.
+*/
+template<typename Key, typename Value, unsigned N>
+constexpr unsigned StaticMap<Key, Value, N>::sourceOf(const Ranks& ranks, unsigned rank, unsigned lo, unsigned hi)
+{
+    return hi - lo == 1 ? (ranks.rank[lo] == rank ? lo : N) :
+        lesser(sourceOf(ranks, rank, lo, lo + (hi - lo) / 2), sourceOf(ranks, rank, lo + (hi - lo) / 2, hi));
+}
+
+template<typename Key, typename Value, unsigned N>
+constexpr unsigned StaticMap<Key, Value, N>::lesser(unsigned a, unsigned b)
+{
+    return a < b ? a : b;
+}
+
+template<typename Key, typename Value, unsigned N>
+constexpr unsigned StaticMap<Key, Value, N>::checkedSource(unsigned source)
+{
+    return source < N ? source : throw std::invalid_argument("Duplicate key");
+}
+
+/**
+* Index of the first entry whose key is not less than key.
+*/
+template<typename Key, typename Value, unsigned N>
+constexpr unsigned StaticMap<Key, Value, N>::indexOf(const Key& key) const
+{
+    return StaticMapSearch<N>::lowerBound(items_, 0, key);
+}
+
+/**
+* Whether the entry at index, as found by indexOf(), has key.
+*/
+template<typename Key, typename Value, unsigned N>
+constexpr bool StaticMap<Key, Value, N>::holds(unsigned index, const Key& key) const
+{
+    return index < N && !(key < items_[index].first);
+}
+
+template<typename Key, typename Value, unsigned N>
+constexpr typename StaticMap<Key, Value, N>::iterator StaticMap<Key, Value, N>::findAt(unsigned index, const Key& key) const
+{
+    return holds(index, key) ? iterator(items_ + index) : end();
+}
+
+template<typename Key, typename Value, unsigned N>
+constexpr Value const & StaticMap<Key, Value, N>::valueAt(unsigned index, const Key& key) const
+{
+    return holds(index, key) ? items_[index].second : throw std::out_of_range("Invalid key");
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the StaticMap class.
+  -----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,407 @@
+#ifndef WEIGHTEDBST_H
+#define WEIGHTEDBST_H
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <typeinfo>
+#include <vector>
+#include "bst.h"
+
+/**
+* A node that also counts how often its key has been looked up.
+*/
+template <class Key, class Value>
+class WeightedNode : public Node<Key, Value>
+{
+public:
+    WeightedNode(const Key& key, const Value& value, WeightedNode<Key, Value>* parent);
+    virtual ~WeightedNode();
+
+    uint64_t getAccesses() const;
+    void setAccesses(uint64_t accesses);
+    void addAccesses(uint64_t accesses);
+
+    virtual WeightedNode<Key, Value>* getParent() const override;
+    virtual WeightedNode<Key, Value>* getLeft() const override;
+    virtual WeightedNode<Key, Value>* getRight() const override;
+
+protected:
+    uint64_t accesses_;
+};
+
+/*
+  ----------------------------------------------------
+  Begin implementations for the WeightedNode class.
+  ----------------------------------------------------
+*/
+
+template<class Key, class Value>
+WeightedNode<Key, Value>::WeightedNode(const Key& key, const Value& value, WeightedNode<Key, Value>* parent) :
+    Node<Key, Value>(key, value, parent), accesses_(0)
+{
+
+}
+
+template<class Key, class Value>
+WeightedNode<Key, Value>::~WeightedNode()
+{
+
+}
+
+template<class Key, class Value>
+uint64_t WeightedNode<Key, Value>::getAccesses() const
+{
+    return accesses_;
+}
+
+template<class Key, class Value>
+void WeightedNode<Key, Value>::setAccesses(uint64_t accesses)
+{
+    accesses_ = accesses;
+}
+
+template<class Key, class Value>
+void WeightedNode<Key, Value>::addAccesses(uint64_t accesses)
+{
+    accesses_ += accesses;
+}
+
+template<class Key, class Value>
+WeightedNode<Key, Value>* WeightedNode<Key, Value>::getParent() const
+{
+    return static_cast<WeightedNode<Key, Value>*>(this->parent_);
+}
+
+template<class Key, class Value>
+WeightedNode<Key, Value>* WeightedNode<Key, Value>::getLeft() const
+{
+    return static_cast<WeightedNode<Key, Value>*>(this->left_);
+}
+
+template<class Key, class Value>
+WeightedNode<Key, Value>* WeightedNode<Key, Value>::getRight() const
+{
+    return static_cast<WeightedNode<Key, Value>*>(this->right_);
+}
+
+/*
+  ----------------------------------------------------
+  End implementations for the WeightedNode class.
+  ----------------------------------------------------
+*/
+
+/**
+* An unbalanced search tree for read-mostly maps whose lookups are skewed
+* towards some keys. find() and operator[] on a non-const tree count the
+* lookups of each key while recording is on (the default).
+* reshapeByAccesses() then rebuilds the tree so that often used keys sit
+* near the root, using Mehlhorn's bisection rule: each subtree's root is
+* the key holding the middle of the subtree's total access count. Each
+* subtree then carries at most half its parent's count, so a key looked
+* up a fraction p of the time is found in at most log2(1/p) + 1
+* comparisons, and the average lookup stays within about two comparisons
+* of the optimal tree's. The rebuild takes O(n log n). Keys never looked
+* up are hung in balanced subtrees.
+*
+* Inserts and removes work as in BinarySearchTree and keep the counts of
+* the nodes they do not touch; the tree keeps its shape until the next
+* reshape.
+*/
+template <class Key, class Value>
+class WeightedTree : public BinarySearchTree<Key, Value>
+{
+public:
+    typedef typename BinarySearchTree<Key, Value>::iterator iterator;
+
+    WeightedTree();
+    WeightedTree(const WeightedTree<Key, Value>& other);
+    WeightedTree(WeightedTree<Key, Value>&& other);
+    WeightedTree<Key, Value>& operator=(const WeightedTree<Key, Value>& other);
+    WeightedTree<Key, Value>& operator=(WeightedTree<Key, Value>&& other);
+
+    using BinarySearchTree<Key, Value>::insert;
+    virtual void insert(const std::pair<const Key, Value>& new_item);
+
+    using BinarySearchTree<Key, Value>::find;
+    using BinarySearchTree<Key, Value>::operator[];
+    iterator find(const Key& key);
+    Value& operator[](const Key& key);
+
+    void setRecording(bool recording);
+    void addAccesses(const Key& key, uint64_t count);
+    uint64_t accesses(const Key& key) const;
+    void resetAccesses();
+    void reshapeByAccesses();
+    double averageComparisons() const;
+
+protected:
+    virtual Node<Key, Value>* cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const override;
+    virtual Node<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent) const override;
+    virtual bool acceptsNode(const Node<Key, Value>* node) const override;
+
+    static size_t weightedRoot(const std::vector<uint64_t>& prefix, size_t lo, size_t hi);
+
+private:
+    bool recording_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the WeightedTree class.
+  -----------------------------------------------
+*/
+
+template<class Key, class Value>
+WeightedTree<Key, Value>::WeightedTree() :
+    BinarySearchTree<Key, Value>(), recording_(true)
+{
+
+}
+
+/**
+* Copy constructor. As in AVLTree, the clone is made here so that
+* cloneNode() copies WeightedNodes, counts included.
+*/
+template<class Key, class Value>
+WeightedTree<Key, Value>::WeightedTree(const WeightedTree<Key, Value>& other) :
+    BinarySearchTree<Key, Value>(), recording_(other.recording_)
+{
+    this->cloneFrom(other);
+}
+
+template<class Key, class Value>
+WeightedTree<Key, Value>::WeightedTree(WeightedTree<Key, Value>&& other) :
+    BinarySearchTree<Key, Value>(std::move(other)), recording_(other.recording_)
+{
+
+}
+
+template<class Key, class Value>
+WeightedTree<Key, Value>& WeightedTree<Key, Value>::operator=(const WeightedTree<Key, Value>& other)
+{
+    BinarySearchTree<Key, Value>::operator=(other);
+    recording_ = other.recording_;
+    return *this;
+}
+
+template<class Key, class Value>
+WeightedTree<Key, Value>& WeightedTree<Key, Value>::operator=(WeightedTree<Key, Value>&& other)
+{
+    BinarySearchTree<Key, Value>::operator=(std::move(other));
+    recording_ = other.recording_;
+    return *this;
+}
+
+/**
+* The BST insert, with a WeightedNode for a new key.
+* If key is already in the tree its value is overwritten.
+*/
+template<class Key, class Value>
+void WeightedTree<Key, Value>::insert(const std::pair<const Key, Value>& new_item)
+{
+    int cmp = 0;
+    size_t depth = 0;
+    Node<Key, Value>* parent = this->findSlot(new_item.first, cmp, depth);
+    if(parent != nullptr && cmp == 0){
+        parent->setValue(new_item.second);
+        return;
+    }
+    Node<Key, Value>* node = createNode(new_item.first, new_item.second, nullptr);
+    this->attachNode(node, parent, cmp);
+    this->noteInserted(node);
+    this->noteInsertDepth(depth);
+}
+
+/**
+* Returns an iterator to key, counting the lookup if recording is on.
+*/
+template<class Key, class Value>
+typename WeightedTree<Key, Value>::iterator WeightedTree<Key, Value>::find(const Key& key)
+{
+    Node<Key, Value>* node = this->internalFind(key);
+    if(node != nullptr && recording_){
+        static_cast<WeightedNode<Key, Value>*>(node)->addAccesses(1);
+    }
+    return this->makeIterator(node);
+}
+
+/**
+* @precondition The key exists in the map
+* Returns the value associated with the key
+*/
+template<class Key, class Value>
+Value& WeightedTree<Key, Value>::operator[](const Key& key)
+{
+    iterator it = find(key);
+    if(it == this->end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+/**
+* Turns the counting of lookups on or off. Counts already taken are kept.
+*/
+template<class Key, class Value>
+void WeightedTree<Key, Value>::setRecording(bool recording)
+{
+    recording_ = recording;
+}
+
+/**
+* Adds count lookups of key, for access frequencies known up front.
+*/
+template<class Key, class Value>
+void WeightedTree<Key, Value>::addAccesses(const Key& key, uint64_t count)
+{
+    Node<Key, Value>* node = this->internalFind(key);
+    if(node == nullptr) throw std::out_of_range("Invalid key");
+    static_cast<WeightedNode<Key, Value>*>(node)->addAccesses(count);
+}
+
+/**
+* Returns the number of lookups counted for key, 0 if it is not present.
+*/
+template<class Key, class Value>
+uint64_t WeightedTree<Key, Value>::accesses(const Key& key) const
+{
+    Node<Key, Value>* node = this->internalFind(key);
+    return node == nullptr ? 0 : static_cast<WeightedNode<Key, Value>*>(node)->getAccesses();
+}
+
+/**
+* Sets every key's count back to 0.
+*/
+template<class Key, class Value>
+void WeightedTree<Key, Value>::resetAccesses()
+{
+    for(Node<Key, Value>* node = this->minNode_; node != nullptr; node = this->successor(node)){
+        static_cast<WeightedNode<Key, Value>*>(node)->setAccesses(0);
+    }
+}
+
+/**
+* Relinks the existing nodes into the bisection-rule tree for the counted
+* accesses. Nothing is allocated or freed and no keys are compared, so
+* iterators stay valid.
+*/
+template<class Key, class Value>
+void WeightedTree<Key, Value>::reshapeByAccesses()
+{
+    std::vector<Node<Key, Value>*> nodes;
+    nodes.reserve(this->size_);
+    this->collectInOrder(this->root_, nodes);
+    std::vector<uint64_t> prefix(nodes.size() + 1, 0);
+    for(size_t i = 0; i < nodes.size(); ++i){
+        prefix[i + 1] = prefix[i] + static_cast<WeightedNode<Key, Value>*>(nodes[i])->getAccesses();
+    }
+
+    struct Range
+    {
+        size_t lo;
+        size_t hi;
+        Node<Key, Value>* parent;
+        bool left;
+    };
+    std::vector<Range> stack;
+    Range whole = { 0, nodes.size(), nullptr, false };
+    stack.push_back(whole);
+    while(!stack.empty()){
+        Range range = stack.back();
+        stack.pop_back();
+        Node<Key, Value>* node = nullptr;
+        if(range.lo < range.hi){
+            size_t mid = weightedRoot(prefix, range.lo, range.hi);
+            node = nodes[mid];
+            node->setParent(range.parent);
+            Range left = { range.lo, mid, node, true };
+            Range right = { mid + 1, range.hi, node, false };
+            stack.push_back(left);
+            stack.push_back(right);
+        }
+        if(range.parent == nullptr){
+            this->root_ = node;
+        } else if(range.left){
+            range.parent->setLeft(node);
+        } else {
+            range.parent->setRight(node);
+        }
+    }
+    this->stopCompaction();
+}
+
+/**
+* The average number of nodes a find() visits, weighted by the counted
+* accesses; 0 if none were counted. Comparing it before and after
+* reshapeByAccesses() shows what the reshape saves.
+*/
+template<class Key, class Value>
+double WeightedTree<Key, Value>::averageComparisons() const
+{
+    uint64_t total = 0;
+    double weighted = 0;
+    std::vector<std::pair<const Node<Key, Value>*, size_t> > stack;
+    if(this->root_ != nullptr){
+        stack.push_back(std::make_pair(this->root_, size_t(1)));
+    }
+    while(!stack.empty()){
+        const Node<Key, Value>* node = stack.back().first;
+        size_t depth = stack.back().second;
+        stack.pop_back();
+        uint64_t count = static_cast<const WeightedNode<Key, Value>*>(node)->getAccesses();
+        total += count;
+        weighted += static_cast<double>(count) * depth;
+        if(node->getLeft() != nullptr){
+            stack.push_back(std::make_pair(node->getLeft(), depth + 1));
+        }
+        if(node->getRight() != nullptr){
+            stack.push_back(std::make_pair(node->getRight(), depth + 1));
+        }
+    }
+    return total == 0 ? 0.0 : weighted / static_cast<double>(total);
+}
+
+/**
+* The root for the nodes lo..hi-1 under the bisection rule: the node whose
+* share of the prefix sums holds the midpoint of the range's total. A
+* range with no accesses is split in the middle instead.
+*/
+template<class Key, class Value>
+size_t WeightedTree<Key, Value>::weightedRoot(const std::vector<uint64_t>& prefix, size_t lo, size_t hi)
+{
+    uint64_t total = prefix[hi] - prefix[lo];
+    if(total == 0){
+        return lo + (hi - lo) / 2;
+    }
+    // the first node whose running total passes the midpoint
+    uint64_t half = prefix[lo] + total / 2;
+    return std::upper_bound(prefix.begin() + lo + 1, prefix.begin() + hi + 1, half) - prefix.begin() - 1;
+}
+
+template<class Key, class Value>
+Node<Key, Value>* WeightedTree<Key, Value>::cloneNode(const Node<Key, Value>* src, Node<Key, Value>* parent) const
+{
+    WeightedNode<Key, Value>* copy = new WeightedNode<Key, Value>(src->getKey(), src->getValue(),
+        static_cast<WeightedNode<Key, Value>*>(parent));
+    copy->setAccesses(static_cast<const WeightedNode<Key, Value>*>(src)->getAccesses());
+    return copy;
+}
+
+template<class Key, class Value>
+Node<Key, Value>* WeightedTree<Key, Value>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent) const
+{
+    return new WeightedNode<Key, Value>(key, value, static_cast<WeightedNode<Key, Value>*>(parent));
+}
+
+template<class Key, class Value>
+bool WeightedTree<Key, Value>::acceptsNode(const Node<Key, Value>* node) const
+{
+    return typeid(*node) == typeid(WeightedNode<Key, Value>);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the WeightedTree class.
+  -----------------------------------------------
+*/
+
+#endif